@@ -0,0 +1,629 @@
+/*
+* Benchmarks for the render framework and coursework hot paths
+*/
+
+#include <render_framework\render_framework.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <random>
+#include <atomic>
+#include <new>
+#include "CSVparser.hpp"
+#include "tiny_obj_loader.h"
+#include "scenemanager.h"
+#include "contentmanager.h"
+
+#pragma comment (lib, "Render Framework")
+
+using namespace std;
+using namespace glm;
+using namespace render_framework;
+
+/* benchmark_result : Timings of one benchmark
+ *
+ * Times are per call in nanoseconds, taken over every sample
+ */
+struct benchmark_result
+{
+	string name;
+	unsigned int samples;
+	unsigned int batch;
+	double min_ns;
+	double median_ns;
+	double mean_ns;
+	double max_ns;
+};
+
+// Results in the order they were run
+static vector<benchmark_result> results;
+
+// Written to by benchmarks so the work they time is not optimised away
+static volatile float sink = 0.0f;
+
+// Number of spheres culled by the culling benchmark
+static const unsigned int CULL_SPHERES = 1000000;
+
+// Names of the frustum_culler paths, indexed by CULL_PATH
+static const char* cull_path_names[] = { "scalar", "sse", "avx" };
+
+// Median time and visible count of each culling path run.  A path not
+// compiled in has a time of 0
+static double cull_median_ns[3] = { 0.0, 0.0, 0.0 };
+static size_t cull_visible[3] = { 0, 0, 0 };
+
+// Number of satellites in the debris field benchmark
+static const unsigned int DEBRIS_INSTANCES = 100000;
+
+// Draw calls and triangles of a debris field frame
+static uint64_t debris_draw_calls = 0;
+static uint64_t debris_triangles = 0;
+
+// Number of frames rendered by the allocation check, after warm-up
+static const unsigned int ALLOCATION_CHECK_FRAMES = 1000;
+
+// Flag indicating allocations are being counted
+static std::atomic<bool> counting_allocations(false);
+
+// Allocations made while counting, from any thread
+static std::atomic<unsigned int> allocation_count(0);
+
+// Allocations counted by the allocation check
+static unsigned int frame_allocations = 0;
+
+/** operator new() : Counts allocations made by the benchmarks
+ *
+ * Every form of operator new ends up here or in the nothrow form, so the
+ * allocation check sees allocations made by the framework, the coursework
+ * and the standard library alike.
+ */
+void* operator new(size_t size)
+{
+	if (counting_allocations.load(memory_order_relaxed)) {
+		++allocation_count;
+	}
+	void* result = malloc(size == 0 ? 1 : size);
+	if (result == nullptr) {
+		throw bad_alloc();
+	}
+	return result;
+} // operator new()
+
+void* operator new(size_t size, const nothrow_t&) throw()
+{
+	if (counting_allocations.load(memory_order_relaxed)) {
+		++allocation_count;
+	}
+	return malloc(size == 0 ? 1 : size);
+} // operator new(nothrow)
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+} // operator new[]()
+
+void* operator new[](size_t size, const nothrow_t& tag) throw()
+{
+	return operator new(size, tag);
+} // operator new[](nothrow)
+
+void operator delete(void* pointer) throw()
+{
+	free(pointer);
+} // operator delete()
+
+void operator delete(void* pointer, const nothrow_t&) throw()
+{
+	free(pointer);
+} // operator delete(nothrow)
+
+void operator delete[](void* pointer) throw()
+{
+	free(pointer);
+} // operator delete[]()
+
+void operator delete[](void* pointer, const nothrow_t&) throw()
+{
+	free(pointer);
+} // operator delete[](nothrow)
+
+/** run_benchmark() : Times a function
+ *
+ * The function is called a few times first to warm caches, then timed for
+ * the given number of samples.  Fast functions are called batch times per
+ * sample so the clock resolution does not dominate.
+ */
+template <typename Function>
+void run_benchmark(const string& name, unsigned int samples, unsigned int batch, Function function)
+{
+	unsigned int warm_up = (std::max)(1u, samples / 10);
+	for (unsigned int i = 0; i < warm_up; ++i) {
+		for (unsigned int j = 0; j < batch; ++j) {
+			function();
+		}
+	}
+
+	vector<double> times(samples);
+	for (unsigned int i = 0; i < samples; ++i) {
+		std::int64_t start = profiler::get_time();
+		for (unsigned int j = 0; j < batch; ++j) {
+			function();
+		}
+		times[i] = double(profiler::get_time() - start) / batch;
+	}
+	sort(times.begin(), times.end());
+
+	benchmark_result result;
+	result.name = name;
+	result.samples = samples;
+	result.batch = batch;
+	result.min_ns = times.front();
+	result.median_ns = times[samples / 2];
+	double total = 0.0;
+	for (auto iter = times.begin(); iter != times.end(); ++iter) {
+		total += *iter;
+	}
+	result.mean_ns = total / samples;
+	result.max_ns = times.back();
+	results.push_back(result);
+
+	cerr << name << ": median " << result.median_ns / 1000.0 << " us" << endl;
+} // run_benchmark()
+
+/** run_cull_benchmarks() : Times each frustum_culler path
+ *
+ * Culls a million random spheres around a camera, once for each instruction
+ * set compiled in.  Every path must find the same spheres visible.
+ */
+bool run_cull_benchmarks()
+{
+	frustum_culler culler;
+	culler.reserve(CULL_SPHERES);
+	std::mt19937 random(12345);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> radius(0.1f, 10.0f);
+	for (unsigned int i = 0; i < CULL_SPHERES; ++i) {
+		float x = position(random);
+		float y = position(random);
+		float z = position(random);
+		culler.add(vec3(x, y, z), radius(random));
+	}
+	mat4 projection = perspective(45.0f, 16.0f / 9.0f, 1.0f, 800.0f);
+	mat4 view = lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.2f, 0.5f), vec3(0.0f, 1.0f, 0.0f));
+	culler.set_frustum(projection * view);
+
+	for (int path = CULL_SCALAR; path <= frustum_culler::get_widest_path(); ++path) {
+		culler.set_path(static_cast<CULL_PATH>(path));
+		run_benchmark(string("frustum_cull_1m/") + cull_path_names[path], 20, 1, [&culler]() {
+			sink = sink + float(culler.cull());
+		});
+		cull_median_ns[path] = results.back().median_ns;
+		cull_visible[path] = culler.get_visible().size();
+		if (cull_visible[path] != cull_visible[CULL_SCALAR]) {
+			cerr << "Culling path " << cull_path_names[path] << " found " << cull_visible[path]
+				 << " spheres visible, scalar found " << cull_visible[CULL_SCALAR] << endl;
+			return false;
+		}
+	}
+	return true;
+} // run_cull_benchmarks()
+
+/** check_render_queue_layers() : Checks blended meshes sort after opaque ones
+ *
+ * Queues blended meshes between and in front of opaque ones, then checks
+ * the sorted queue draws every opaque mesh first, the blended meshes back
+ * to front, and blended meshes at the same depth in the order queued (as
+ * Earth's clouds and atmosphere are).  Needs no OpenGL context, as nothing
+ * is drawn.
+ */
+bool check_render_queue_layers()
+{
+	mat4 previous_view = renderer::get_instance().get_view();
+	renderer::get_instance().set_view(lookAt(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f)));
+	shared_ptr<geometry> geom = make_shared<geometry>();
+	shared_ptr<material> opaque = make_shared<material>();
+	shared_ptr<material> blended[2] = { make_shared<material>(), make_shared<material>() };
+
+	// Opaque meshes at 10 and 30, blended at 5 and 20, and two at 20
+	const float opaque_depths[] = { 10.0f, 30.0f };
+	const float blended_depths[] = { 5.0f, 20.0f, 20.0f };
+	mesh meshes[5];
+	for (int i = 0; i < 5; ++i) {
+		meshes[i].geom = geom;
+		if (i < 2) {
+			meshes[i].mat = opaque;
+			meshes[i].trans.position = vec3(0.0f, 0.0f, -opaque_depths[i]);
+		} else {
+			// Allocation order decides the material addresses, so alternate
+			// them to catch draws ordered by address
+			meshes[i].mat = blended[i % 2];
+			meshes[i].trans.position = vec3(0.0f, 0.0f, -blended_depths[i - 2]);
+		}
+	}
+
+	// Queue blended meshes first, so only the layer can put opaque first
+	render_queue queue;
+	queue.push(meshes[2], LAYER_TRANSPARENT);
+	queue.push(meshes[3], LAYER_TRANSPARENT);
+	queue.push(meshes[0]);
+	queue.push(meshes[4], LAYER_TRANSPARENT);
+	queue.push(meshes[1]);
+	queue.sort();
+
+	// Opaque front to back, then blended back to front, ties in queue order
+	const mesh* expected[] = { &meshes[0], &meshes[1], &meshes[3], &meshes[4], &meshes[2] };
+	renderer::get_instance().set_view(previous_view);
+	for (size_t i = 0; i < 5; ++i) {
+		if (queue.get_record(i).value != expected[i]) {
+			cerr << "Render queue draw " << i << " is out of order.  Blended meshes must sort after opaque meshes, back to front" << endl;
+			return false;
+		}
+	}
+	return true;
+} // check_render_queue_layers()
+
+/** run_cpu_benchmarks() : Benchmarks needing no OpenGL context
+ *
+ * Loaders and parsers read the coursework assets, so the benchmark must be
+ * run from the src directory.
+ */
+bool run_cpu_benchmarks()
+{
+	const char* models[] = { "Moon.obj", "Sputnik.obj" };
+	for (int i = 0; i < 2; ++i) {
+		const char* filename = models[i];
+		vector<tinyobj::shape_t> shapes;
+		string error = tinyobj::LoadObj(shapes, filename);
+		if (!error.empty()) {
+			cerr << "Could not load " << filename << ": " << error << endl;
+			return false;
+		}
+		run_benchmark(string("tinyobj_load/") + filename, 10, 1, [filename]() {
+			vector<tinyobj::shape_t> shapes;
+			tinyobj::LoadObj(shapes, filename);
+			sink = sink + float(shapes.size());
+		});
+	}
+
+	const char* images[] = { "sputnik.jpg", "moon_normal.jpg" };
+	for (int i = 0; i < 2; ++i) {
+		const char* filename = images[i];
+		image_data image;
+		if (!texture_loader::decode(filename, image)) {
+			cerr << "Could not decode " << filename << endl;
+			return false;
+		}
+		run_benchmark(string("texture_decode/") + filename, 10, 1, [filename]() {
+			image_data image;
+			texture_loader::decode(filename, image);
+			sink = sink + float(image.width);
+		});
+	}
+
+	// Vary the transform so the matrix cannot be hoisted out of the loop
+	render_framework::transform value;
+	value.position = vec3(1.0f, 2.0f, 3.0f);
+	value.orientation = quat(vec3(0.1f, 0.2f, 0.3f));
+	value.scale = vec3(2.0f, 2.0f, 2.0f);
+	run_benchmark("transform_get_transform_matrix", 100, 10000, [&value]() {
+		value.position.x += 1.0f;
+		mat4 matrix = value.get_transform_matrix();
+		sink = sink + matrix[3][0];
+	});
+
+	run_benchmark("csv_parse/proplist.csv", 100, 1, []() {
+		csv::Parser file("proplist.csv");
+		sink = sink + float(file.rowCount());
+	});
+
+	return check_render_queue_layers() && run_cull_benchmarks();
+} // run_cpu_benchmarks()
+
+/** run_debris_benchmark() : Times a debris field of instanced satellites
+ *
+ * Scatters copies of the Sputnik mesh through a shell around the Earth and
+ * renders them all with one render<mesh_instances> call a frame.  The draw
+ * calls of the frame are kept, so the JSON shows the field is drawn with
+ * one call rather than one per satellite.
+ */
+bool run_debris_benchmark()
+{
+	Prop* sputnik = nullptr;
+	for (int i = 0; i < ContentManager::get_instance().prop_list_size(); ++i) {
+		Prop* prop = ContentManager::get_instance().get_prop_at(i);
+		if (prop->get_name() == "Sputnik" && prop->mesh_size() > 0) {
+			sputnik = prop;
+		}
+	}
+	if (sputnik == nullptr) {
+		cerr << "Debris field needs the Sputnik prop" << endl;
+		return false;
+	}
+
+	mesh_instances debris(sputnik->get_mesh(0));
+	debris.matrices.reserve(DEBRIS_INSTANCES);
+	std::mt19937 random(54321);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> height(4000.0f, 12000.0f);
+	for (unsigned int i = 0; i < DEBRIS_INSTANCES; ++i) {
+		render_framework::transform value;
+		float x = unit(random);
+		float y = unit(random);
+		float z = unit(random);
+		vec3 direction(x, y, z);
+		value.position = normalize(direction + vec3(0.0f, 0.0f, 1.0e-4f)) * height(random);
+		x = unit(random);
+		y = unit(random);
+		z = unit(random);
+		value.orientation = quat(vec3(x, y, z) * 3.14159f);
+		debris.add(value);
+	}
+
+	run_benchmark("mesh_instances/debris_100000", 50, 1, [&debris]() {
+		renderer::get_instance().begin_render();
+		renderer::get_instance().render(debris);
+		renderer::get_instance().end_render();
+		glFinish();
+	});
+	debris_draw_calls = renderer::get_instance().get_frame_stats().draw_calls;
+	debris_triangles = renderer::get_instance().get_frame_stats().triangles;
+	return true;
+} // run_debris_benchmark()
+
+/** check_material_instances() : Checks instances of a prop material
+ *
+ * Makes instances of Sputnik's material and checks that:
+ *  - an instance shares the buffer of its base until it overrides the data
+ *  - an instance built before overriding the data gets its own buffer, and
+ *    the new data reaches it, while the base keeps its data
+ *  - meshes using a base and its instances group together in a render queue
+ * Binding an overriding instance is then timed against binding its base.
+ */
+bool check_material_instances()
+{
+	Prop* sputnik = nullptr;
+	for (int i = 0; i < ContentManager::get_instance().prop_list_size(); ++i) {
+		Prop* prop = ContentManager::get_instance().get_prop_at(i);
+		if (prop->get_name() == "Sputnik" && prop->mesh_size() > 0) {
+			sputnik = prop;
+		}
+	}
+	if (sputnik == nullptr || sputnik->get_mesh(0).mat == nullptr || !sputnik->get_mesh(0).mat->buffer) {
+		cerr << "Material instance check needs Sputnik's built material" << endl;
+		return false;
+	}
+	const mesh& original = sputnik->get_mesh(0);
+	shared_ptr<material> base = original.mat;
+	material_data base_data = base->data;
+
+	// An instance which does not override the data has no buffer
+	shared_ptr<material> shared = make_shared<material>(base);
+	shared_ptr<material> late = make_shared<material>(base);
+	if (!shared->build() || !late->build() || shared->buffer || late->buffer) {
+		cerr << "Material instances must share the buffer of their base" << endl;
+		return false;
+	}
+
+	// Overriding the data after building must create a buffer holding it
+	material_data variant = base_data;
+	variant.shininess = base_data.shininess + 1.0f;
+	if (!late->set_data(variant) || !late->buffer || !late->overrides_data) {
+		cerr << "Material instance overriding its data after build has no buffer" << endl;
+		return false;
+	}
+	material_data uploaded;
+	glBindBuffer(GL_UNIFORM_BUFFER, late->buffer);
+	glGetBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(material_data), &uploaded);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	if (uploaded.shininess != variant.shininess || base->data.shininess != base_data.shininess) {
+		cerr << "Material instance data did not reach its buffer" << endl;
+		return false;
+	}
+
+	// Meshes of the base and its instances share the material bits of the
+	// sort key, so they are drawn together
+	mesh meshes[3];
+	shared_ptr<material> materials[3] = { base, shared, late };
+	for (int i = 0; i < 3; ++i) {
+		meshes[i].geom = original.geom;
+		meshes[i].mat = materials[i];
+	}
+	render_queue queue;
+	for (int i = 0; i < 3; ++i) {
+		queue.push(meshes[i]);
+	}
+	queue.sort();
+	for (size_t i = 1; i < queue.size(); ++i) {
+		if (((queue.get_record(i).key >> 32) & 0xFFFF) != ((queue.get_record(0).key >> 32) & 0xFFFF)) {
+			cerr << "Material instances do not group with their base" << endl;
+			return false;
+		}
+	}
+
+	renderer::get_instance().bind(base->effect);
+	run_benchmark("material_bind/base", 100, 100, [base]() {
+		base->bind_values();
+	});
+	run_benchmark("material_bind/instance", 100, 100, [late]() {
+		late->bind_values();
+	});
+	return !CHECK_GL_ERROR;
+} // check_material_instances()
+
+/** run_gl_benchmarks() : Benchmarks needing the renderer
+ *
+ * Loads the coursework scene into a headless renderer, then times binding
+ * each prop material and rendering whole frames.
+ */
+bool run_gl_benchmarks(unsigned int width, unsigned int height, unsigned int frames)
+{
+	renderer::get_instance().set_headless(width, height);
+	if (!SceneManager::get_instance().initialize()) {
+		cerr << "Scene manager failed to initialize" << endl;
+		return false;
+	}
+	if (!check_material_instances()) {
+		return false;
+	}
+
+	// Bind each material with its effect already in use, so only the
+	// values are timed
+	for (int i = 0; i < ContentManager::get_instance().prop_list_size(); ++i) {
+		Prop* prop = ContentManager::get_instance().get_prop_at(i);
+		for (int j = 0; j < prop->mesh_size(); ++j) {
+			shared_ptr<material> mat = prop->get_mesh(j).mat;
+			if (mat == nullptr || mat->effect == nullptr || mat->uniform_values == nullptr) {
+				continue;
+			}
+			renderer::get_instance().bind(mat->effect);
+			effect_values* values = mat->uniform_values.get();
+			ostringstream name;
+			name << "effect_values_bind/" << prop->get_name() << "/" << j;
+			run_benchmark(name.str(), 100, 100, [values]() {
+				values->bind();
+			});
+		}
+	}
+
+	if (!run_debris_benchmark()) {
+		return false;
+	}
+
+	// Whole frames, finished on the GPU so frames do not queue up
+	const float step = 1.0f / 60.0f;
+	run_benchmark("frame_headless", frames, 1, [step]() {
+		SceneManager::get_instance().step_scene(step);
+		SceneManager::get_instance().update_scene(step, 0.0f);
+		SceneManager::get_instance().render_scene(step);
+		glFinish();
+	});
+
+	// The frames above have warmed every cache and pool, so a steady frame
+	// must not allocate at all
+	allocation_count = 0;
+	counting_allocations = true;
+	for (unsigned int i = 0; i < ALLOCATION_CHECK_FRAMES; ++i) {
+		SceneManager::get_instance().step_scene(step);
+		SceneManager::get_instance().update_scene(step, 0.0f);
+		SceneManager::get_instance().render_scene(step);
+	}
+	glFinish();
+	counting_allocations = false;
+	frame_allocations = allocation_count;
+	cerr << "Allocations over " << ALLOCATION_CHECK_FRAMES << " frames: " << frame_allocations << endl;
+
+	return true;
+} // run_gl_benchmarks()
+
+/** write_json() : Writes the results
+ *
+ * The frame statistics of the last frame rendered are included, so changes
+ * in the work done can be told apart from changes in speed.
+ */
+void write_json(ostream& os, bool gl)
+{
+	os << "{" << endl;
+#if defined(_DEBUG)
+	os << "  \"configuration\": \"Debug\"," << endl;
+#else
+	os << "  \"configuration\": \"Release\"," << endl;
+#endif
+	os << "  \"benchmarks\": [" << endl;
+	for (size_t i = 0; i < results.size(); ++i) {
+		const benchmark_result& r = results[i];
+		os << "    {\"name\": \"" << r.name << "\", \"samples\": " << r.samples
+		   << ", \"batch\": " << r.batch
+		   << ", \"min_ns\": " << r.min_ns << ", \"median_ns\": " << r.median_ns
+		   << ", \"mean_ns\": " << r.mean_ns << ", \"max_ns\": " << r.max_ns << "}"
+		   << (i + 1 < results.size() ? "," : "") << endl;
+	}
+	os << "  ]," << endl;
+
+	// Speed up of each culling path over the scalar path
+	os << "  \"frustum_cull\": {\"spheres\": " << CULL_SPHERES
+	   << ", \"visible\": " << cull_visible[CULL_SCALAR];
+	for (int path = CULL_SSE; path <= CULL_AVX; ++path) {
+		os << ", \"" << cull_path_names[path] << "_speedup\": ";
+		if (cull_median_ns[path] > 0.0) {
+			os << cull_median_ns[CULL_SCALAR] / cull_median_ns[path];
+		} else {
+			os << "null";
+		}
+	}
+	os << "}";
+	if (gl) {
+		const frame_stats& stats = renderer::get_instance().get_frame_stats();
+		os << "," << endl << "  \"frame_stats\": {"
+		   << "\"draw_calls\": " << stats.draw_calls
+		   << ", \"triangles\": " << stats.triangles
+		   << ", \"program_binds\": " << stats.program_binds
+		   << ", \"vertex_array_binds\": " << stats.vertex_array_binds
+		   << ", \"texture_binds\": " << stats.texture_binds
+		   << ", \"frame_buffer_binds\": " << stats.frame_buffer_binds
+		   << ", \"uniform_calls\": " << stats.uniform_calls
+		   << ", \"uniform_block_binds\": " << stats.uniform_block_binds
+		   << ", \"bytes_uploaded\": " << stats.bytes_uploaded << "}";
+		os << "," << endl << "  \"debris_field\": {\"instances\": " << DEBRIS_INSTANCES
+		   << ", \"draw_calls\": " << debris_draw_calls
+		   << ", \"triangles\": " << debris_triangles << "}";
+		os << "," << endl << "  \"allocation_check\": {\"frames\": " << ALLOCATION_CHECK_FRAMES
+		   << ", \"allocations\": " << frame_allocations << "}";
+	}
+	os << endl << "}" << endl;
+} // write_json()
+
+/** main() : Entry point for the benchmarks
+ *
+ * Runs every benchmark and writes the results as JSON to standard output,
+ * or to the file given with --out FILE.  --cpu-only skips the benchmarks
+ * needing an OpenGL context, which is headless but still needs a display
+ * unless built with RENDER_FRAMEWORK_EGL.  --frames N sets the number of
+ * frames timed.
+ * With OpenGL, a further 1000 frames are rendered counting allocations, and
+ * the benchmark fails if there were any.
+ * Run from the src directory so the assets are found.
+ */
+int main(int argc, char* argv[]) {
+	string out;
+	bool gl = true;
+	unsigned int frames = 300;
+	for (int i = 1; i < argc; ++i) {
+		if (string(argv[i]) == "--out" && i + 1 < argc) {
+			out = argv[++i];
+		} else if (string(argv[i]) == "--cpu-only") {
+			gl = false;
+		} else if (string(argv[i]) == "--frames" && i + 1 < argc) {
+			frames = (std::max)(1, atoi(argv[++i]));
+		}
+	}
+
+	if (!run_cpu_benchmarks()) {
+		return -1;
+	}
+	if (gl && !run_gl_benchmarks(1280, 720, frames)) {
+		return -1;
+	}
+
+	if (out.empty()) {
+		write_json(cout, gl);
+	} else {
+		ofstream file(out.c_str());
+		if (!file.is_open()) {
+			cerr << "Could not open " << out << endl;
+			return -1;
+		}
+		write_json(file, gl);
+	}
+
+	// Fail if a steady frame allocated, once the results are written
+	if (gl && frame_allocations > 0) {
+		cerr << "Allocation check failed - frames must not allocate after warm-up" << endl;
+		return -1;
+	}
+	return 0;
+} // main()
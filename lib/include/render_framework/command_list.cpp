@@ -0,0 +1,68 @@
+#include "command_list.h"
+#include "render_queue.h"
+#include "mesh.h"
+
+#include <algorithm>
+
+namespace render_framework
+{
+	// Orders commands by their sort key
+	bool command_less(const draw_command& a, const draw_command& b)
+	{
+		return a.key < b.key;
+	}
+
+	/*
+	Clears the list ready for a new frame.  The matrices are kept so that
+	every command can be composed against them
+	*/
+	void command_list::begin(const glm::mat4& view, const glm::mat4& projection)
+	{
+		_commands.clear();
+		_view = view;
+		_projection = projection;
+	}
+
+	/*
+	Adds a draw to the list.  Composes the model-view and model-view-projection
+	matrices here so that the OpenGL thread only has to upload them
+	*/
+	void command_list::record(std::uint64_t key, material* mat, const geometry& geom, const glm::mat4& model, const glm::mat3& normal)
+	{
+		draw_command command;
+		command.key = key;
+		command.mat = mat;
+		command.geom = &geom;
+		command.model = model;
+		command.model_view = _view * model;
+		command.model_view_projection = _projection * command.model_view;
+		command.normal = normal;
+		_commands.push_back(command);
+	}
+
+	/*
+	Records a range of the sorted draws in a render queue.  The model matrix
+	was calculated when the draw was queued, so only the normal matrix and
+	the composed matrices are calculated here
+	*/
+	void command_list::record(const render_queue& queue, std::size_t begin, std::size_t end)
+	{
+		end = (std::min)(end, queue.size());
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			auto& r = queue.get_record(i);
+			record(r.key, r.value->mat.get(), *r.value->geom, r.model, r.value->get_normal_matrix());
+		}
+	}
+
+	/*
+	Sorts the commands by key.  Draws with equal keys keep the order they
+	were recorded in
+	*/
+	void command_list::sort()
+	{
+		if (std::is_sorted(_commands.begin(), _commands.end(), command_less))
+			return;
+		std::stable_sort(_commands.begin(), _commands.end(), command_less);
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <glm\glm.hpp>
+
+namespace render_framework
+{
+	// Forward declarations
+	struct geometry;
+	struct material;
+	class render_queue;
+
+	// Draws a render queue needs before its recording is split between
+	// threads.  Below this starting the threads costs more than it saves
+	const std::size_t PARALLEL_RECORD_THRESHOLD = 1024;
+
+	/*
+	A single draw with everything the renderer needs already resolved.  The
+	matrices are composed when the command is recorded, so replaying it is
+	only a matter of binding state and issuing OpenGL calls
+	*/
+	struct draw_command
+	{
+		// The packed sort key of the draw.  See render_queue
+		std::uint64_t key;
+		// Material used by the draw.  nullptr uses the fixed function pipeline
+		material* mat;
+		// The geometry to be drawn
+		const geometry* geom;
+		// The model matrix of the draw
+		glm::mat4 model;
+		// The model-view matrix of the draw
+		glm::mat4 model_view;
+		// The model-view-projection matrix of the draw
+		glm::mat4 model_view_projection;
+		// The normal matrix of the draw
+		glm::mat3 normal;
+	};
+
+	/*
+	A list of draw commands recorded against a single view.  Recording does
+	not touch OpenGL, so lists can be recorded on any thread and are handed to
+	the renderer on the OpenGL thread, which merges them by key and replays
+	them.  Storage is kept between frames, so once warmed up recording does
+	not allocate.
+
+	A list must not be recorded to by more than one thread at a time.
+	*/
+	class command_list
+	{
+	private:
+		// The recorded commands
+		std::vector<draw_command> _commands;
+		// The view matrix the commands were recorded against
+		glm::mat4 _view;
+		// The projection matrix the commands were recorded against
+		glm::mat4 _projection;
+	public:
+		// Creates an empty command list
+		command_list() : _view(1.0f), _projection(1.0f) { }
+
+		// Removes all the commands and sets the view to record against.
+		// Storage is kept for the next frame
+		void begin(const glm::mat4& view, const glm::mat4& projection);
+
+		// Reserves storage for the given number of commands
+		void reserve(std::size_t count) { _commands.reserve(count); }
+
+		// Adds a draw of the given geometry and material
+		void record(std::uint64_t key, material* mat, const geometry& geom, const glm::mat4& model, const glm::mat3& normal);
+
+		// Records the draws of a render queue in the range [begin, end) of
+		// its sorted order.  The queue is only read, so several lists can
+		// record different ranges of the same queue at once
+		void record(const render_queue& queue, std::size_t begin, std::size_t end);
+
+		// Sorts the commands by key.  Lists recorded from a sorted queue are
+		// already in order and are left alone
+		void sort();
+
+		// Gets the number of recorded commands
+		std::size_t size() const { return _commands.size(); }
+
+		// Gets the command at the given position
+		const draw_command& get_command(std::size_t index) const { return _commands[index]; }
+
+		// Gets the view matrix the commands were recorded against
+		const glm::mat4& get_view() const { return _view; }
+
+		// Gets the projection matrix the commands were recorded against
+		const glm::mat4& get_projection() const { return _projection; }
+	};
+}
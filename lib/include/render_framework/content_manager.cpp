@@ -9,9 +9,12 @@
 #include "light.h"
 #include "effect.h"
 #include "frame_buffer.h"
+#include "gl_debug.h"
 #include "post_process.h"
 #include "util.h"
 
+#include <algorithm>
+#include <sstream>
 #include <glm\gtc\type_ptr.hpp>
 
 namespace render_framework
@@ -91,6 +94,7 @@ namespace render_framework
 		// Delete effects
 		std::clog << "Deleting effects" << std::endl;
 		_effects.clear();
+		_shared_effects.clear();
 		std::clog << "Effects deleted" << std::endl;
 
 		// Delete frame buffers
@@ -681,8 +685,11 @@ namespace render_framework
 	template <>
 	bool content_manager::build(const std::string& name, std::shared_ptr<effect>& value)
 	{
-		// TODO
-		return false;
+		// Effects from the same shaders share one program
+		if (!build_shared(value))
+			return false;
+		_effects[name] = value;
+		return true;
 	}
 
 	template <>
@@ -741,6 +748,9 @@ namespace render_framework
         // Set the texture and depth
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, value->tex->image, 0);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, value->depth->image, 0);
+        gl_debug::label(GL_FRAMEBUFFER, value->buffer, name);
+        gl_debug::label(GL_TEXTURE, value->tex->image, name + " colour");
+        gl_debug::label(GL_TEXTURE, value->depth->image, name + " depth");
 
         // Check for errors
         if (CHECK_GL_ERROR)
@@ -782,6 +792,8 @@ namespace render_framework
 		glGenFramebuffers(1, &value->buffer);
 		glBindFramebuffer(GL_FRAMEBUFFER, value->buffer);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, value->depth_texture->image, 0);
+		gl_debug::label(GL_FRAMEBUFFER, value->buffer, name);
+		gl_debug::label(GL_TEXTURE, value->depth_texture->image, name + " depth");
 		glDrawBuffer(GL_NONE);
 		// Check framebuffer status
 		auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -807,7 +819,7 @@ namespace render_framework
 	{
         // Check if effect is built
         if (value->eff->program == 0)
-            if (!effect_loader::build_effect(value->eff))
+            if (!build_shared(value->eff))
                 return false;
         // Build framebuffer if necessary
         if (value->buffer->buffer == 0)
@@ -1490,4 +1502,56 @@ namespace render_framework
 			return build(name, value);
 		}
 	}
-}
\ No newline at end of file
+
+	/*
+	Makes the key of an effect from the stage and file of each shader and
+	its defines.  Both are sorted, so the order they were added in does not
+	matter.  Shaders already compiled without a file are keyed by their ID
+	*/
+	static std::string make_effect_key(const effect& value)
+	{
+		std::vector<std::string> parts;
+		for (auto iter = value.shaders.begin(); iter != value.shaders.end(); ++iter)
+		{
+			std::ostringstream part;
+			part << (*iter)->type << ':';
+			if ((*iter)->filename.empty())
+				part << '#' << (*iter)->id;
+			else
+				part << (*iter)->filename;
+			parts.push_back(part.str());
+		}
+		std::sort(parts.begin(), parts.end());
+		std::vector<std::string> defines(value.defines);
+		std::sort(defines.begin(), defines.end());
+		for (auto iter = defines.begin(); iter != defines.end(); ++iter)
+			parts.push_back("#define " + *iter);
+		std::string key;
+		for (auto iter = parts.begin(); iter != parts.end(); ++iter)
+			key += *iter + '|';
+		return key;
+	}
+
+	/*
+	Builds an effect, or replaces it with the effect already built from the
+	same shaders.  Effects already built are added under their own key.  An
+	effect still in a batch is shared like any other
+	*/
+	bool content_manager::build_shared(std::shared_ptr<effect>& value, effect_batch* batch)
+	{
+		std::string key = make_effect_key(*value);
+		auto found = _shared_effects.find(key);
+		if (found != _shared_effects.end())
+		{
+			value = found->second;
+			return true;
+		}
+		if (value->program == 0)
+		{
+			if (batch != nullptr ? !batch->add(value) : !effect_loader::build_effect(value))
+				return false;
+		}
+		_shared_effects[key] = value;
+		return true;
+	}
+}
@@ -37,6 +37,7 @@ namespace render_framework
 	// Declarations for effects
 	struct shader;
 	struct effect;
+	class effect_batch;
 
 	// Declarations for frame buffer type objects
 	struct frame_buffer;
@@ -98,6 +99,10 @@ namespace render_framework
 		// Data store for all currently built effects
 		std::unordered_map<std::string, std::shared_ptr<effect>> _effects;
 
+		// Built effects keyed by their shaders, so effects made from the same
+		// shaders share one program
+		std::unordered_map<std::string, std::shared_ptr<effect>> _shared_effects;
+
 		// Data store for all currently built frame buffers
 		std::unordered_map<std::string, std::shared_ptr<frame_buffer>> _frame_buffers;
 
@@ -159,6 +164,15 @@ namespace render_framework
 		// Builds content and stores in the content manager
 		template <typename T>
 		bool build(const std::string& name, std::shared_ptr<T>& value);
+
+		// Builds an effect unless one has already been built from the same
+		// shaders, in which case value is replaced with the built effect.
+		// If a batch is given the effect is added to it rather than built
+		// straight away, and is not usable until the batch is done
+		bool build_shared(std::shared_ptr<effect>& value, effect_batch* batch = nullptr);
+
+		// Gets the number of distinct effects built through build_shared
+		size_t shared_effect_count() const { return _shared_effects.size(); }
 	};
 
 	/*
@@ -1,9 +1,14 @@
 #include "effect.h"
 #include "util.h"
+#include "gl_debug.h"
+#include "program_cache.h"
+#include "renderer.h"
+#include "frame_data.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <algorithm>
 
 namespace render_framework
 {
@@ -13,7 +18,7 @@ namespace render_framework
 		// Create filestream
 		std::ifstream file(filename, std::ios_base::in);
 		// Check that file exists.  If not, return false
-		if (file.bad())
+		if (!file.is_open() || file.bad())
 			return false;
 
 		// File is good.  Read contents
@@ -28,20 +33,166 @@ namespace render_framework
 		return true;
 	}
 
+	// Names of the built in uniforms, in the order of BUILTIN_UNIFORM
+	static const char* builtin_uniform_names[BUILTIN_UNIFORM_COUNT] =
+	{
+		"model",
+		"view",
+		"projection",
+		"MV",
+		"MVP",
+		"normal_matrix",
+		"eye_position"
+	};
+
+	// Helper function used to build a uniform table sorted by hash
+	void build_uniform_table(const std::unordered_map<std::string, GLint>& uniforms, std::vector<uniform_slot>& table)
+	{
+		table.clear();
+		for (auto iter = uniforms.begin(); iter != uniforms.end(); ++iter)
+		{
+			uniform_slot slot;
+			slot.hash = hash_uniform_name(iter->first.c_str());
+			slot.location = iter->second;
+			slot.name = iter->first;
+			table.push_back(slot);
+		}
+		std::sort(table.begin(), table.end(), [](const uniform_slot& a, const uniform_slot& b) { return a.hash < b.hash; });
+		// Two names hashing to the same value cannot be told apart by a handle
+		for (std::size_t i = 1; i < table.size(); ++i)
+			if (table[i].hash == table[i - 1].hash)
+				std::cerr << "Uniforms " << table[i - 1].name << " and " << table[i].name << " have the same hash" << std::endl;
+	}
+
+	// Deepest #include nesting allowed.  Deeper nesting is taken to be a cycle
+	const unsigned int MAX_INCLUDE_DEPTH = 16;
+
+	// Gets the directory part of a path, including the final separator
+	static std::string get_directory(const std::string& path)
+	{
+		auto separator = path.find_last_of("/\\");
+		return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+	}
+
+	/*
+	Reads a file, replacing each #include "file" line with the contents of
+	the file, found relative to the including file.  #line directives keep
+	compile errors pointing at the right line.  The source string number
+	of each file is the order it was included in, the top file being 0
+	*/
+	static bool resolve_includes(const std::string& filename, unsigned int depth, unsigned int& files, std::string& result)
+	{
+		std::string content;
+		if (!read_file(filename, content))
+		{
+			std::cerr << "Failed to read file " << filename << std::endl;
+			return false;
+		}
+		if (depth > MAX_INCLUDE_DEPTH)
+		{
+			std::cerr << "Shader includes nested too deeply at " << filename << ".  Do two files include each other?" << std::endl;
+			return false;
+		}
+
+		unsigned int number = files++;
+		std::istringstream lines(content);
+		std::string line;
+		unsigned int line_number = 0;
+		while (std::getline(lines, line))
+		{
+			++line_number;
+			auto start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+			{
+				result += line + '\n';
+				continue;
+			}
+			auto open = line.find('"', start + 8);
+			auto close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos)
+			{
+				std::cerr << "Malformed #include at line " << line_number << " of " << filename << std::endl;
+				return false;
+			}
+			std::string included = get_directory(filename) + line.substr(open + 1, close - open - 1);
+			std::ostringstream marker;
+			marker << "#line 1 " << files << '\n';
+			result += marker.str();
+			if (!resolve_includes(included, depth + 1, files, result))
+				return false;
+			marker.str("");
+			marker << "#line " << line_number + 1 << ' ' << number << '\n';
+			result += marker.str();
+		}
+		return true;
+	}
+
+	/*
+	Reads a shader file, resolving #include lines.  The defines are added
+	after the #version line, which GLSL requires to come first, or at the
+	start if there is none
+	*/
+	bool effect_loader::preprocess(const std::string& filename, const std::vector<std::string>& defines, std::string& result)
+	{
+		std::string source;
+		unsigned int files = 0;
+		if (!resolve_includes(filename, 0, files, source))
+			return false;
+		if (defines.empty())
+		{
+			result = source;
+			return true;
+		}
+
+		std::string define_lines;
+		for (auto iter = defines.begin(); iter != defines.end(); ++iter)
+			define_lines += "#define " + *iter + '\n';
+
+		auto version = source.find("#version");
+		if (version == std::string::npos)
+		{
+			result = define_lines + "#line 1 0\n" + source;
+			return true;
+		}
+		auto end = source.find('\n', version);
+		end = end == std::string::npos ? source.size() : end + 1;
+		unsigned int version_line = static_cast<unsigned int>(std::count(source.begin(), source.begin() + end, '\n'));
+		std::ostringstream marker;
+		marker << "#line " << version_line + 1 << " 0\n";
+		result = source.substr(0, end) + define_lines + marker.str() + source.substr(end);
+		return true;
+	}
+
 	// Loads a shader from a given filename
 	std::shared_ptr<shader> effect_loader::load_shader(const std::string& filename, GLenum type)
 	{
 		// String holding the contents of the shader file
 		std::string content;
 		// First read in file contents.  Check if file read is OK
-		if (!read_file(filename, content))
-		{
-			// Failed to read file.  Display error
-			std::cerr << "Failed to read file " << filename << std::endl;
+		if (!preprocess(filename, std::vector<std::string>(), content))
 			return nullptr;
-		}
+		return compile_shader(filename, content, type);
+	}
+
+	// Compiles a shader from source, waiting for the result.  filename is
+	// used for messages
+	std::shared_ptr<shader> effect_loader::compile_shader(const std::string& filename, const std::string& content, GLenum type)
+	{
+		auto value = submit_shader(filename, content, type);
+		if (!check_shader(*value))
+			return nullptr;
+		return value;
+	}
+
+	/*
+	Starts compiling a shader.  Nothing here waits for the compiler, so many
+	shaders can be submitted before any are checked
+	*/
+	std::shared_ptr<shader> effect_loader::submit_shader(const std::string& filename, const std::string& content, GLenum type)
+	{
 		// Create new shader object
-        auto value = std::make_shared<shader>();
+		auto value = std::make_shared<shader>();
+		value->filename = filename;
 		value->type = type;
 		// File has been read.  Try and create shader
 		value->id = glCreateShader(value->type);
@@ -49,15 +200,21 @@ namespace render_framework
 		auto source = content.c_str();
 		// Set the source code of the shader
 		glShaderSource(value->id, 1, &source, 0);
+		gl_debug::label(GL_SHADER, value->id, filename);
 		// Compile shader
 		glCompileShader(value->id);
 		CHECK_GL_ERROR;
+		return value;
+	}
 
+	// Checks if a shader compiled, printing the log if not
+	bool effect_loader::check_shader(const shader& value)
+	{
 		// We have tried to compile the shader.  Check if successful
 		// Compile status of the shader
 		GLint compiled;
 		// Get the compile status
-		glGetShaderiv(value->id, GL_COMPILE_STATUS, &compiled);
+		glGetShaderiv(value.id, GL_COMPILE_STATUS, &compiled);
 		CHECK_GL_ERROR;
 		// Check if compiled
 		if (!compiled)
@@ -67,83 +224,296 @@ namespace render_framework
 			GLsizei length;
 			
 			// Get length of log
-			glGetShaderiv(value->id, GL_INFO_LOG_LENGTH, &length);
+			glGetShaderiv(value.id, GL_INFO_LOG_LENGTH, &length);
 			// Use the length to create log buffer
             // Buffer for the log
 			std::unique_ptr<char[]> log(new char[length]);
 			// Get the log
-			glGetShaderInfoLog(value->id, length, &length, log.get());
+			glGetShaderInfoLog(value.id, length, &length, log.get());
 			// Display error message
-			std::cout << "Could not compile shader " << filename << std::endl;
+			std::cout << "Could not compile shader " << value.filename << std::endl;
 			std::cout << log.get() << std::endl;
 			CHECK_GL_ERROR;
-			// Return nullptr
-			return nullptr;
+			return false;
 		}
 
 		// Shader has been created OK.  Log and return true
-		std::clog << "Shader " << filename << " loaded" << std::endl;
-		return value;
+		std::clog << "Shader " << value.filename << " loaded" << std::endl;
+		return true;
+	}
+
+	/*
+	Gets the source of each shader in an effect.  Shaders already compiled
+	are asked for the source they were given, others are read from file and
+	preprocessed with the defines of the effect
+	*/
+	static bool get_sources(const effect& value, std::vector<GLenum>& types, std::vector<std::string>& sources)
+	{
+		for (auto iter = value.shaders.begin(); iter != value.shaders.end(); ++iter)
+		{
+			std::string source;
+			if ((*iter)->id)
+			{
+				GLint length = 0;
+				glGetShaderiv((*iter)->id, GL_SHADER_SOURCE_LENGTH, &length);
+				if (length > 0)
+				{
+					std::unique_ptr<char[]> buffer(new char[length]);
+					glGetShaderSource((*iter)->id, length, nullptr, buffer.get());
+					source = buffer.get();
+				}
+			}
+			else if (!effect_loader::preprocess((*iter)->filename, value.defines, source))
+				return false;
+			types.push_back((*iter)->type);
+			sources.push_back(source);
+		}
+		return true;
 	}
 
-	// Builds an effect from a list of shaders
+	/*
+	Builds an effect from a list of shaders, waiting for the driver.  Use an
+	effect_batch to build several effects at once
+	*/
 	bool effect_loader::build_effect(std::shared_ptr<effect>& value)
 	{
+		effect_batch batch;
+		if (!batch.add(value))
+			return false;
+		return batch.finish();
+	}
+
+	// Parallel shader compile values, missing from the bundled GLEW.  The KHR
+	// and ARB extensions share them
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+	typedef void (GLAPIENTRY * max_shader_compiler_threads_proc)(GLuint count);
+
+	// Whether the driver compiles in the background.  -1 until checked
+	static int parallel_compile = -1;
+
+	/*
+	Checks for parallel shader compile.  When first found, the driver is
+	allowed as many compiler threads as it likes, as it defaults to one
+	*/
+	bool effect_batch::is_parallel()
+	{
+		if (parallel_compile == -1)
+		{
+			parallel_compile = 0;
+			const char* names[] = { "GL_KHR_parallel_shader_compile", "glMaxShaderCompilerThreadsKHR",
+									"GL_ARB_parallel_shader_compile", "glMaxShaderCompilerThreadsARB" };
+			for (int i = 0; i < 4 && !parallel_compile; i += 2)
+			{
+				if (!glewGetExtension(names[i]))
+					continue;
+				auto max_threads = reinterpret_cast<max_shader_compiler_threads_proc>(renderer::get_instance().get_proc_address(names[i + 1]));
+				if (max_threads != nullptr)
+					max_threads(0xFFFFFFFF);
+				parallel_compile = 1;
+				std::clog << "Compiling shaders in parallel (" << names[i] << ")" << std::endl;
+			}
+		}
+		return parallel_compile == 1;
+	}
+
+	// Checks if the driver has finished compiling a shader
+	static bool is_complete(const shader& value)
+	{
+		if (!effect_batch::is_parallel())
+			return true;
+		GLint complete = GL_TRUE;
+		glGetShaderiv(value.id, GL_COMPLETION_STATUS_KHR, &complete);
+		return complete == GL_TRUE;
+	}
+
+	// Checks if the driver has finished linking a program
+	static bool is_complete(const effect& value)
+	{
+		if (!effect_batch::is_parallel())
+			return true;
+		GLint complete = GL_TRUE;
+		glGetProgramiv(value.program, GL_COMPLETION_STATUS_KHR, &complete);
+		return complete == GL_TRUE;
+	}
+
+	/*
+	Submits an effect.  The program is loaded from the program cache if the
+	same sources have been built before.  Otherwise its shaders are submitted
+	to the compiler, and linked by a later poll
+	*/
+	bool effect_batch::add(const std::shared_ptr<effect>& value)
+	{
+		is_parallel();
+
+		pending_effect pending;
+		pending.value = value;
+		pending.state = BUILD_COMPILING;
+
 		// Create program object
 		value->program = glCreateProgram();
 		CHECK_GL_ERROR;
-		// Check which shaders need to be built
+
+		// The program is named after its shaders
 		for (auto iter = value->shaders.begin(); iter != value->shaders.end(); ++iter)
+			pending.label += (pending.label.empty() ? "" : " + ") + (*iter)->filename;
+		gl_debug::label(GL_PROGRAM, value->program, pending.label);
+
+		// Key the program by the sources of its shaders
+		std::vector<GLenum> types;
+		std::vector<std::string> sources;
+		if (!get_sources(*value, types, sources))
 		{
-			if (!(*iter)->id)
+			glDeleteProgram(value->program);
+			value->program = 0;
+			return false;
+		}
+		auto& cache = program_cache::get_instance();
+		pending.key = cache.make_key(types, sources);
+
+		if (cache.load(value->program, pending.key))
+		{
+			std::clog << "Effect " << pending.label << " loaded from program cache" << std::endl;
+			pending.state = BUILD_LINKED;
+		}
+		else
+		{
+			// Submit the shaders not yet compiled
+			for (std::size_t i = 0; i < value->shaders.size(); ++i)
 			{
-				auto loaded = load_shader((*iter)->filename, (*iter)->type);
-				if (loaded == nullptr)
-					return nullptr;
-				else
-					(*iter) = loaded;
+				if (!value->shaders[i]->id)
+					value->shaders[i] = effect_loader::submit_shader(value->shaders[i]->filename, sources[i], types[i]);
 			}
 		}
 
-		// Now attach all the shaders involved into the program
-		for (auto iter = value->shaders.begin(); iter != value->shaders.end(); ++iter)
-			glAttachShader(value->program, (*iter)->id);
+		_effects.push_back(pending);
+		++_pending;
+		return true;
+	}
 
-		// Attempt to link program
-		glLinkProgram(value->program);
-		CHECK_GL_ERROR;
-		// Check if linked successfully.
-		// Link status
-		GLint linked;
-		glGetProgramiv(value->program, GL_LINK_STATUS, &linked);
-		if (!linked)
-		{
-			// Program did not link.  Get info log and display error
-			// Length of info log
-			GLsizei length;
-			// Get length of log
-			glGetProgramiv(value->program, GL_INFO_LOG_LENGTH, &length);
-			// Use length to create log buffer
-            // Info log
-			std::unique_ptr<char[]> log(new char[length]);
-			// Get info log
-			glGetProgramInfoLog(value->program, length, &length, log.get());
-			// Display error
-			std::cerr << "Error linking program" << std::endl;
-			std::cerr << log.get() << std::endl;
-			// Detach shaders
-			for (auto iter = value->shaders.begin(); iter != value->shaders.end(); ++iter)
-				glDetachShader(value->program, (*iter)->id);
-			// Delete program
-			glDeleteProgram(value->program);
+	/*
+	Moves an effect through compiling, linking and reflecting.  Unless wait
+	is set, stops at the first step the driver has not finished
+	*/
+	void effect_batch::advance(pending_effect& pending, bool wait)
+	{
+		effect& value = *pending.value;
+		if (pending.state == BUILD_COMPILING)
+		{
+			for (auto iter = value.shaders.begin(); iter != value.shaders.end(); ++iter)
+			{
+				if (!wait && !is_complete(**iter))
+					return;
+			}
+			// Every shader has finished.  Check them and start linking
+			for (auto iter = value.shaders.begin(); iter != value.shaders.end(); ++iter)
+			{
+				if (!effect_loader::check_shader(**iter))
+				{
+					fail(pending);
+					return;
+				}
+			}
+			for (auto iter = value.shaders.begin(); iter != value.shaders.end(); ++iter)
+				glAttachShader(value.program, (*iter)->id);
+			program_cache::get_instance().prepare(value.program);
+			glLinkProgram(value.program);
 			CHECK_GL_ERROR;
-			// Return false
-			return false;
+			pending.state = BUILD_LINKING;
 		}
-		
-		// Effect built successfully.  Log
-		std::clog << "Effect built" << std::endl;
 
+		if (pending.state == BUILD_LINKING)
+		{
+			if (!wait && !is_complete(value))
+				return;
+			// Check if linked successfully.
+			// Link status
+			GLint linked;
+			glGetProgramiv(value.program, GL_LINK_STATUS, &linked);
+			if (!linked)
+			{
+				// Program did not link.  Get info log and display error
+				// Length of info log
+				GLsizei length;
+				// Get length of log
+				glGetProgramiv(value.program, GL_INFO_LOG_LENGTH, &length);
+				// Use length to create log buffer
+				// Info log
+				std::unique_ptr<char[]> log(new char[length]);
+				// Get info log
+				glGetProgramInfoLog(value.program, length, &length, log.get());
+				// Display error
+				std::cerr << "Error linking program " << pending.label << std::endl;
+				std::cerr << log.get() << std::endl;
+				fail(pending);
+				return;
+			}
+
+			// Effect built successfully.  Log and add to the cache
+			std::clog << "Effect built" << std::endl;
+			program_cache::get_instance().save(value.program, pending.key);
+			pending.state = BUILD_LINKED;
+		}
+
+		if (pending.state == BUILD_LINKED)
+		{
+			// Uniforms are only reflected once the program is linked, as
+			// querying them sooner would wait for the driver
+			effect_loader::reflect(pending.value);
+			pending.state = BUILD_DONE;
+			--_pending;
+		}
+	}
+
+	// Deletes the program of an effect that failed to build
+	void effect_batch::fail(pending_effect& pending)
+	{
+		effect& value = *pending.value;
+		// Detach shaders
+		for (auto iter = value.shaders.begin(); iter != value.shaders.end(); ++iter)
+		{
+			if ((*iter)->id)
+				glDetachShader(value.program, (*iter)->id);
+		}
+		// Delete program
+		glDeleteProgram(value.program);
+		CHECK_GL_ERROR;
+		value.program = 0;
+		pending.state = BUILD_FAILED;
+		--_pending;
+		++_failed;
+	}
+
+	// Advances every effect without waiting.  Returns true once all are done
+	bool effect_batch::poll()
+	{
+		for (auto iter = _effects.begin(); iter != _effects.end(); ++iter)
+		{
+			if (iter->state != BUILD_DONE && iter->state != BUILD_FAILED)
+				advance(*iter, false);
+		}
+		return _pending == 0;
+	}
+
+	/*
+	Waits for every effect.  Effects that have finished are handled first,
+	so the wait is for the slowest rather than the first submitted
+	*/
+	bool effect_batch::finish()
+	{
+		poll();
+		for (auto iter = _effects.begin(); iter != _effects.end(); ++iter)
+		{
+			if (iter->state != BUILD_DONE && iter->state != BUILD_FAILED)
+				advance(*iter, true);
+		}
+		return _failed == 0;
+	}
+
+	// Finds the uniforms and uniform blocks of a linked effect
+	void effect_loader::reflect(std::shared_ptr<effect>& value)
+	{
 		// Now get the uniforms associated with the program
 		// Number of uniforms in the shader
 		GLint numUniforms;
@@ -192,6 +562,8 @@ namespace render_framework
 		CHECK_GL_ERROR;
 		// Initialise buffer at required length
 		buf.reset(new char[maxLength]);
+		// Next free binding point.  The frame block has its own reserved point
+		GLuint nextBinding = FRAME_BLOCK_BINDING + 1;
 		// Iterate through each block and add to effect data
 		for (int i = 0; i < numUniforms; ++i)
 		{
@@ -208,15 +580,27 @@ namespace render_framework
 				// Get block index
 				// Block index
 				GLuint blockIndex = glGetUniformBlockIndex(value->program, name.c_str());
-				// Bind the block to current index (i)
-				glUniformBlockBinding(value->program, blockIndex, i);
-				// Store the name mapped to this index
-				value->block_uniforms[name] = i;
+				// The frame block always uses the reserved binding point.  Other
+				// blocks are given the next free one
+				GLuint binding = (name == "frame") ? FRAME_BLOCK_BINDING : nextBinding++;
+				// Bind the block to the binding point
+				glUniformBlockBinding(value->program, blockIndex, binding);
+				// Store the name mapped to this binding point
+				value->block_uniforms[name] = binding;
 				CHECK_GL_ERROR;
 			}
 		}
 		
-		// All uniforms added to effect and effect built.  Return true
-		return true;
+		// Build the reflected tables used for handle based lookups
+		build_uniform_table(value->uniforms, value->uniform_table);
+		build_uniform_table(value->block_uniforms, value->block_table);
+
+		// Resolve the built in uniforms
+		for (int i = 0; i < BUILTIN_UNIFORM_COUNT; ++i)
+			value->builtin_uniforms[i] = value->get_location(uniform_handle(builtin_uniform_names[i]));
+
+		// Check if the model matrix is read per instance.  Such effects can be
+		// batched when drawing pooled geometry
+		value->uses_instance_model = glGetAttribLocation(value->program, "instance_model") != -1;
 	}
 }
\ No newline at end of file
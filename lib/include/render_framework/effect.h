@@ -4,10 +4,78 @@
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <cstdint>
 #include <GL\glew.h>
 
 namespace render_framework
 {
+	/*
+	Uniforms that the renderer sets on most draws.  The locations of these are
+	resolved when an effect is built so the renderer can set them directly
+	*/
+	enum BUILTIN_UNIFORM
+	{
+		UNIFORM_MODEL,
+		UNIFORM_VIEW,
+		UNIFORM_PROJECTION,
+		UNIFORM_MV,
+		UNIFORM_MVP,
+		UNIFORM_NORMAL_MATRIX,
+		UNIFORM_EYE_POSITION,
+		BUILTIN_UNIFORM_COUNT
+	};
+
+	/*
+	Hashes a uniform name (FNV-1a).  A hash can be continued from a previous
+	hash, allowing a name such as "light.colour" to be hashed from the hash of
+	"light" without building a new string
+	*/
+	inline std::uint32_t hash_uniform_name(const char* name, std::uint32_t hash = 2166136261u)
+	{
+		for (; *name; ++name)
+			hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+		return hash;
+	}
+
+	/*
+	Handle used to look up a uniform in an effect without hashing or allocating
+	a string.  Handles should be created once (for example as statics) and
+	reused every frame
+	*/
+	struct uniform_handle
+	{
+		// Hash of the uniform name
+		std::uint32_t hash;
+
+		// Creates a handle from a uniform name
+		explicit uniform_handle(const char* name) : hash(hash_uniform_name(name)) { }
+
+		// Creates a handle from a uniform name
+		explicit uniform_handle(const std::string& name) : hash(hash_uniform_name(name.c_str())) { }
+
+		// Creates a handle for a member of this uniform, e.g. "light" to
+		// "light.colour"
+		uniform_handle member(const char* suffix) const
+		{
+			uniform_handle value(*this);
+			value.hash = hash_uniform_name(suffix, hash);
+			return value;
+		}
+	};
+
+	/*
+	Entry in the reflected uniform table of an effect
+	*/
+	struct uniform_slot
+	{
+		// Hash of the uniform name
+		std::uint32_t hash;
+		// Location of the uniform (or binding point for a uniform block)
+		GLint location;
+		// The name of the uniform
+		std::string name;
+	};
+
 	/*
 	Data structure that defines a shader loaded in OpenGL
 	*/
@@ -48,14 +116,37 @@ namespace render_framework
 		// Vector containing the shaders that make up the effect
 		std::vector<std::shared_ptr<shader>> shaders;
 
+		// Preprocessor defines added to every shader of the effect, such as
+		// "NORMAL_MAP" or "LIGHT_COUNT 4".  Effects built from the same
+		// shaders with different defines are different programs
+		std::vector<std::string> defines;
+
 		// A map of uniforms mapped to their name in the compiled effect
 		std::unordered_map<std::string, GLint> uniforms;
 
 		// A map of uniform blocks mapped to their name in the compiled effect
 		std::unordered_map<std::string, GLint> block_uniforms;
 
+		// Reflected uniforms sorted by hash.  Slot indices are stable once the
+		// effect is built
+		std::vector<uniform_slot> uniform_table;
+
+		// Reflected uniform blocks sorted by hash
+		std::vector<uniform_slot> block_table;
+
+		// Locations of the built in uniforms.  -1 if not used by the effect
+		GLint builtin_uniforms[BUILTIN_UNIFORM_COUNT];
+
+		// Flag indicating the effect reads the model matrix from the
+		// instance_model attribute rather than the model uniform
+		bool uses_instance_model;
+
 		// Creates a new effect.  Ensures program is set to 0 (no program)
-		effect() : program(0) { }
+		effect() : program(0), uses_instance_model(false)
+		{
+			for (int i = 0; i < BUILTIN_UNIFORM_COUNT; ++i)
+				builtin_uniforms[i] = -1;
+		}
 
 		// Destroys an effect.  If program is a valid value (not 0) will delete
 		// the program.  Will also clear uniform maps
@@ -76,11 +167,63 @@ namespace render_framework
 				glDeleteProgram(program);
 			}
 			shaders.clear();
+			defines.clear();
 			uniforms.clear();
 			block_uniforms.clear();
+			uniform_table.clear();
+			block_table.clear();
 			program = 0;
 		}
 
+		/*
+		Gets the slot index of a uniform in the uniform table.  Returns -1 if
+		the uniform does not exist
+		*/
+		int get_slot(const uniform_handle& handle) const
+		{
+			return find_slot(uniform_table, handle.hash);
+		}
+
+		/*
+		Gets the location of a uniform.  Returns -1 if the uniform does not
+		exist
+		*/
+		GLint get_location(const uniform_handle& handle) const
+		{
+			int slot = find_slot(uniform_table, handle.hash);
+			return slot == -1 ? -1 : uniform_table[slot].location;
+		}
+
+		/*
+		Gets the binding point of a uniform block.  Returns -1 if the block
+		does not exist
+		*/
+		GLint get_block_binding(const uniform_handle& handle) const
+		{
+			int slot = find_slot(block_table, handle.hash);
+			return slot == -1 ? -1 : block_table[slot].location;
+		}
+
+		/*
+		Binary searches a sorted uniform table for the given hash
+		*/
+		static int find_slot(const std::vector<uniform_slot>& table, std::uint32_t hash)
+		{
+			int low = 0;
+			int high = static_cast<int>(table.size()) - 1;
+			while (low <= high)
+			{
+				int mid = (low + high) / 2;
+				if (table[mid].hash < hash)
+					low = mid + 1;
+				else if (table[mid].hash > hash)
+					high = mid - 1;
+				else
+					return mid;
+			}
+			return -1;
+		}
+
 		/*
 		Adds a shader to the effect
 		*/
@@ -99,6 +242,15 @@ namespace render_framework
 			s->type = type;
 			shaders.push_back(s);
 		}
+
+		/*
+		Adds a preprocessor define to the shaders of the effect.  Must be
+		called before the effect is built
+		*/
+		void add_define(const std::string& name)
+		{
+			defines.push_back(name);
+		}
 	};
 
 	/*
@@ -109,7 +261,96 @@ namespace render_framework
 	public:
 		// Loads a shader from a given filename
 		static std::shared_ptr<shader> load_shader(const std::string& filename, GLenum type);
-		// Builds an effect
+		// Reads a shader file, resolving #include lines and adding the given
+		// defines after the #version line
+		static bool preprocess(const std::string& filename, const std::vector<std::string>& defines, std::string& result);
+		// Compiles a shader from source.  filename is only used for messages
+		static std::shared_ptr<shader> compile_shader(const std::string& filename, const std::string& source, GLenum type);
+		// Starts compiling a shader from source without waiting for the result
+		static std::shared_ptr<shader> submit_shader(const std::string& filename, const std::string& source, GLenum type);
+		// Checks if a shader compiled, printing the log if not.  Waits for the
+		// compiler if it has not finished
+		static bool check_shader(const shader& value);
+		// Builds an effect, waiting for the driver
 		static bool build_effect(std::shared_ptr<effect>& value);
+		// Finds the uniforms and uniform blocks of a linked effect
+		static void reflect(std::shared_ptr<effect>& value);
+	};
+
+	/*
+	Builds a set of effects together.  Every shader is submitted to the
+	driver before any result is asked for, so a driver supporting
+	KHR_parallel_shader_compile can compile them on its own threads.  poll
+	moves each effect on without waiting, checking GL_COMPLETION_STATUS, so
+	the application can keep rendering (such as a loading screen) until it
+	returns true.  Uniforms are only reflected once an effect has linked.
+
+	Without parallel compile every check waits, so poll finishes the batch
+	in one call, as build_effect always has.
+	*/
+	class effect_batch
+	{
+	private:
+		// How far an effect has been built
+		enum BUILD_STATE
+		{
+			BUILD_COMPILING,
+			BUILD_LINKING,
+			BUILD_LINKED,
+			BUILD_DONE,
+			BUILD_FAILED
+		};
+
+		// An effect in the batch
+		struct pending_effect
+		{
+			// The effect being built
+			std::shared_ptr<effect> value;
+			// Program cache key of the effect
+			std::uint64_t key;
+			// How far the effect has been built
+			BUILD_STATE state;
+			// Name of the effect in messages
+			std::string label;
+		};
+
+		// The effects in the order they were added
+		std::vector<pending_effect> _effects;
+		// Number of effects not yet done or failed
+		unsigned int _pending;
+		// Number of effects that failed to build
+		unsigned int _failed;
+
+		// Moves an effect on.  If wait is set, waits for the driver rather
+		// than stopping at the first unfinished step
+		void advance(pending_effect& pending, bool wait);
+		// Deletes the program of an effect that failed to build
+		void fail(pending_effect& pending);
+	public:
+		// Creates an empty batch
+		effect_batch() : _pending(0), _failed(0) { }
+
+		// Checks if the driver compiles shaders in the background
+		static bool is_parallel();
+
+		// Submits an effect to be built.  Returns false if its shaders could
+		// not be read
+		bool add(const std::shared_ptr<effect>& value);
+
+		// Moves every effect on without waiting.  Returns true once every
+		// effect is built or has failed
+		bool poll();
+
+		// Waits for every effect to be built.  Returns false if any failed
+		bool finish();
+
+		// Gets the number of effects still being built
+		unsigned int get_pending() const { return _pending; }
+
+		// Gets the number of effects that failed to build
+		unsigned int get_failed() const { return _failed; }
+
+		// Checks if the batch has no effects still being built
+		bool is_done() const { return _pending == 0; }
 	};
 }
\ No newline at end of file
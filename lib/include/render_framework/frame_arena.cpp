@@ -0,0 +1,100 @@
+#include "frame_arena.h"
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+namespace render_framework
+{
+	frame_arena::frame_arena()
+		: _memory(nullptr), _capacity(0), _offset(0), _overflow_bytes(0), _high_water(0), _overflow_frames(0)
+	{
+	}
+
+	frame_arena::~frame_arena()
+	{
+		reset();
+		delete[] _memory;
+	}
+
+	// Allocates the block of memory used by the arena
+	bool frame_arena::initialise(std::size_t capacity)
+	{
+		reset();
+		delete[] _memory;
+		_memory = new (std::nothrow) char[capacity];
+		if (_memory == nullptr)
+		{
+			std::cerr << "Error - could not allocate frame arena of " << capacity << " bytes" << std::endl;
+			_capacity = 0;
+			return false;
+		}
+		_capacity = capacity;
+		_offset = 0;
+		return true;
+	}
+
+	/*
+	Moves the offset past the aligned allocation.  Falls back to the heap when
+	the block is full
+	*/
+	void* frame_arena::allocate(std::size_t size, std::size_t alignment)
+	{
+		// Align the address rather than the offset, as the block itself is
+		// only aligned for fundamental types
+		std::uintptr_t base = reinterpret_cast<std::uintptr_t>(_memory);
+		std::uintptr_t address = (base + _offset + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+		std::size_t end = static_cast<std::size_t>(address - base) + size;
+		if (_memory != nullptr && end <= _capacity)
+		{
+			_offset = end;
+			return reinterpret_cast<void*>(address);
+		}
+
+		// Out of space.  operator new is aligned for any fundamental type
+		void* memory = ::operator new(size);
+		_overflow.push_back(memory);
+		_overflow_bytes += size;
+		return memory;
+	}
+
+	// Frees every allocation made since the last reset
+	void frame_arena::reset()
+	{
+		_high_water = (std::max)(_high_water, get_used());
+		if (!_overflow.empty())
+		{
+			for (auto iter = _overflow.begin(); iter != _overflow.end(); ++iter)
+				::operator delete(*iter);
+			_overflow.clear();
+			++_overflow_frames;
+		}
+		_overflow_bytes = 0;
+		_offset = 0;
+	}
+
+	// Allocates each arena with the given size in bytes
+	bool frame_memory::initialise(std::size_t capacity)
+	{
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+			if (!_arenas[i].initialise(capacity))
+				return false;
+		_current = 0;
+		return true;
+	}
+
+	// Moves to the next arena and resets it
+	void frame_memory::begin_frame()
+	{
+		_current = (_current + 1) % FRAMES_IN_FLIGHT;
+		_arenas[_current].reset();
+	}
+
+	// Gets the highest high water mark of all the arenas
+	std::size_t frame_memory::get_high_water() const
+	{
+		std::size_t result = 0;
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+			result = (std::max)(result, (std::max)(_arenas[i].get_high_water(), _arenas[i].get_used()));
+		return result;
+	}
+}
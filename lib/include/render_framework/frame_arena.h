@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <limits>
+#include <type_traits>
+
+namespace render_framework
+{
+	// Number of frames of transient data kept alive at once.  Data allocated
+	// in a frame stays valid until this many frames have begun since
+	const unsigned int FRAMES_IN_FLIGHT = 3;
+
+	// Default size in bytes of each frame arena
+	const std::size_t DEFAULT_FRAME_ARENA_SIZE = 1 << 20;
+
+	/*
+	A linear (bump) allocator.  Allocations are made by moving an offset
+	through a single block of memory, and are all freed at once by reset.
+	Individual deallocation does nothing.
+
+	If the block is exhausted, allocations fall back to the heap and are
+	freed at the next reset.  The high water mark includes these, so it
+	shows how large the arena needs to be.
+	*/
+	class frame_arena
+	{
+	private:
+		// The block of memory allocated from
+		char* _memory;
+		// Size of the block in bytes
+		std::size_t _capacity;
+		// Bytes of the block used since the last reset
+		std::size_t _offset;
+		// Allocations which did not fit in the block
+		std::vector<void*> _overflow;
+		// Bytes allocated on the heap since the last reset
+		std::size_t _overflow_bytes;
+		// Most bytes used between two resets
+		std::size_t _high_water;
+		// Number of resets where the block was exhausted
+		unsigned int _overflow_frames;
+
+		// Private copy constructor.  The arena owns its memory
+		frame_arena(const frame_arena&);
+		// Private assignment operator
+		void operator=(const frame_arena&);
+	public:
+		// Creates an arena with no memory.  initialise must be called first
+		frame_arena();
+
+		// Frees the memory of the arena
+		~frame_arena();
+
+		// Allocates the block of memory used by the arena
+		bool initialise(std::size_t capacity = DEFAULT_FRAME_ARENA_SIZE);
+
+		// Allocates memory with the given alignment (a power of 2)
+		void* allocate(std::size_t size, std::size_t alignment = 16);
+
+		// Allocates uninitialised memory for an array of objects
+		template <typename T>
+		T* allocate_array(std::size_t count)
+		{
+			return static_cast<T*>(allocate(count * sizeof(T), std::alignment_of<T>::value));
+		}
+
+		// Frees every allocation made since the last reset
+		void reset();
+
+		// Gets the size of the block in bytes
+		std::size_t get_capacity() const { return _capacity; }
+
+		// Gets the bytes used since the last reset, including overflow
+		std::size_t get_used() const { return _offset + _overflow_bytes; }
+
+		// Gets the most bytes used between two resets, including overflow
+		std::size_t get_high_water() const { return _high_water; }
+
+		// Gets the number of resets where the block had been exhausted
+		unsigned int get_overflow_frames() const { return _overflow_frames; }
+	};
+
+	/*
+	A set of arenas, one for each frame in flight.  begin_frame moves to the
+	next arena and resets it, so data allocated in a frame is kept until the
+	arena comes round again.
+	*/
+	class frame_memory
+	{
+	private:
+		// An arena for each frame in flight
+		frame_arena _arenas[FRAMES_IN_FLIGHT];
+		// Index of the arena for the current frame
+		unsigned int _current;
+	public:
+		// Creates the frame memory.  initialise must be called first
+		frame_memory() : _current(0) { }
+
+		// Allocates each arena with the given size in bytes
+		bool initialise(std::size_t capacity = DEFAULT_FRAME_ARENA_SIZE);
+
+		// Moves to the next arena and resets it
+		void begin_frame();
+
+		// Gets the arena for the current frame
+		frame_arena& get_current() { return _arenas[_current]; }
+
+		// Gets the arena with the given index
+		const frame_arena& get_arena(unsigned int index) const { return _arenas[index]; }
+
+		// Gets the highest high water mark of all the arenas
+		std::size_t get_high_water() const;
+	};
+
+	/*
+	Adaptor allowing standard library containers to allocate from an arena.
+	Memory is only released when the arena is reset, so containers using it
+	must not be used after that
+	*/
+	template <typename T>
+	class arena_allocator
+	{
+	public:
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		template <typename U>
+		struct rebind
+		{
+			typedef arena_allocator<U> other;
+		};
+
+		// The arena allocated from
+		frame_arena* arena;
+
+		// Creates an allocator using the given arena
+		arena_allocator(frame_arena& value) : arena(&value) { }
+
+		// Creates an allocator using the arena of another allocator
+		template <typename U>
+		arena_allocator(const arena_allocator<U>& other) : arena(other.arena) { }
+
+		pointer address(reference value) const { return &value; }
+		const_pointer address(const_reference value) const { return &value; }
+
+		pointer allocate(size_type count, const void* = 0)
+		{
+			return arena->allocate_array<T>(count);
+		}
+
+		// Memory is freed when the arena is reset
+		void deallocate(pointer, size_type) { }
+
+		size_type max_size() const { return (std::numeric_limits<size_type>::max)() / sizeof(T); }
+
+		void construct(pointer p, const T& value) { new (static_cast<void*>(p)) T(value); }
+
+		void destroy(pointer p) { p->~T(); }
+	};
+
+	template <typename T, typename U>
+	bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) { return a.arena == b.arena; }
+
+	template <typename T, typename U>
+	bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) { return a.arena != b.arena; }
+
+	/*
+	A vector allocating from an arena.  Use as frame_vector<T>::type
+	*/
+	template <typename T>
+	struct frame_vector
+	{
+		typedef std::vector<T, arena_allocator<T>> type;
+	};
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm\glm.hpp>
+#include <GL\glew.h>
+#include "light.h"
+
+namespace render_framework
+{
+	// Uniform buffer binding point reserved for the per frame uniform block
+	const GLuint FRAME_BLOCK_BINDING = 0;
+
+	/*
+	Structure representing the values shared by every draw in a frame.  The
+	renderer uploads this once per frame to a uniform buffer bound at
+	FRAME_BLOCK_BINDING.  Effects access it by declaring the block:
+
+	layout (std140) uniform frame
+	{
+		mat4 view;
+		mat4 projection;
+		mat4 view_projection;
+		vec3 eye_position;
+		float time;
+		vec4 sun_ambient_intensity;
+		vec4 sun_colour;
+		vec3 sun_direction;
+	} frame_data;
+	*/
+	struct frame_data
+	{
+		// View matrix of the camera
+		glm::mat4 view;
+		// Projection matrix of the camera
+		glm::mat4 projection;
+		// Combined view-projection matrix
+		glm::mat4 view_projection;
+		// Position of the camera in world space
+		glm::vec3 eye_position;
+		// Time in seconds since the renderer was initialised.  Packs into the
+		// padding after eye_position
+		float time;
+		// The main scene light
+		directional_light_data sun;
+	};
+}
@@ -0,0 +1,59 @@
+#include "frame_stats.h"
+
+namespace render_framework
+{
+	// Zeroes the counters
+	void frame_stats::reset()
+	{
+		draw_calls = 0;
+		triangles = 0;
+		program_binds = 0;
+		vertex_array_binds = 0;
+		texture_binds = 0;
+		frame_buffer_binds = 0;
+		uniform_calls = 0;
+		uniform_block_binds = 0;
+		bytes_uploaded = 0;
+		state_changes = 0;
+		state_changes_elided = 0;
+	}
+
+	/*
+	Counts the triangles of a draw.  Strips and fans share vertices between
+	triangles.  Points and lines add no triangles
+	*/
+	void frame_stats::add_triangles(GLenum type, std::uint64_t count, std::uint64_t instances)
+	{
+		std::uint64_t per_instance = 0;
+		switch (type)
+		{
+		case GL_TRIANGLES:
+			per_instance = count / 3;
+			break;
+		case GL_TRIANGLE_STRIP:
+		case GL_TRIANGLE_FAN:
+			per_instance = count > 2 ? count - 2 : 0;
+			break;
+		default:
+			break;
+		}
+		triangles += per_instance * instances;
+	}
+
+	// Writes the names of the counters as a CSV header line
+	void frame_stats::write_csv_header(std::ostream& os)
+	{
+		os << "frame,draw_calls,triangles,program_binds,vertex_array_binds,texture_binds,"
+		   << "frame_buffer_binds,uniform_calls,uniform_block_binds,bytes_uploaded,"
+		   << "state_changes,state_changes_elided" << std::endl;
+	}
+
+	// Writes the counters as a CSV line
+	void frame_stats::write_csv(std::ostream& os, unsigned int frame) const
+	{
+		os << frame << ',' << draw_calls << ',' << triangles << ',' << program_binds << ','
+		   << vertex_array_binds << ',' << texture_binds << ',' << frame_buffer_binds << ','
+		   << uniform_calls << ',' << uniform_block_binds << ',' << bytes_uploaded << ','
+		   << state_changes << ',' << state_changes_elided << std::endl;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <GL\glew.h>
+
+namespace render_framework
+{
+	/*
+	Counts the work the renderer sends to OpenGL in a frame.  The counters
+	are reset by the first begin_render of each frame, so are complete once
+	end_render has been called
+	*/
+	struct frame_stats
+	{
+		// Number of draw calls
+		unsigned int draw_calls;
+		// Number of triangles drawn, across every instance
+		std::uint64_t triangles;
+		// Number of programs used
+		unsigned int program_binds;
+		// Number of vertex array objects bound
+		unsigned int vertex_array_binds;
+		// Number of textures bound
+		unsigned int texture_binds;
+		// Number of frame buffers bound
+		unsigned int frame_buffer_binds;
+		// Number of glUniform calls
+		unsigned int uniform_calls;
+		// Number of uniform buffers bound to blocks
+		unsigned int uniform_block_binds;
+		// Bytes of buffer data uploaded
+		std::uint64_t bytes_uploaded;
+		// Number of state calls passed on to OpenGL by the state tracker
+		unsigned int state_changes;
+		// Number of state calls skipped by the state tracker
+		unsigned int state_changes_elided;
+
+		// Creates a set of zeroed counters
+		frame_stats() { reset(); }
+
+		// Zeroes the counters
+		void reset();
+
+		// Counts a draw of count vertices of the given primitive type
+		void add_draw(GLenum type, std::uint64_t count, std::uint64_t instances = 1)
+		{
+			++draw_calls;
+			add_triangles(type, count, instances);
+		}
+
+		// Counts the triangles in count vertices of the given primitive type,
+		// without counting a draw call.  Used for multi draws
+		void add_triangles(GLenum type, std::uint64_t count, std::uint64_t instances = 1);
+
+		// Writes the names of the counters as a CSV header line
+		static void write_csv_header(std::ostream& os);
+
+		// Writes the counters as a CSV line, starting with the frame number
+		void write_csv(std::ostream& os, unsigned int frame) const;
+	};
+}
@@ -0,0 +1,77 @@
+#include "frame_timing.h"
+#include <cmath>
+#include <algorithm>
+
+namespace render_framework
+{
+	// Gets the bin of a frame time.  Negative times go in the first bin
+	unsigned int frame_timing::get_bin(double seconds)
+	{
+		if (seconds <= 0.0)
+			return 0;
+		double bin = std::floor(seconds / FRAME_TIMING_BIN_WIDTH);
+		return bin >= FRAME_TIMING_BINS ? FRAME_TIMING_BINS : static_cast<unsigned int>(bin);
+	}
+
+	// Removes every frame
+	void frame_timing::clear()
+	{
+		std::fill(_bins, _bins + FRAME_TIMING_BINS + 1, 0u);
+		_next = 0;
+		_count = 0;
+		_total = 0.0;
+		_frames = 0;
+	}
+
+	/*
+	Adds a frame time.  Once the window is full the oldest frame is taken out
+	of its bin before the new one is added
+	*/
+	void frame_timing::add(double seconds)
+	{
+		if (_count == FRAME_TIMING_WINDOW)
+		{
+			float oldest = _samples[_next];
+			--_bins[get_bin(oldest)];
+			_total -= oldest;
+		}
+		else
+			++_count;
+
+		_samples[_next] = static_cast<float>(seconds);
+		++_bins[get_bin(seconds)];
+		_total += seconds;
+		_next = (_next + 1) % FRAME_TIMING_WINDOW;
+		++_frames;
+	}
+
+	// Gets the longest frame time in the window
+	double frame_timing::get_max() const
+	{
+		if (_count == 0)
+			return 0.0;
+		return *std::max_element(_samples, _samples + _count);
+	}
+
+	/*
+	Walks the bins until the requested number of frames have been passed,
+	returning the top of that bin, or the longest frame if that is shorter.
+	Frames in the overflow bin are reported as the longest frame
+	*/
+	double frame_timing::get_percentile(double fraction) const
+	{
+		if (_count == 0)
+			return 0.0;
+
+		fraction = (std::min)((std::max)(fraction, 0.0), 1.0);
+		unsigned int target = (std::max)(1u, static_cast<unsigned int>(std::ceil(fraction * _count)));
+		unsigned int seen = 0;
+		for (unsigned int i = 0; i < FRAME_TIMING_BINS; ++i)
+		{
+			seen += _bins[i];
+			if (seen >= target)
+				return (std::min)((i + 1) * FRAME_TIMING_BIN_WIDTH, get_max());
+		}
+		return get_max();
+	}
+}
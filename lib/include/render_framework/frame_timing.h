@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace render_framework
+{
+	// Number of frames kept by the frame timing histogram
+	const unsigned int FRAME_TIMING_WINDOW = 1024;
+
+	// Number of histogram bins.  Times past the last bin go in an overflow bin
+	const unsigned int FRAME_TIMING_BINS = 1000;
+
+	// Width of each histogram bin in seconds (0.1 ms)
+	const double FRAME_TIMING_BIN_WIDTH = 0.0001;
+
+	/*
+	A rolling histogram of the last FRAME_TIMING_WINDOW frame times.  Each new
+	frame is added to its bin and the oldest frame removed from its own, so
+	percentiles can be read at any time by walking the bins rather than
+	sorting the samples.  Percentiles are accurate to the bin width.
+	*/
+	class frame_timing
+	{
+	private:
+		// Number of frames in each bin.  The last bin holds overflow
+		unsigned int _bins[FRAME_TIMING_BINS + 1];
+		// Frame times in the window, oldest at _next once full
+		float _samples[FRAME_TIMING_WINDOW];
+		// Position in _samples the next frame is written to
+		unsigned int _next;
+		// Number of frames in the window
+		unsigned int _count;
+		// Sum of the frame times in the window
+		double _total;
+		// Total number of frames added
+		std::uint64_t _frames;
+
+		// Gets the bin of a frame time
+		static unsigned int get_bin(double seconds);
+	public:
+		// Creates an empty histogram
+		frame_timing() { clear(); }
+
+		// Removes every frame
+		void clear();
+
+		// Adds the time of a frame in seconds, replacing the oldest if full
+		void add(double seconds);
+
+		// Gets the number of frames in the window
+		unsigned int get_count() const { return _count; }
+
+		// Gets the total number of frames added since the last clear
+		std::uint64_t get_frames() const { return _frames; }
+
+		// Gets the mean frame time of the window in seconds
+		double get_mean() const { return _count > 0 ? _total / _count : 0.0; }
+
+		// Gets the longest frame time in the window in seconds
+		double get_max() const;
+
+		// Gets the frame time in seconds that the given fraction (0 to 1) of
+		// frames in the window were at or under
+		double get_percentile(double fraction) const;
+	};
+}
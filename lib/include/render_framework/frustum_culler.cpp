@@ -0,0 +1,182 @@
+#include "frustum_culler.h"
+#include "camera.h"
+#include "geometry.h"
+#include <algorithm>
+#include <cmath>
+
+// SSE is available on every x86 target we build for.  AVX is only used when
+// the compiler has been told it can (/arch:AVX or -mavx)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define FRUSTUM_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX__)
+#define FRUSTUM_CULLER_AVX
+#include <immintrin.h>
+#endif
+
+namespace render_framework
+{
+	frustum_culler::frustum_culler() : _plane_count(0), _path(get_widest_path())
+	{
+	}
+
+	CULL_PATH frustum_culler::get_widest_path()
+	{
+#if defined(FRUSTUM_CULLER_AVX)
+		return CULL_AVX;
+#elif defined(FRUSTUM_CULLER_SSE)
+		return CULL_SSE;
+#else
+		return CULL_SCALAR;
+#endif
+	}
+
+	CULL_PATH frustum_culler::set_path(CULL_PATH path)
+	{
+		_path = (std::min)(path, get_widest_path());
+		return _path;
+	}
+
+	void frustum_culler::clear()
+	{
+		_x.clear();
+		_y.clear();
+		_z.clear();
+		_radius.clear();
+		_visible.clear();
+	}
+
+	void frustum_culler::reserve(std::size_t count)
+	{
+		_x.reserve(count);
+		_y.reserve(count);
+		_z.reserve(count);
+		_radius.reserve(count);
+		_visible.reserve(count);
+	}
+
+	std::uint32_t frustum_culler::add(const glm::vec3& centre, float radius)
+	{
+		_x.push_back(centre.x);
+		_y.push_back(centre.y);
+		_z.push_back(centre.z);
+		_radius.push_back(radius);
+		return static_cast<std::uint32_t>(_x.size() - 1);
+	}
+
+	std::uint32_t frustum_culler::add(const geometry& geom, const glm::mat4& model)
+	{
+		// Move the centre into world space
+		glm::vec3 centre = glm::vec3(model * glm::vec4(geom.sphere_centre, 1.0f));
+		// Scale the radius by the largest scale of the model matrix
+		float scale2 = std::max(std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+										 glm::dot(glm::vec3(model[1]), glm::vec3(model[1]))),
+										 glm::dot(glm::vec3(model[2]), glm::vec3(model[2])));
+		return add(centre, geom.sphere_radius * std::sqrt(scale2));
+	}
+
+	/*
+	Extracts the planes using the Gribb-Hartmann method.  Each plane is a sum or
+	difference of the fourth row of the matrix and one of the others
+	*/
+	void frustum_culler::set_frustum(const glm::mat4& m, bool test_far)
+	{
+		// glm is column major, so row i is m[0][i], m[1][i], ...
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; ++i)
+			rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+		_planes[0] = rows[3] + rows[0];	// Left
+		_planes[1] = rows[3] - rows[0];	// Right
+		_planes[2] = rows[3] + rows[1];	// Bottom
+		_planes[3] = rows[3] - rows[1];	// Top
+		_planes[4] = rows[3] + rows[2];	// Near
+		_planes[5] = rows[3] - rows[2];	// Far
+
+		// Normalise so that plane distances are in world units
+		for (int i = 0; i < 6; ++i)
+			_planes[i] /= glm::length(glm::vec3(_planes[i]));
+
+		_plane_count = test_far ? 6 : 5;
+	}
+
+	void frustum_culler::set_frustum(const camera& cam, bool test_far)
+	{
+		set_frustum(cam.get_projection() * cam.get_view(), test_far);
+	}
+
+	bool frustum_culler::is_visible(const glm::vec3& centre, float radius) const
+	{
+		for (unsigned int p = 0; p < _plane_count; ++p)
+			if (glm::dot(glm::vec3(_planes[p]), centre) + _planes[p].w < -radius)
+				return false;
+		return true;
+	}
+
+	std::size_t frustum_culler::cull()
+	{
+		std::size_t count = _x.size();
+		// Written directly rather than pushed, then trimmed to size
+		_visible.resize(count);
+		std::uint32_t* out = count ? &_visible[0] : nullptr;
+		std::size_t visible = 0;
+		std::size_t i = 0;
+
+#if defined(FRUSTUM_CULLER_AVX)
+		// Eight spheres at a time
+		for (; _path >= CULL_AVX && i + 8 <= count; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(&_x[i]);
+			__m256 y = _mm256_loadu_ps(&_y[i]);
+			__m256 z = _mm256_loadu_ps(&_z[i]);
+			__m256 neg_r = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&_radius[i]));
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (unsigned int p = 0; p < _plane_count; ++p)
+			{
+				__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(_planes[p].x), x),
+													   _mm256_mul_ps(_mm256_set1_ps(_planes[p].y), y)),
+										 _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(_planes[p].z), z),
+													   _mm256_set1_ps(_planes[p].w)));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, neg_r, _CMP_GE_OQ));
+			}
+			// Write out the index of each visible sphere
+			int mask = _mm256_movemask_ps(inside);
+			for (std::uint32_t j = 0; mask; ++j, mask >>= 1)
+				if (mask & 1)
+					out[visible++] = static_cast<std::uint32_t>(i) + j;
+		}
+#endif
+#if defined(FRUSTUM_CULLER_SSE)
+		// Four spheres at a time
+		for (; _path >= CULL_SSE && i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&_x[i]);
+			__m128 y = _mm_loadu_ps(&_y[i]);
+			__m128 z = _mm_loadu_ps(&_z[i]);
+			__m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&_radius[i]));
+			__m128 inside = _mm_cmpeq_ps(x, x);
+			for (unsigned int p = 0; p < _plane_count; ++p)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(_planes[p].x), x),
+												 _mm_mul_ps(_mm_set1_ps(_planes[p].y), y)),
+									  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(_planes[p].z), z),
+												 _mm_set1_ps(_planes[p].w)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_r));
+			}
+			// Write out the index of each visible sphere
+			int mask = _mm_movemask_ps(inside);
+			for (std::uint32_t j = 0; mask; ++j, mask >>= 1)
+				if (mask & 1)
+					out[visible++] = static_cast<std::uint32_t>(i) + j;
+		}
+#endif
+		// Remaining spheres one at a time
+		for (; i < count; ++i)
+			if (is_visible(glm::vec3(_x[i], _y[i], _z[i]), _radius[i]))
+				out[visible++] = static_cast<std::uint32_t>(i);
+
+		_visible.resize(visible);
+		return visible;
+	}
+}
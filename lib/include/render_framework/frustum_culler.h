@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm\glm.hpp>
+
+namespace render_framework
+{
+	// Forward declarations
+	class camera;
+	struct geometry;
+
+	// Instruction sets cull can test spheres with, narrowest first
+	enum CULL_PATH
+	{
+		CULL_SCALAR,
+		CULL_SSE,
+		CULL_AVX
+	};
+
+	/*
+	Tests bounding spheres against a view frustum.  Spheres are stored as
+	separate arrays of x, y, z and radius (structure of arrays) so that the
+	test can run on four (SSE) or eight (AVX) spheres at once.
+
+	Effects may remap depth (e.g. logarithmic depth), in which case the far
+	plane of the projection is not where drawing actually stops.  The far
+	plane test can therefore be turned off.
+
+	cull uses the widest instruction set compiled in.  A narrower one can be
+	chosen with set_path, so the paths can be compared
+	*/
+	class frustum_culler
+	{
+	private:
+		// Sphere centres and radii in world space
+		std::vector<float> _x;
+		std::vector<float> _y;
+		std::vector<float> _z;
+		std::vector<float> _radius;
+		// Indices of the spheres found to be visible by the last cull
+		std::vector<std::uint32_t> _visible;
+		// Frustum planes.  xyz is the inward facing normal, w the distance
+		glm::vec4 _planes[6];
+		// Number of planes to test.  5 skips the far plane
+		unsigned int _plane_count;
+		// The widest instruction set cull uses
+		CULL_PATH _path;
+	public:
+		// Creates an empty culler with a frustum that contains everything
+		frustum_culler();
+
+		// Removes all spheres.  Storage is kept for reuse
+		void clear();
+
+		// Reserves storage for the given number of spheres
+		void reserve(std::size_t count);
+
+		// Adds a world space sphere.  Returns its index
+		std::uint32_t add(const glm::vec3& centre, float radius);
+
+		// Adds the bounding sphere of a piece of geometry transformed by a
+		// model matrix.  Returns its index
+		std::uint32_t add(const geometry& geom, const glm::mat4& model);
+
+		// Gets the number of spheres
+		std::size_t size() const { return _x.size(); }
+
+		// Extracts the frustum planes from a view-projection matrix
+		void set_frustum(const glm::mat4& view_projection, bool test_far = true);
+
+		// Extracts the frustum planes from the view and projection of a camera
+		void set_frustum(const camera& cam, bool test_far = true);
+
+		// Gets the widest instruction set compiled in
+		static CULL_PATH get_widest_path();
+
+		// Sets the widest instruction set cull uses.  Paths not compiled in
+		// fall back to the widest that is.  Returns the path set
+		CULL_PATH set_path(CULL_PATH path);
+
+		// Gets the widest instruction set cull uses
+		CULL_PATH get_path() const { return _path; }
+
+		// Tests every sphere against the frustum.  Returns the number visible
+		std::size_t cull();
+
+		// Gets the indices of the spheres visible after the last cull
+		const std::vector<std::uint32_t>& get_visible() const { return _visible; }
+
+		// Tests a single sphere against the frustum
+		bool is_visible(const glm::vec3& centre, float radius) const;
+	};
+}
@@ -2,12 +2,47 @@
 #include <glm\gtx\norm.hpp>
 #include <memory>
 #include <array>
+#include <algorithm>
+#include <cmath>
 
 namespace render_framework
 {
+	// Calculates the bounding box and sphere of a piece of geometry
+	void geometry_builder::compute_bounds(std::shared_ptr<geometry> geom)
+	{
+		if (geom->positions.empty())
+		{
+			geom->bounds_min = geom->bounds_max = geom->sphere_centre = glm::vec3(0.0f);
+			geom->sphere_radius = 0.0f;
+			return;
+		}
+
+		// Find the box containing every position
+		glm::vec3 low = geom->positions[0];
+		glm::vec3 high = geom->positions[0];
+		for (auto& p : geom->positions)
+		{
+			low = glm::min(low, p);
+			high = glm::max(high, p);
+		}
+		geom->bounds_min = low;
+		geom->bounds_max = high;
+
+		// Sphere is centred on the box.  The radius is the furthest position
+		// from the centre, which is tighter than the box corner
+		geom->sphere_centre = (low + high) * 0.5f;
+		float radius2 = 0.0f;
+		for (auto& p : geom->positions)
+			radius2 = std::max(radius2, glm::length2(p - geom->sphere_centre));
+		geom->sphere_radius = std::sqrt(radius2);
+	}
+
 	// Initialises a piece of geometry
 	bool geometry_builder::initialise_geometry(std::shared_ptr<geometry> geom)
 	{
+		// Calculate the bounds from the positions
+		compute_bounds(geom);
+
 		// Generate and bind vertex array
 		glGenVertexArrays(1, &geom->vertex_array_object);
 		glBindVertexArray(geom->vertex_array_object);
@@ -163,10 +198,37 @@ namespace render_framework
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, geom->indices.size() * sizeof(unsigned int), &geom->indices[0], GL_STATIC_DRAW);
 		}
 
+		// Create the instance buffer.  This holds a model matrix per instance
+		// for instanced rendering, starting with a single identity matrix so
+		// that non-instanced draws read a valid value
+		glGenBuffers(1, &geom->instance_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, geom->instance_buffer);
+		glm::mat4 identity(1.0f);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), &identity, GL_STREAM_DRAW);
+		geom->instance_capacity = 1;
+		set_instance_attributes(geom->instance_buffer);
+		geom->instance_source = geom->instance_buffer;
+
 		// Return true
 		return true;
 	}
 
+	/*
+	A matrix attribute takes one location per column (7 to 10).  Each column
+	advances once per instance rather than once per vertex, so the base
+	instance of a draw selects its matrix
+	*/
+	void geometry_builder::set_instance_attributes(GLuint buffer)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		for (GLuint i = 0; i < 4; ++i)
+		{
+			glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), reinterpret_cast<const GLvoid*>(i * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(7 + i);
+			glVertexAttribDivisor(7 + i, 1);
+		}
+	}
+
 	// Data required for box geometry
 	glm::vec3 box_positions[24] =
 	{
@@ -7,6 +7,9 @@
 
 namespace render_framework
 {
+	// Forward declaration of geometry pool
+	class geometry_pool;
+
 	/*
 	A structure that stores information representing a geometric object
 	*/
@@ -32,6 +35,31 @@ namespace render_framework
         GLuint texture_weight_buffer;
 		// ID of buffer of indices as stored by OpenGL
 		GLuint index_buffer;
+		// ID of buffer of per instance model matrices as stored by OpenGL
+		GLuint instance_buffer;
+		// Number of matrices the instance buffer can currently hold
+		unsigned int instance_capacity;
+		// Buffer the instance attributes of the vertex array read from.
+		// Either instance_buffer, or the renderer's model ring for single
+		// draws.  Switched by the renderer when drawing, hence mutable
+		mutable GLuint instance_source;
+		// Pool the geometry has been added to.  nullptr if not pooled
+		geometry_pool* pool;
+		// First index of the geometry in the pool index buffer
+		GLuint pool_first_index;
+		// Number of indices of the geometry in the pool
+		GLuint pool_index_count;
+		// Offset added to the indices to find the vertices in the pool
+		GLint pool_base_vertex;
+
+		// Minimum corner of the axis aligned bounding box in model space
+		glm::vec3 bounds_min;
+		// Maximum corner of the axis aligned bounding box in model space
+		glm::vec3 bounds_max;
+		// Centre of the bounding sphere in model space
+		glm::vec3 sphere_centre;
+		// Radius of the bounding sphere
+		float sphere_radius;
 
 		// Vector containing position data
 		std::vector<glm::vec3> positions;
@@ -63,7 +91,18 @@ namespace render_framework
 					 binormal_buffer(0),
 					 colour_buffer(0),
                      texture_weight_buffer(0),
-					 index_buffer(0)
+					 index_buffer(0),
+					 instance_buffer(0),
+					 instance_capacity(0),
+					 instance_source(0),
+					 pool(nullptr),
+					 pool_first_index(0),
+					 pool_index_count(0),
+					 pool_base_vertex(0),
+					 bounds_min(0.0f),
+					 bounds_max(0.0f),
+					 sphere_centre(0.0f),
+					 sphere_radius(0.0f)
 		{
 		}
 
@@ -81,10 +120,14 @@ namespace render_framework
 			if (colour_buffer) glDeleteBuffers(1, &colour_buffer);
             if (texture_weight_buffer) glDeleteBuffers(1, & texture_weight_buffer);
 			if (index_buffer) glDeleteBuffers(1, &index_buffer);
+			if (instance_buffer) glDeleteBuffers(1, &instance_buffer);
 			if (vertex_array_object) glDeleteVertexArrays(1, &vertex_array_object);
 			// Set all buffer values to 0 (no buffer)
 			vertex_array_object = position_buffer = normal_buffer = tex_coord_buffer
-			= tangent_buffer = binormal_buffer = colour_buffer = texture_weight_buffer = index_buffer = 0;
+			= tangent_buffer = binormal_buffer = colour_buffer = texture_weight_buffer = index_buffer
+			= instance_buffer = 0;
+			instance_capacity = 0;
+			instance_source = 0;
 		}
 	};
 
@@ -96,6 +139,11 @@ namespace render_framework
 	public:
 		// Initialises a piece of geometry
 		static bool initialise_geometry(std::shared_ptr<geometry> geom);
+		// Points the instance_model attribute (locations 7 to 10) of the
+		// bound vertex array at a buffer of model matrices
+		static void set_instance_attributes(GLuint buffer);
+		// Calculates the bounding box and sphere of a piece of geometry
+		static void compute_bounds(std::shared_ptr<geometry> geom);
 		// Creates a simple box geometry
 		static std::shared_ptr<geometry> create_box(const glm::vec3& dimensions = glm::vec3(1.0f, 1.0f, 1.0f));
 		// Creates a tetrahedron geometry
@@ -0,0 +1,302 @@
+#include "geometry_pool.h"
+#include "geometry.h"
+#include "gl_debug.h"
+#include "renderer.h"
+#include "util.h"
+#include <iostream>
+#include <algorithm>
+#include <cstddef>
+
+namespace render_framework
+{
+	geometry_pool::geometry_pool()
+		: _vertex_array(0), _vertex_buffer(0), _index_buffer(0), _draw_buffer(0),
+		  _geometry_type(GL_TRIANGLES), _vertex_capacity(0), _index_capacity(0), _vertex_count(0),
+		  _index_count(0), _draw_capacity(0)
+	{
+	}
+
+	geometry_pool::~geometry_pool()
+	{
+		// For each buffer, check if valid (non 0) and delete
+		if (_vertex_buffer) glDeleteBuffers(1, &_vertex_buffer);
+		if (_index_buffer) glDeleteBuffers(1, &_index_buffer);
+		if (_draw_buffer) glDeleteBuffers(1, &_draw_buffer);
+		if (_vertex_array) glDeleteVertexArrays(1, &_vertex_array);
+		_vertex_array = _vertex_buffer = _index_buffer = _draw_buffer = 0;
+	}
+
+	/*
+	Points the vertex array attributes at the vertex and index buffers and
+	the renderer's model ring.  Called whenever a buffer is replaced
+	*/
+	void geometry_pool::setup_vertex_array()
+	{
+		glBindVertexArray(_vertex_array);
+
+		// Per vertex attributes, interleaved in the vertex buffer
+		glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffer);
+		GLsizei stride = sizeof(pool_vertex);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offsetof(pool_vertex, position)));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offsetof(pool_vertex, normal)));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offsetof(pool_vertex, tex_coord)));
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offsetof(pool_vertex, colour)));
+		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offsetof(pool_vertex, tangent)));
+		glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(offsetof(pool_vertex, binormal)));
+		for (GLuint i = 0; i < 6; ++i)
+			glEnableVertexAttribArray(i);
+
+		// Per draw model matrix.  The base instance of each draw selects its
+		// matrix in the model ring
+		geometry_builder::set_instance_attributes(renderer::get_instance().get_model_buffer());
+
+		// Index buffer binding is stored in the vertex array
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _index_buffer);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	bool geometry_pool::initialise(unsigned int vertex_capacity, unsigned int index_capacity, GLenum geometry_type)
+	{
+		// Check if already initialised
+		if (_vertex_array)
+		{
+			std::cerr << "Geometry pool already initialised" << std::endl;
+			return false;
+		}
+
+		// Model matrices are read from the renderer's model ring
+		if (!renderer::get_instance().get_model_buffer())
+		{
+			std::cerr << "Cannot initialise geometry pool - renderer not initialised" << std::endl;
+			return false;
+		}
+
+		_geometry_type = geometry_type;
+		_vertex_capacity = std::max(vertex_capacity, 1u);
+		_index_capacity = std::max(index_capacity, 1u);
+		_draw_capacity = 64;
+
+		// Generate the vertex array and buffers
+		glGenVertexArrays(1, &_vertex_array);
+		glGenBuffers(1, &_vertex_buffer);
+		glGenBuffers(1, &_index_buffer);
+		glGenBuffers(1, &_draw_buffer);
+
+		// Allocate storage.  Geometry is copied in as it is added
+		glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, _vertex_capacity * sizeof(pool_vertex), nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, _index_buffer);
+		glBufferData(GL_ARRAY_BUFFER, _index_capacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _draw_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, _draw_capacity * sizeof(draw_elements_command), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		gl_debug::label(GL_BUFFER, _vertex_buffer, "geometry pool vertices");
+		gl_debug::label(GL_BUFFER, _index_buffer, "geometry pool indices");
+		gl_debug::label(GL_BUFFER, _draw_buffer, "geometry pool draws");
+
+		setup_vertex_array();
+		gl_debug::label(GL_VERTEX_ARRAY, _vertex_array, "geometry pool");
+		return !CHECK_GL_ERROR;
+	}
+
+	/*
+	Grows the vertex and index buffers.  The existing contents are copied on
+	the GPU, so pooled geometry keeps its offsets
+	*/
+	bool geometry_pool::reserve(unsigned int vertices, unsigned int indices)
+	{
+		// Check if there is already enough room
+		if (vertices <= _vertex_capacity && indices <= _index_capacity)
+			return true;
+
+		if (vertices > _vertex_capacity)
+		{
+			unsigned int capacity = std::max(vertices, _vertex_capacity * 2);
+			GLuint buffer;
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(pool_vertex), nullptr, GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_READ_BUFFER, _vertex_buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, _vertex_count * sizeof(pool_vertex));
+			glDeleteBuffers(1, &_vertex_buffer);
+			_vertex_buffer = buffer;
+			_vertex_capacity = capacity;
+			gl_debug::label(GL_BUFFER, _vertex_buffer, "geometry pool vertices");
+		}
+		if (indices > _index_capacity)
+		{
+			unsigned int capacity = std::max(indices, _index_capacity * 2);
+			GLuint buffer;
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_READ_BUFFER, _index_buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, _index_count * sizeof(unsigned int));
+			glDeleteBuffers(1, &_index_buffer);
+			_index_buffer = buffer;
+			gl_debug::label(GL_BUFFER, _index_buffer, "geometry pool indices");
+			_index_capacity = capacity;
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		// Point the vertex array at the new buffers
+		setup_vertex_array();
+		return !CHECK_GL_ERROR;
+	}
+
+	bool geometry_pool::add(std::shared_ptr<geometry> geom)
+	{
+		// Check the pool has been initialised
+		if (!_vertex_array)
+		{
+			std::cerr << "Cannot add geometry to pool - pool not initialised" << std::endl;
+			return false;
+		}
+		// Every draw in a multi draw uses the same primitive type
+		if (geom->geometry_type != _geometry_type)
+		{
+			std::cerr << "Cannot add geometry to pool - geometry type does not match pool" << std::endl;
+			return false;
+		}
+		// Check if already pooled
+		if (geom->pool != nullptr)
+		{
+			std::cerr << "Geometry has already been added to a pool" << std::endl;
+			return false;
+		}
+		if (geom->positions.empty())
+			return false;
+
+		// Calculate the bounds from the positions
+		geometry_builder::compute_bounds(geom);
+
+		// Build the interleaved vertices.  Missing attributes are zero
+		std::vector<pool_vertex> vertices(geom->positions.size());
+		for (std::size_t i = 0; i < vertices.size(); ++i)
+		{
+			pool_vertex& v = vertices[i];
+			v.position = geom->positions[i];
+			v.normal = i < geom->normals.size() ? geom->normals[i] : glm::vec3(0.0f);
+			v.tex_coord = i < geom->tex_coords.size() ? geom->tex_coords[i] : glm::vec2(0.0f);
+			v.colour = i < geom->colours.size() ? geom->colours[i] : glm::vec4(0.0f);
+			v.tangent = i < geom->tangents.size() ? geom->tangents[i] : glm::vec3(0.0f);
+			v.binormal = i < geom->binormals.size() ? geom->binormals[i] : glm::vec3(0.0f);
+		}
+
+		// Geometry without indices is drawn in vertex order
+		std::vector<unsigned int> generated;
+		const std::vector<unsigned int>* indices = &geom->indices;
+		if (indices->empty())
+		{
+			generated.resize(vertices.size());
+			for (std::size_t i = 0; i < generated.size(); ++i)
+				generated[i] = static_cast<unsigned int>(i);
+			indices = &generated;
+		}
+
+		// Make room
+		unsigned int vertex_count = static_cast<unsigned int>(vertices.size());
+		unsigned int index_count = static_cast<unsigned int>(indices->size());
+		if (!reserve(_vertex_count + vertex_count, _index_count + index_count))
+		{
+			std::cerr << "Error growing geometry pool" << std::endl;
+			return false;
+		}
+
+		// Copy the data into the end of the buffers
+		glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, _vertex_count * sizeof(pool_vertex), vertex_count * sizeof(pool_vertex), &vertices[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, _index_buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, _index_count * sizeof(unsigned int), index_count * sizeof(unsigned int), &(*indices)[0]);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error copying geometry into pool" << std::endl;
+			return false;
+		}
+
+		// Record where the geometry lives.  Indices are relative to the
+		// geometry, so the base vertex offsets them
+		geom->pool = this;
+		geom->pool_first_index = _index_count;
+		geom->pool_index_count = index_count;
+		geom->pool_base_vertex = static_cast<GLint>(_vertex_count);
+		_vertex_count += vertex_count;
+		_index_count += index_count;
+		return true;
+	}
+
+	void geometry_pool::begin_batch()
+	{
+		// Storage is kept so batches do not allocate once warmed up
+		_commands.clear();
+		_models.clear();
+	}
+
+	void geometry_pool::add_draw(const geometry& geom, const glm::mat4& model)
+	{
+		draw_elements_command command;
+		command.count = geom.pool_index_count;
+		command.instance_count = 1;
+		command.first_index = geom.pool_first_index;
+		command.base_vertex = geom.pool_base_vertex;
+		// The base instance selects the model matrix for this draw
+		command.base_instance = static_cast<GLuint>(_models.size());
+		_commands.push_back(command);
+		_models.push_back(model);
+	}
+
+	bool geometry_pool::draw_batch()
+	{
+		if (_commands.empty())
+			return true;
+
+		// Stream the model matrices into the model ring and offset the base
+		// instance of each command to its slot
+		GLsizei count = static_cast<GLsizei>(_commands.size());
+		GLuint first = renderer::get_instance().stream_models(&_models[0], count);
+		for (auto& c : _commands)
+			c.base_instance += first;
+		frame_stats& stats = renderer::get_instance().edit_frame_stats();
+
+		// Grow the draw buffer if needed
+		if (_commands.size() > _draw_capacity)
+			_draw_capacity = std::max(static_cast<unsigned int>(_commands.size()), _draw_capacity * 2);
+
+		if (GLEW_ARB_multi_draw_indirect)
+		{
+			// One call for the whole batch
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _draw_buffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, _draw_capacity * sizeof(draw_elements_command), nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, count * sizeof(draw_elements_command), &_commands[0]);
+			glMultiDrawElementsIndirect(_geometry_type, GL_UNSIGNED_INT, 0, count, 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			stats.bytes_uploaded += count * sizeof(draw_elements_command);
+			// One call, but count the triangles of every command
+			++stats.draw_calls;
+			for (auto& c : _commands)
+				stats.add_triangles(_geometry_type, c.count, c.instance_count);
+		}
+		else
+		{
+			// No multi draw.  Issue the commands one at a time, still without
+			// switching any state
+			for (auto& c : _commands)
+			{
+				glDrawElementsInstancedBaseVertexBaseInstance(_geometry_type, c.count, GL_UNSIGNED_INT,
+					reinterpret_cast<const GLvoid*>(c.first_index * sizeof(unsigned int)), c.instance_count, c.base_vertex, c.base_instance);
+				stats.add_draw(_geometry_type, c.count, c.instance_count);
+			}
+		}
+
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error trying to draw geometry pool batch" << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
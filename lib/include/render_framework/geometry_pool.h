@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <GL\glew.h>
+#include <glm\glm.hpp>
+
+namespace render_framework
+{
+	// Forward declaration of geometry
+	struct geometry;
+
+	/*
+	The vertex format shared by all geometry in a pool.  Attribute locations
+	match those used by geometry_builder::initialise_geometry
+	*/
+	struct pool_vertex
+	{
+		// Location 0
+		glm::vec3 position;
+		// Location 1
+		glm::vec3 normal;
+		// Location 2
+		glm::vec2 tex_coord;
+		// Location 3
+		glm::vec4 colour;
+		// Location 4
+		glm::vec3 tangent;
+		// Location 5
+		glm::vec3 binormal;
+	};
+
+	/*
+	Layout of a single draw in the indirect draw buffer, as read by
+	glMultiDrawElementsIndirect
+	*/
+	struct draw_elements_command
+	{
+		GLuint count;
+		GLuint instance_count;
+		GLuint first_index;
+		GLint base_vertex;
+		GLuint base_instance;
+	};
+
+	/*
+	Stores many pieces of static geometry in a few large buffers sharing one
+	vertex array, so drawing them does not require switching vertex arrays or
+	buffers.  Draws of pooled geometry using the same effect can be collected
+	into a batch and submitted with a single glMultiDrawElementsIndirect.  The
+	model matrix of each draw in a batch is read by the effect from the
+	instance_model attribute (locations 7 to 10), which points at the
+	renderer's model ring.  The renderer must be initialised before the pool.
+
+	Geometry added to a pool keeps a pointer to it, so the pool must outlive
+	the geometry
+	*/
+	class geometry_pool
+	{
+	private:
+		// The vertex array shared by all pooled geometry
+		GLuint _vertex_array;
+		// Buffer of pool_vertex data
+		GLuint _vertex_buffer;
+		// Buffer of index data
+		GLuint _index_buffer;
+		// Buffer of indirect draw commands
+		GLuint _draw_buffer;
+		// The type of primitive all pooled geometry uses
+		GLenum _geometry_type;
+		// Number of vertices and indices the buffers can hold
+		unsigned int _vertex_capacity;
+		unsigned int _index_capacity;
+		// Number of vertices and indices used
+		unsigned int _vertex_count;
+		unsigned int _index_count;
+		// Number of draws the draw buffer can hold
+		unsigned int _draw_capacity;
+		// Draw commands and model matrices of the current batch
+		std::vector<draw_elements_command> _commands;
+		std::vector<glm::mat4> _models;
+
+		// Private copy constructor.  The pool owns OpenGL buffers
+		geometry_pool(const geometry_pool&);
+		// Private assignment operator
+		void operator=(const geometry_pool&);
+
+		// Points the vertex array at the current buffers
+		void setup_vertex_array();
+		// Grows the vertex and index buffers to hold at least the given counts
+		bool reserve(unsigned int vertices, unsigned int indices);
+	public:
+		// Creates an empty pool.  initialise must be called before use
+		geometry_pool();
+
+		// Deletes the buffers used by the pool
+		~geometry_pool();
+
+		// Creates the buffers for the pool.  The buffers grow when full
+		bool initialise(unsigned int vertex_capacity = 65536, unsigned int index_capacity = 196608, GLenum geometry_type = GL_TRIANGLES);
+
+		// Copies a piece of geometry into the pool.  The geometry does not
+		// need to have been initialised with geometry_builder
+		bool add(std::shared_ptr<geometry> geom);
+
+		// Gets the vertex array shared by all pooled geometry
+		GLuint get_vertex_array() const { return _vertex_array; }
+
+		// Gets the type of primitive used by the pool
+		GLenum get_geometry_type() const { return _geometry_type; }
+
+		// Starts collecting a new batch of draws
+		void begin_batch();
+
+		// Adds a draw of pooled geometry to the current batch
+		void add_draw(const geometry& geom, const glm::mat4& model);
+
+		// Gets the number of draws in the current batch
+		std::size_t batch_size() const { return _commands.size(); }
+
+		// Submits the current batch.  Assumes the vertex array of the pool
+		// and an effect reading instance_model are bound
+		bool draw_batch();
+	};
+}
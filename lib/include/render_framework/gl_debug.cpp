@@ -0,0 +1,224 @@
+#include "gl_debug.h"
+#include <iostream>
+
+namespace render_framework
+{
+	// Flag indicating the callback is installed
+	bool gl_debug::_active = false;
+
+	// Flag indicating objects can be labelled
+	bool gl_debug::_labels = false;
+
+	// Gets the rank of a severity, with notifications lowest
+	static int severity_rank(GLenum severity)
+	{
+		switch (severity)
+		{
+		case GL_DEBUG_SEVERITY_HIGH:
+			return 3;
+		case GL_DEBUG_SEVERITY_MEDIUM:
+			return 2;
+		case GL_DEBUG_SEVERITY_LOW:
+			return 1;
+		default:
+			return 0;
+		}
+	}
+
+	// Gets a readable name for a message source
+	static const char* source_name(GLenum source)
+	{
+		switch (source)
+		{
+		case GL_DEBUG_SOURCE_API:
+			return "API";
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+			return "window system";
+		case GL_DEBUG_SOURCE_SHADER_COMPILER:
+			return "shader compiler";
+		case GL_DEBUG_SOURCE_THIRD_PARTY:
+			return "third party";
+		case GL_DEBUG_SOURCE_APPLICATION:
+			return "application";
+		default:
+			return "other";
+		}
+	}
+
+	// Gets a readable name for a message type
+	static const char* type_name(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_DEBUG_TYPE_ERROR:
+			return "error";
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+			return "deprecated behaviour";
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+			return "undefined behaviour";
+		case GL_DEBUG_TYPE_PORTABILITY:
+			return "portability";
+		case GL_DEBUG_TYPE_PERFORMANCE:
+			return "performance";
+		default:
+			return "message";
+		}
+	}
+
+	// Gets a readable name for a severity
+	static const char* severity_name(GLenum severity)
+	{
+		switch (severity)
+		{
+		case GL_DEBUG_SEVERITY_HIGH:
+			return "high";
+		case GL_DEBUG_SEVERITY_MEDIUM:
+			return "medium";
+		case GL_DEBUG_SEVERITY_LOW:
+			return "low";
+		default:
+			return "notification";
+		}
+	}
+
+	/*
+	Installs the callback.  Debug output is core in OpenGL 4.3, and otherwise
+	needs KHR_debug
+	*/
+	bool gl_debug::initialise(bool synchronous)
+	{
+		_labels = GLEW_VERSION_4_3 || GLEW_KHR_debug;
+		if (!_labels)
+		{
+			std::clog << "KHR_debug not supported.  Using glGetError for OpenGL errors" << std::endl;
+			return false;
+		}
+
+		glDebugMessageCallback(&gl_debug::callback, this);
+		glEnable(GL_DEBUG_OUTPUT);
+		_active = true;
+		set_synchronous(synchronous);
+		apply_filter();
+
+		// Drop anything glGetError was holding, so it is not reported later
+		while (glGetError() != GL_NO_ERROR) { }
+
+		std::clog << "OpenGL debug output enabled (" << (synchronous ? "synchronous" : "asynchronous") << ")" << std::endl;
+		return true;
+	}
+
+	// Removes the callback
+	void gl_debug::shutdown()
+	{
+		if (!_active)
+			return;
+		glDisable(GL_DEBUG_OUTPUT);
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		glDebugMessageCallback(nullptr, nullptr);
+		_active = false;
+		_labels = false;
+	}
+
+	// Sets whether messages are delivered in the call causing them
+	void gl_debug::set_synchronous(bool value)
+	{
+		_synchronous = value;
+		// Errors received before the change came from earlier calls
+		_error.store(false);
+		if (!_active)
+			return;
+		if (value)
+			glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		else
+			glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	}
+
+	// Sets the lowest severity reported
+	void gl_debug::set_min_severity(GLenum severity)
+	{
+		_min_severity = severity;
+		if (_active)
+			apply_filter();
+	}
+
+	/*
+	Disables every message in the driver, then enables the severities that
+	will be reported, so the driver does not build messages only to have them
+	dropped
+	*/
+	void gl_debug::apply_filter()
+	{
+		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+		const GLenum severities[] = { GL_DEBUG_SEVERITY_HIGH, GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_NOTIFICATION };
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			if (severity_rank(severities[i]) >= severity_rank(_min_severity))
+				glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severities[i], 0, nullptr, GL_TRUE);
+		}
+	}
+
+	// Passes a message from the driver to the instance
+	void GLAPIENTRY gl_debug::callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei /*length*/, const GLchar* message, GLvoid* user)
+	{
+		static_cast<gl_debug*>(user)->report(source, type, id, severity, message);
+	}
+
+	/*
+	Prints a message unless it is below the minimum severity, has been seen
+	too many times, or the frame has already printed its share
+	*/
+	void gl_debug::report(GLenum source, GLenum type, GLuint id, GLenum severity, const GLchar* message)
+	{
+		if (type == GL_DEBUG_TYPE_ERROR)
+			_error.store(true);
+		if (severity_rank(severity) < severity_rank(_min_severity))
+			return;
+
+		std::lock_guard<std::mutex> guard(_lock);
+		unsigned int& repeats = _repeats[id];
+		++repeats;
+		if (repeats > DEBUG_REPEAT_LIMIT || _printed >= DEBUG_FRAME_LIMIT)
+		{
+			++_suppressed;
+			return;
+		}
+		++_printed;
+
+		std::ostream& out = (type == GL_DEBUG_TYPE_ERROR || severity == GL_DEBUG_SEVERITY_HIGH) ? std::cerr : std::clog;
+		out << "OpenGL " << type_name(type) << " (" << source_name(source) << ", " << severity_name(severity)
+			<< ", id " << id << "): " << message << std::endl;
+		if (repeats == DEBUG_REPEAT_LIMIT)
+			out << "Further messages with id " << id << " will be suppressed" << std::endl;
+	}
+
+	/*
+	Checks for an error.  Only synchronous errors are known to come from the
+	call being checked.  The flag is cleared either way, so an asynchronous
+	error is never reported against a later call
+	*/
+	bool gl_debug::take_error()
+	{
+		bool error = _error.exchange(false);
+		return _synchronous && error;
+	}
+
+	// Reports messages suppressed during the frame and starts a new one
+	void gl_debug::end_frame()
+	{
+		if (!_active)
+			return;
+		std::lock_guard<std::mutex> guard(_lock);
+		if (_suppressed > 0)
+			std::clog << "Suppressed " << _suppressed << " OpenGL debug messages" << std::endl;
+		_printed = 0;
+		_suppressed = 0;
+	}
+
+	// Names an OpenGL object
+	void gl_debug::label(GLenum identifier, GLuint name, const std::string& value)
+	{
+		if (!_labels || name == 0)
+			return;
+		glObjectLabel(identifier, name, static_cast<GLsizei>(value.size()), value.c_str());
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <GL\glew.h>
+
+// Debug builds request a debug context and install the callback.  Define
+// RENDER_FRAMEWORK_GL_DEBUG to do the same in release builds
+#if (defined(DEBUG) || defined(_DEBUG)) && !defined(RENDER_FRAMEWORK_GL_DEBUG)
+#define RENDER_FRAMEWORK_GL_DEBUG
+#endif
+
+namespace render_framework
+{
+	// Times a message with the same ID is printed before being suppressed
+	const unsigned int DEBUG_REPEAT_LIMIT = 8;
+
+	// Messages printed each frame before the rest are suppressed
+	const unsigned int DEBUG_FRAME_LIMIT = 32;
+
+	/*
+	Reports OpenGL errors and warnings through the KHR_debug callback rather
+	than glGetError.  The driver calls the callback as problems happen, so
+	nothing needs to wait for the GPU to check for errors.  While active,
+	CHECK_GL_ERROR no longer calls glGetError.
+
+	By default messages are asynchronous, so may arrive some calls after the
+	call causing them and CHECK_GL_ERROR returns false.  Synchronous mode
+	delivers each message inside the call causing it, so CHECK_GL_ERROR can
+	report it, at the cost of the sync the callback exists to avoid.  Only
+	enable it when tracking down a particular error.
+
+	Messages below the minimum severity are ignored.  Each message ID is
+	printed at most DEBUG_REPEAT_LIMIT times, and at most DEBUG_FRAME_LIMIT
+	messages are printed a frame, so a bad draw in a loop does not flood the
+	console.
+	*/
+	class gl_debug
+	{
+	private:
+		// Flag indicating the callback is installed
+		static bool _active;
+		// Flag indicating objects can be labelled
+		static bool _labels;
+		// Flag indicating messages are delivered synchronously
+		bool _synchronous;
+		// Lowest severity reported.  One of the GL_DEBUG_SEVERITY values
+		GLenum _min_severity;
+		// Flag set when an error message is received.  Cleared by take_error
+		std::atomic<bool> _error;
+		// Protects the counts.  The callback may run on a driver thread
+		std::mutex _lock;
+		// Number of times each message ID has been received
+		std::unordered_map<GLuint, unsigned int> _repeats;
+		// Messages printed this frame
+		unsigned int _printed;
+		// Messages suppressed this frame
+		unsigned int _suppressed;
+
+		// Private constructor.  Class is a singleton
+		gl_debug() : _synchronous(false), _min_severity(GL_DEBUG_SEVERITY_LOW), _error(false), _printed(0), _suppressed(0) { }
+		// Private copy constructor
+		gl_debug(const gl_debug&);
+		// Private assignment operator
+		void operator=(const gl_debug&);
+
+		// Called by the driver for each message
+		static void GLAPIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, GLvoid* user);
+		// Filters, rate limits and prints a message
+		void report(GLenum source, GLenum type, GLuint id, GLenum severity, const GLchar* message);
+		// Enables the messages at or above the minimum severity in the driver
+		void apply_filter();
+	public:
+		// Gets the singleton instance
+		static gl_debug& get_instance()
+		{
+			static gl_debug instance;
+			return instance;
+		}
+
+		// Checks if the callback is installed
+		static bool is_active() { return _active; }
+
+		// Installs the callback if KHR_debug is supported.  Needs a current
+		// context, ideally created as a debug context.  Returns false if
+		// unsupported, in which case glGetError is still used
+		bool initialise(bool synchronous = false);
+
+		// Removes the callback.  glGetError is used from then on
+		void shutdown();
+
+		// Sets whether messages are delivered in the call causing them.
+		// Clears any error received so far
+		void set_synchronous(bool value);
+
+		// Checks if messages are delivered in the call causing them
+		bool is_synchronous() const { return _synchronous; }
+
+		// Sets the lowest severity reported
+		void set_min_severity(GLenum severity);
+
+		// Checks for and clears an error received since the last check.
+		// Asynchronous errors cannot be tied to a call, so always false
+		bool take_error();
+
+		// Reports messages suppressed during the frame and starts a new one
+		void end_frame();
+
+		// Names an OpenGL object in debug messages and tools.  identifier is
+		// the object type, such as GL_TEXTURE or GL_BUFFER.  Does nothing if
+		// KHR_debug is not supported
+		static void label(GLenum identifier, GLuint name, const std::string& value);
+	};
+}
@@ -0,0 +1,141 @@
+#include "gl_state.h"
+#include "frame_stats.h"
+
+namespace render_framework
+{
+	// Value used for state that is not known
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	void gl_state::invalidate()
+	{
+		_program = UNKNOWN;
+		_vertex_array = UNKNOWN;
+		_frame_buffer = UNKNOWN;
+		_active_unit = UNKNOWN;
+		for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+		{
+			_textures[i] = UNKNOWN;
+			_texture_types[i] = UNKNOWN;
+		}
+		_depth_test = _depth_mask = _blend = _cull_face = -1;
+		_cull_mode = UNKNOWN;
+	}
+
+	void gl_state::use_program(GLuint program)
+	{
+		if (count(_program != program))
+		{
+			glUseProgram(program);
+			if (_stats != nullptr)
+				++_stats->program_binds;
+			_program = program;
+		}
+	}
+
+	void gl_state::bind_vertex_array(GLuint vertex_array)
+	{
+		if (count(_vertex_array != vertex_array))
+		{
+			glBindVertexArray(vertex_array);
+			if (_stats != nullptr)
+				++_stats->vertex_array_binds;
+			_vertex_array = vertex_array;
+		}
+	}
+
+	void gl_state::bind_frame_buffer(GLuint frame_buffer)
+	{
+		if (count(_frame_buffer != frame_buffer))
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+			if (_stats != nullptr)
+				++_stats->frame_buffer_binds;
+			_frame_buffer = frame_buffer;
+		}
+	}
+
+	void gl_state::bind_texture(unsigned int unit, GLenum type, GLuint texture)
+	{
+		// Units we don't track are always bound
+		if (unit >= MAX_TEXTURE_UNITS)
+		{
+			count(true);
+			glActiveTexture(GL_TEXTURE0 + unit);
+			glBindTexture(type, texture);
+			_active_unit = GL_TEXTURE0 + unit;
+			if (_stats != nullptr)
+				++_stats->texture_binds;
+			return;
+		}
+
+		// Check if the texture is already bound
+		if (!count(_textures[unit] != texture || _texture_types[unit] != type))
+			return;
+
+		// Only change the active unit if needed
+		if (_active_unit != GL_TEXTURE0 + unit)
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+			_active_unit = GL_TEXTURE0 + unit;
+		}
+		glBindTexture(type, texture);
+		if (_stats != nullptr)
+			++_stats->texture_binds;
+		_textures[unit] = texture;
+		_texture_types[unit] = type;
+	}
+
+	void gl_state::set_depth_test(bool value)
+	{
+		if (count(_depth_test != static_cast<int>(value)))
+		{
+			if (value)
+				glEnable(GL_DEPTH_TEST);
+			else
+				glDisable(GL_DEPTH_TEST);
+			_depth_test = value;
+		}
+	}
+
+	void gl_state::set_depth_mask(bool value)
+	{
+		if (count(_depth_mask != static_cast<int>(value)))
+		{
+			glDepthMask(value ? GL_TRUE : GL_FALSE);
+			_depth_mask = value;
+		}
+	}
+
+	void gl_state::set_blend(bool value)
+	{
+		if (count(_blend != static_cast<int>(value)))
+		{
+			if (value)
+				glEnable(GL_BLEND);
+			else
+				glDisable(GL_BLEND);
+			_blend = value;
+		}
+	}
+
+	void gl_state::set_cull_face(bool value)
+	{
+		if (count(_cull_face != static_cast<int>(value)))
+		{
+			if (value)
+				glEnable(GL_CULL_FACE);
+			else
+				glDisable(GL_CULL_FACE);
+			_cull_face = value;
+		}
+	}
+
+	void gl_state::set_cull_mode(GLenum mode)
+	{
+		if (count(_cull_mode != mode))
+		{
+			glCullFace(mode);
+			_cull_mode = mode;
+		}
+	}
+}
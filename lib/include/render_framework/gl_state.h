@@ -0,0 +1,113 @@
+#pragma once
+
+#include <GL\glew.h>
+
+namespace render_framework
+{
+	// Forward declaration of frame_stats
+	struct frame_stats;
+
+	/*
+	Mirrors the OpenGL state set by the renderer so that calls which would not
+	change anything can be skipped.  The tracker only knows about changes made
+	through it, so it must be invalidated whenever GL state may have been
+	changed elsewhere (the renderer does this at the start of each render)
+	*/
+	class gl_state
+	{
+	public:
+		// Number of texture units tracked.  Units above this are always bound
+		static const unsigned int MAX_TEXTURE_UNITS = 32;
+	private:
+		// Currently used program
+		GLuint _program;
+		// Currently bound vertex array object
+		GLuint _vertex_array;
+		// Currently bound frame buffer
+		GLuint _frame_buffer;
+		// Currently active texture unit
+		GLenum _active_unit;
+		// Texture bound to each unit
+		GLuint _textures[MAX_TEXTURE_UNITS];
+		// Type of the texture bound to each unit
+		GLenum _texture_types[MAX_TEXTURE_UNITS];
+		// Capability states.  -1 means unknown
+		int _depth_test;
+		int _depth_mask;
+		int _blend;
+		int _cull_face;
+		// Face currently being culled
+		GLenum _cull_mode;
+		// Number of calls passed on to OpenGL
+		unsigned int _issued;
+		// Number of calls skipped as they would change nothing
+		unsigned int _elided;
+		// Statistics the binds are counted in.  May be nullptr
+		frame_stats* _stats;
+
+		// Records whether a call was issued or elided.  Returns issue
+		bool count(bool issue)
+		{
+			if (issue)
+				++_issued;
+			else
+				++_elided;
+			return issue;
+		}
+	public:
+		// Creates a state tracker with all state unknown
+		gl_state() : _issued(0), _elided(0), _stats(nullptr) { invalidate(); }
+
+		// Forgets all tracked state, so the next call of each type is issued
+		void invalidate();
+
+		// Uses a program
+		void use_program(GLuint program);
+
+		// Binds a vertex array object
+		void bind_vertex_array(GLuint vertex_array);
+
+		// Binds a frame buffer
+		void bind_frame_buffer(GLuint frame_buffer);
+
+		// Binds a texture of the given type to a texture unit
+		void bind_texture(unsigned int unit, GLenum type, GLuint texture);
+
+		// Enables or disables depth testing
+		void set_depth_test(bool value);
+
+		// Enables or disables writing to the depth buffer
+		void set_depth_mask(bool value);
+
+		// Enables or disables blending
+		void set_blend(bool value);
+
+		// Enables or disables face culling
+		void set_cull_face(bool value);
+
+		// Sets which face is culled
+		void set_cull_mode(GLenum mode);
+
+		// Gets the currently used program
+		GLuint get_program() const { return _program; }
+
+		// Gets the currently bound vertex array object
+		GLuint get_vertex_array() const { return _vertex_array; }
+
+		// Gets the currently bound frame buffer
+		GLuint get_frame_buffer() const { return _frame_buffer; }
+
+		// Gets the number of calls passed on to OpenGL
+		unsigned int get_issued() const { return _issued; }
+
+		// Gets the number of calls skipped
+		unsigned int get_elided() const { return _elided; }
+
+		// Resets the issued and elided counters
+		void reset_counters() { _issued = _elided = 0; }
+
+		// Sets the statistics program, vertex array, frame buffer and
+		// texture binds are counted in
+		void set_stats(frame_stats* stats) { _stats = stats; }
+	};
+}
@@ -0,0 +1,411 @@
+#include "job_system.h"
+#include <iostream>
+#include <algorithm>
+
+// Thread local storage.  Visual Studio 2012 does not support thread_local
+#if defined(_MSC_VER)
+#define JOB_THREAD_LOCAL __declspec(thread)
+#else
+#define JOB_THREAD_LOCAL __thread
+#endif
+
+namespace render_framework
+{
+	// Index used by threads which do not belong to the job system
+	const unsigned int NOT_A_WORKER = 0xFFFFFFFF;
+
+	// Times a worker looks for a job before going to sleep
+	const unsigned int WORKER_SPIN_COUNT = 64;
+
+	// Index of the calling thread in the job system
+	static JOB_THREAD_LOCAL unsigned int thread_index = NOT_A_WORKER;
+
+	job_deque::job_deque()
+		: _slots(new std::atomic<job*>[JOBS_PER_THREAD]), _top(0), _bottom(0)
+	{
+	}
+
+	/*
+	Adds a job to the bottom of the deque.  The release store of bottom makes
+	the job visible to thieves only once it has been written
+	*/
+	bool job_deque::push(job* value)
+	{
+		long long b = _bottom.load(std::memory_order_relaxed);
+		long long t = _top.load(std::memory_order_acquire);
+		if (b - t >= static_cast<long long>(JOBS_PER_THREAD))
+			return false;
+		_slots[b & (JOBS_PER_THREAD - 1)].store(value, std::memory_order_relaxed);
+		_bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*
+	Removes the newest job.  Bottom is moved first, so a thief can only take
+	the same job if it is the last one, in which case both race on top
+	*/
+	job* job_deque::pop()
+	{
+		long long b = _bottom.load(std::memory_order_relaxed) - 1;
+		_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = _top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			// Empty.  Put bottom back
+			_bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		job* value = _slots[b & (JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// Last job.  Race any thieves for it
+			if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				value = nullptr;
+			_bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return value;
+	}
+
+	// Removes the oldest job
+	job* job_deque::steal()
+	{
+		long long t = _top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long b = _bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return nullptr;
+
+		job* value = _slots[t & (JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+		if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return value;
+	}
+
+	/*
+	Creates the deques and starts the worker threads.  The calling thread
+	becomes the main thread, and is the only one which runs main thread jobs
+	*/
+	bool job_system::initialise(unsigned int workers)
+	{
+		if (_running.load())
+			return true;
+
+		if (workers == 0)
+			workers = (std::max)(1u, std::thread::hardware_concurrency()) - 1;
+
+		_workers.clear();
+		for (unsigned int i = 0; i <= workers; ++i)
+		{
+			std::unique_ptr<worker> w(new worker());
+			w->next_job = 0;
+			for (std::size_t j = 0; j < JOBS_PER_THREAD; ++j)
+				w->in_use[j].store(false);
+			w->random = 2463534242u + i * 7919u;
+			_workers.push_back(std::move(w));
+		}
+		thread_index = 0;
+		_running.store(true);
+
+		for (unsigned int i = 1; i <= workers; ++i)
+			_threads.push_back(std::thread(&job_system::worker_loop, this, i));
+
+		std::clog << "Job system started with " << workers << " worker threads" << std::endl;
+		return true;
+	}
+
+	/*
+	Stops the workers.  Jobs still queued are not run, so anything waiting on
+	them must have finished first
+	*/
+	void job_system::shutdown()
+	{
+		if (!_running.load())
+			return;
+
+		{
+			std::lock_guard<std::mutex> guard(_sleep_lock);
+			_running.store(false);
+		}
+		_wake.notify_all();
+		for (auto iter = _threads.begin(); iter != _threads.end(); ++iter)
+			iter->join();
+		_threads.clear();
+		_workers.clear();
+		_main_jobs.clear();
+		_queued.store(0);
+		thread_index = NOT_A_WORKER;
+	}
+
+	// Checks if the calling thread is the main thread
+	bool job_system::is_main_thread() const
+	{
+		return thread_index == 0;
+	}
+
+	/*
+	Looks for a job, first in the thread's own deque, then by stealing from
+	the other threads starting at a random one
+	*/
+	job* job_system::find_job(unsigned int index)
+	{
+		auto& self = *_workers[index];
+		job* value = self.deque.pop();
+		if (value == nullptr)
+		{
+			auto count = static_cast<unsigned int>(_workers.size());
+			// xorshift
+			self.random ^= self.random << 13;
+			self.random ^= self.random >> 17;
+			self.random ^= self.random << 5;
+			unsigned int start = self.random % count;
+			for (unsigned int i = 0; i < count && value == nullptr; ++i)
+			{
+				unsigned int victim = (start + i) % count;
+				if (victim != index)
+					value = _workers[victim]->deque.steal();
+			}
+		}
+		if (value != nullptr)
+			--_queued;
+		return value;
+	}
+
+	/*
+	Runs jobs until the job system shuts down.  A worker which cannot find a
+	job for a while sleeps until one is submitted
+	*/
+	void job_system::worker_loop(unsigned int index)
+	{
+		thread_index = index;
+		unsigned int idle = 0;
+		while (_running.load())
+		{
+			job* value = find_job(index);
+			if (value != nullptr)
+			{
+				execute(value);
+				idle = 0;
+				continue;
+			}
+
+			if (++idle < WORKER_SPIN_COUNT)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			// Nothing to do.  Sleep until a job is queued
+			std::unique_lock<std::mutex> guard(_sleep_lock);
+			++_sleeping;
+			while (_running.load() && _queued.load() == 0)
+				_wake.wait(guard);
+			--_sleeping;
+			idle = 0;
+		}
+	}
+
+	// Wakes a sleeping worker if there are any
+	void job_system::wake_worker()
+	{
+		if (_sleeping.load() > 0)
+		{
+			std::lock_guard<std::mutex> guard(_sleep_lock);
+			_wake.notify_one();
+		}
+	}
+
+	/*
+	Queues a job.  Main thread jobs go to the main queue, and other jobs to
+	the calling thread's deque.  Threads outside the job system, or threads
+	whose deque is full, run the job straight away
+	*/
+	void job_system::submit(job* value)
+	{
+		if (value->main_thread)
+		{
+			std::lock_guard<std::mutex> guard(_main_lock);
+			_main_jobs.push_back(value);
+			return;
+		}
+
+		unsigned int index = thread_index;
+		if (index == NOT_A_WORKER || index >= _workers.size() || !_workers[index]->deque.push(value))
+		{
+			execute(value);
+			return;
+		}
+		++_queued;
+		wake_worker();
+	}
+
+	/*
+	Runs a job, then decrements its counter.  The last decrement is made
+	while holding the counter's lock, which releases any jobs held on it.
+	wait takes the same lock before returning, so the counter cannot go out
+	of scope while the last job is still using it
+	*/
+	void job_system::execute(job* value)
+	{
+		value->function(*value);
+		auto counter = value->counter;
+		// The job is no longer needed, so its slot can be reused
+		if (value->in_use != nullptr)
+			value->in_use->store(false, std::memory_order_release);
+		if (counter == nullptr)
+			return;
+
+		int remaining = counter->value.load();
+		while (remaining > 1)
+		{
+			if (counter->value.compare_exchange_weak(remaining, remaining - 1))
+				return;
+		}
+
+		std::vector<job*> released;
+		{
+			std::lock_guard<std::mutex> guard(counter->lock);
+			if (--counter->value == 0)
+				released.swap(counter->waiting);
+		}
+		for (auto iter = released.begin(); iter != released.end(); ++iter)
+			submit(*iter);
+	}
+
+	/*
+	Finds a free slot in the ring of job storage, starting from the next one.
+	Slots are usually freed in order, so the first is almost always free.
+	Jobs held on a dependency keep their slot, so the rest of the ring is
+	searched before giving up.  Returns nullptr if every slot holds a job not
+	yet run
+	*/
+	job* job_system::allocate_job(worker& self)
+	{
+		for (std::size_t i = 0; i < JOBS_PER_THREAD; ++i)
+		{
+			std::size_t slot = self.next_job++ & (JOBS_PER_THREAD - 1);
+			if (!self.in_use[slot].load(std::memory_order_acquire))
+			{
+				self.in_use[slot].store(true, std::memory_order_relaxed);
+				return &self.jobs[slot];
+			}
+		}
+		return nullptr;
+	}
+
+	/*
+	Copies the job into the calling thread's job storage and queues it.  If
+	the dependency has not yet reached zero the job is held on it instead
+	*/
+	void job_system::run(const job& value, job_counter* dependency)
+	{
+		if (value.counter != nullptr)
+			++value.counter->value;
+
+		// Threads outside the job system have no storage
+		unsigned int index = thread_index;
+		job* stored = nullptr;
+		if (index != NOT_A_WORKER && index < _workers.size())
+		{
+			auto& self = *_workers[index];
+			stored = allocate_job(self);
+
+			// A main thread job cannot run here.  Run other jobs until one of
+			// ours finishes and frees its slot
+			while (stored == nullptr && value.main_thread && index != 0)
+			{
+				job* other = find_job(index);
+				if (other != nullptr)
+					execute(other);
+				else
+					std::this_thread::yield();
+				stored = allocate_job(self);
+			}
+		}
+
+		// No storage.  Run now, after waiting for the dependency
+		if (stored == nullptr)
+		{
+			if (dependency != nullptr)
+				wait(*dependency);
+			job copy = value;
+			copy.in_use = nullptr;
+			if (copy.main_thread && index != 0)
+				std::cerr << "Warning - main thread job run from outside the job system" << std::endl;
+			execute(&copy);
+			return;
+		}
+
+		*stored = value;
+		stored->in_use = &_workers[index]->in_use[stored - _workers[index]->jobs];
+
+		if (dependency != nullptr)
+		{
+			std::lock_guard<std::mutex> guard(dependency->lock);
+			if (!dependency->is_done())
+			{
+				dependency->waiting.push_back(stored);
+				return;
+			}
+		}
+		submit(stored);
+	}
+
+	// Runs a function on some data
+	void job_system::run(job_function function, void* data, job_counter* counter, job_counter* dependency)
+	{
+		run(job(function, data, counter), dependency);
+	}
+
+	// Runs a function on some data on the main thread
+	void job_system::run_on_main(job_function function, void* data, job_counter* counter, job_counter* dependency)
+	{
+		job value(function, data, counter);
+		value.main_thread = true;
+		run(value, dependency);
+	}
+
+	/*
+	Runs the jobs queued for the main thread.  Jobs queued while running are
+	left for the next call
+	*/
+	void job_system::run_main_jobs()
+	{
+		if (!is_main_thread())
+		{
+			std::cerr << "Error - main thread jobs can only be run from the main thread" << std::endl;
+			return;
+		}
+
+		std::vector<job*> jobs;
+		{
+			std::lock_guard<std::mutex> guard(_main_lock);
+			jobs.swap(_main_jobs);
+		}
+		for (auto iter = jobs.begin(); iter != jobs.end(); ++iter)
+			execute(*iter);
+	}
+
+	/*
+	Runs jobs until the counter reaches zero, rather than blocking.  The main
+	thread also runs main thread jobs, as the counter may be waiting on them
+	*/
+	void job_system::wait(job_counter& counter)
+	{
+		unsigned int index = thread_index;
+		bool worker = index != NOT_A_WORKER && index < _workers.size();
+		while (!counter.is_done())
+		{
+			if (index == 0)
+				run_main_jobs();
+			job* value = worker ? find_job(index) : nullptr;
+			if (value != nullptr)
+				execute(value);
+			else
+				std::this_thread::yield();
+		}
+		// The job finishing the counter may still hold its lock
+		std::lock_guard<std::mutex> guard(counter.lock);
+	}
+}
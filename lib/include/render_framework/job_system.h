@@ -0,0 +1,271 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <memory>
+
+namespace render_framework
+{
+	// Forward declaration of job
+	struct job;
+
+	// Function run by a job
+	typedef void (*job_function)(const job& value);
+
+	// Number of jobs each thread can have outstanding at once.  Must be a
+	// power of 2
+	const std::size_t JOBS_PER_THREAD = 4096;
+
+	/*
+	Counts the jobs still to complete in a group of work.  Jobs run with a
+	counter increment it when submitted and decrement it when they finish.
+	Jobs can also depend on a counter, in which case they are held until the
+	counter reaches zero.  A counter must outlive every job using it
+	*/
+	struct job_counter
+	{
+		// Jobs still to complete
+		std::atomic<int> value;
+		// Protects the list of held jobs
+		std::mutex lock;
+		// Jobs held until the counter reaches zero
+		std::vector<job*> waiting;
+
+		// Creates a counter with no jobs
+		job_counter() : value(0) { }
+
+		// Checks if every job has completed.  Use job_system::wait before
+		// letting the counter go out of scope
+		bool is_done() const { return value.load() == 0; }
+	private:
+		// Private copy constructor.  Jobs hold the address of the counter
+		job_counter(const job_counter&);
+		// Private assignment operator
+		void operator=(const job_counter&);
+	};
+
+	/*
+	A unit of work for the job system.  The data is borrowed, so must outlive
+	the job.  begin, end and grain are used by parallel_for to describe the
+	range of work a job covers
+	*/
+	struct job
+	{
+		// The function to run
+		job_function function;
+		// Data passed to the function
+		void* data;
+		// Start of the range covered by the job
+		std::size_t begin;
+		// End of the range covered by the job
+		std::size_t end;
+		// Largest range run without splitting
+		std::size_t grain;
+		// Counter decremented when the job finishes.  May be nullptr
+		job_counter* counter;
+		// Flag indicating the job must run on the main thread.  Used for
+		// OpenGL work, as the context is only current on the main thread
+		bool main_thread;
+		// Flag of the job storage slot holding the job, cleared once it has
+		// run.  Set by the job system
+		std::atomic<bool>* in_use;
+
+		// Creates an empty job
+		job() : function(nullptr), data(nullptr), begin(0), end(0), grain(1), counter(nullptr), main_thread(false), in_use(nullptr) { }
+
+		// Creates a job running a function on some data
+		job(job_function function, void* data, job_counter* counter = nullptr)
+			: function(function), data(data), begin(0), end(0), grain(1), counter(counter), main_thread(false), in_use(nullptr) { }
+	};
+
+	/*
+	A fixed size Chase-Lev work stealing deque.  The owning thread pushes and
+	pops jobs at the bottom, while other threads steal from the top, so the
+	owner only contends with thieves when one job is left
+	*/
+	class job_deque
+	{
+	private:
+		// The slots of the ring
+		std::unique_ptr<std::atomic<job*>[]> _slots;
+		// Index of the next job to steal
+		std::atomic<long long> _top;
+		// Index of the next free slot
+		std::atomic<long long> _bottom;
+
+		// Private copy constructor
+		job_deque(const job_deque&);
+		// Private assignment operator
+		void operator=(const job_deque&);
+	public:
+		// Creates an empty deque holding up to JOBS_PER_THREAD jobs
+		job_deque();
+
+		// Adds a job to the bottom.  Owner only.  Returns false if full
+		bool push(job* value);
+
+		// Removes a job from the bottom.  Owner only.  Returns nullptr if empty
+		job* pop();
+
+		// Removes a job from the top.  Returns nullptr if empty or lost a race
+		job* steal();
+	};
+
+	/*
+	Runs jobs across a pool of worker threads.  Each worker, and the main
+	thread, owns a deque of jobs.  Threads run jobs from their own deque
+	first, newest first, and when it is empty steal the oldest job of a
+	random other thread.  Workers with nothing to do sleep until more jobs
+	are submitted.
+
+	Jobs which must run on the main thread (such as OpenGL calls) are held
+	in a separate queue, run by run_main_jobs or while the main thread waits
+	on a counter.
+	*/
+	class job_system
+	{
+	private:
+		// The deque and job storage of a thread
+		struct worker
+		{
+			// Jobs waiting to run
+			job_deque deque;
+			// Storage for jobs submitted by the thread, reused as a ring
+			job jobs[JOBS_PER_THREAD];
+			// Flags of the storage slots holding a job not yet run
+			std::atomic<bool> in_use[JOBS_PER_THREAD];
+			// Next job of the ring to use
+			std::size_t next_job;
+			// State of the random number generator used to pick victims
+			unsigned int random;
+		};
+
+		// Worker state.  Index 0 is the main thread
+		std::vector<std::unique_ptr<worker>> _workers;
+		// The worker threads
+		std::vector<std::thread> _threads;
+		// Jobs which must be run on the main thread
+		std::vector<job*> _main_jobs;
+		// Protects the main thread jobs
+		std::mutex _main_lock;
+		// Jobs in the deques not yet taken by a thread
+		std::atomic<int> _queued;
+		// Number of workers asleep
+		std::atomic<int> _sleeping;
+		// Protects workers going to sleep
+		std::mutex _sleep_lock;
+		// Signalled when jobs are submitted
+		std::condition_variable _wake;
+		// Flag indicating the workers should keep running
+		std::atomic<bool> _running;
+
+		// Private constructor.  Class is a singleton
+		job_system() : _queued(0), _sleeping(0), _running(false) { }
+		// Private copy constructor
+		job_system(const job_system&);
+		// Private assignment operator
+		void operator=(const job_system&);
+
+		// Main loop of each worker thread
+		void worker_loop(unsigned int index);
+		// Takes a job from the calling thread's deque, or steals one
+		job* find_job(unsigned int index);
+		// Queues a job without checking dependencies
+		void submit(job* value);
+		// Runs a job and signals its counter
+		void execute(job* value);
+		// Finds a free slot of the calling thread's job storage
+		job* allocate_job(worker& self);
+		// Wakes a sleeping worker if there are any
+		void wake_worker();
+		// Runs a range of a parallel_for, splitting it while above the grain
+		template <typename Function>
+		static void parallel_for_job(const job& value);
+	public:
+		// Stops the workers
+		~job_system() { shutdown(); }
+
+		// Gets the singleton instance
+		static job_system& get_instance()
+		{
+			static job_system instance;
+			return instance;
+		}
+
+		// Starts the worker threads.  Must be called from the main thread.
+		// 0 workers uses one for each hardware thread besides the main one
+		bool initialise(unsigned int workers = 0);
+
+		// Stops and joins the worker threads
+		void shutdown();
+
+		// Checks if the workers are running
+		bool is_running() const { return _running.load(); }
+
+		// Gets the number of threads running jobs, including the main thread
+		std::size_t get_thread_count() const { return _workers.size(); }
+
+		// Checks if the calling thread is the main thread
+		bool is_main_thread() const;
+
+		// Runs a job, once the dependency (if any) has reached zero
+		void run(const job& value, job_counter* dependency = nullptr);
+
+		// Runs a function on some data
+		void run(job_function function, void* data, job_counter* counter, job_counter* dependency = nullptr);
+
+		// Runs a function on some data on the main thread
+		void run_on_main(job_function function, void* data, job_counter* counter, job_counter* dependency = nullptr);
+
+		// Runs the queued main thread jobs.  Main thread only
+		void run_main_jobs();
+
+		// Runs other jobs until the counter reaches zero
+		void wait(job_counter& counter);
+
+		// Calls function(begin, end) over ranges of [0, count) no larger than
+		// grain, spread across the threads.  Returns once every range is done
+		template <typename Function>
+		void parallel_for(std::size_t count, std::size_t grain, const Function& function);
+	};
+
+	/*
+	Runs a range of a parallel_for.  Ranges larger than the grain are halved,
+	with the top half submitted as a new job, so idle threads steal large
+	ranges and split them further themselves
+	*/
+	template <typename Function>
+	void job_system::parallel_for_job(const job& value)
+	{
+		job range = value;
+		while (range.end - range.begin > range.grain)
+		{
+			job half = range;
+			half.begin = range.begin + (range.end - range.begin) / 2;
+			range.end = half.begin;
+			get_instance().run(half);
+		}
+		(*static_cast<const Function*>(range.data))(range.begin, range.end);
+	}
+
+	/*
+	Splits the range into jobs and waits for them.  The calling thread runs
+	jobs while it waits, so nested parallel_for calls do not deadlock
+	*/
+	template <typename Function>
+	void job_system::parallel_for(std::size_t count, std::size_t grain, const Function& function)
+	{
+		if (count == 0)
+			return;
+		job_counter counter;
+		job value(&parallel_for_job<Function>, const_cast<void*>(static_cast<const void*>(&function)), &counter);
+		value.end = count;
+		value.grain = grain == 0 ? 1 : grain;
+		run(value);
+		wait(counter);
+	}
+}
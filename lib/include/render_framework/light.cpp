@@ -1,5 +1,7 @@
 #include "light.h"
 #include "util.h"
+#include <cstring>
+#include <algorithm>
 
 namespace render_framework
 {
@@ -16,42 +18,24 @@ namespace render_framework
 		// Calculate the new orientation
 		auto rot = glm::mat3_cast(rotation);
 		data.direction = rot * data.direction;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::vec4), sizeof(glm::vec3), &data.direction);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(2 * sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void directional_light::set_ambient_intensity(const glm::vec4& ambient)
 	{
 		// Set the ambient intensity
 		data.ambient_intensity = ambient;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::vec4), &data.ambient_intensity);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(0, sizeof(glm::vec4));
 	}
 
 	void directional_light::set_colour(const glm::vec4& colour)
 	{
 		// Set the colour of the light
 		data.colour = colour;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::vec4), sizeof(glm::vec4), &data.colour);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(sizeof(glm::vec4), sizeof(glm::vec4));
 	}
 
 	bool directional_light::build()
@@ -66,46 +50,33 @@ namespace render_framework
 		return !CHECK_GL_ERROR;
 	}
 
+	void directional_light::copy_data(std::size_t offset, std::size_t size, void* destination) const
+	{
+		std::memcpy(destination, reinterpret_cast<const char*>(&data) + offset, size);
+	}
+
 	void point_light::translate(const glm::vec3& translation)
 	{
 		// Translate the point
 		data.position += translation;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::vec4), sizeof(glm::vec3), &data.position);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void point_light::set_range(float range)
 	{
 		// Calculate the attenutation
 		data.attenuation = glm::vec3(1.0f, 2.0f / range, 1.0f / (range * range));
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::vec4), sizeof(glm::vec3), &data.attenuation);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(2 * sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void point_light::set_colour(const glm::vec4& colour)
 	{
 		// Set the colour value
 		data.colour = colour;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::vec4), &data.colour);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(0, sizeof(glm::vec4));
 	}
 
 	bool point_light::build()
@@ -120,18 +91,17 @@ namespace render_framework
 		return !CHECK_GL_ERROR;
 	}
 
+	void point_light::copy_data(std::size_t offset, std::size_t size, void* destination) const
+	{
+		std::memcpy(destination, reinterpret_cast<const char*>(&data) + offset, size);
+	}
+
 	void spot_light::translate(const glm::vec3& translation)
 	{
 		// Translate the position
 		data.position += translation;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::vec4), sizeof(glm::vec3), &data.position);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void spot_light::rotate(const glm::vec3& rotation)
@@ -147,56 +117,32 @@ namespace render_framework
 		// Calculate the new orientation
 		auto rot = glm::mat3_cast(rotation);
 		data.direction = rot * data.direction;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::vec4), sizeof(glm::vec3), &data.direction);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(2 * sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void spot_light::set_colour(const glm::vec4& colour)
 	{
 		// Set the colour
 		data.colour = colour;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::vec4), &data.colour);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(0, sizeof(glm::vec4));
 	}
 
 	void spot_light::set_range(float range)
 	{
 		// Calculate the attenutation
 		data.attenuation = glm::vec3(1.0f, 2.0f / range, 1.0f / (range * range));
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 3 * sizeof(glm::vec4), sizeof(glm::vec3), &data.attenuation);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(3 * sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void spot_light::set_power(float power)
 	{
 		// Set the power
 		data.power = power;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 3 * sizeof(glm::vec4) + sizeof(glm::vec3), sizeof(float), &data.power);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(3 * sizeof(glm::vec4) + sizeof(glm::vec3), sizeof(float));
 	}
 
 	bool spot_light::build()
@@ -211,63 +157,41 @@ namespace render_framework
 		return !CHECK_GL_ERROR;
 	}
 
+	void spot_light::copy_data(std::size_t offset, std::size_t size, void* destination) const
+	{
+		std::memcpy(destination, reinterpret_cast<const char*>(&data) + offset, size);
+	}
+
 	void dynamic_lights::translate_point(int index, const glm::vec3& translation)
 	{
 		// Update the position
 		data.point_lights[index].position += translation;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(point_light_data) + sizeof(glm::vec4), sizeof(glm::vec3), &data.point_lights[index].position);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(index * sizeof(point_light_data) + sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void dynamic_lights::set_range_point(int index, float range)
 	{
 		// Calculate the attenutation
 		data.point_lights[index].attenuation = glm::vec3(1.0f, 2.0f / range, 1.0f / (range * range));
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(point_light_data) + 2 * sizeof(glm::vec4), sizeof(glm::vec3), &data.point_lights[index].attenuation);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(index * sizeof(point_light_data) + 2 * sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void dynamic_lights::set_colour_point(int index, const glm::vec4& colour)
 	{
 		// Update the colour
 		data.point_lights[index].colour = colour;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(point_light_data), sizeof(glm::vec4), &data.point_lights[index].colour);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(index * sizeof(point_light_data), sizeof(glm::vec4));
 	}
 
 	void dynamic_lights::translate_spot(int index, const glm::vec3& translation)
 	{
 		// Translate the spot
 		data.spot_lights[index].position += translation;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER, 
-						data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data) + sizeof(glm::vec4), 
-						sizeof(glm::vec3),
-						&data.spot_lights[index].position);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data) + sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void dynamic_lights::rotate_spot(int index, const glm::vec3& rotation)
@@ -283,68 +207,32 @@ namespace render_framework
 		// Rotate direction
 		auto rot = glm::mat3_cast(rotation);
 		data.spot_lights[index].direction = rot * data.spot_lights[index].direction;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER,
-						data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data) + 2 * sizeof(glm::vec4),
-						sizeof(glm::vec3),
-						&data.spot_lights[index].position);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data) + 2 * sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void dynamic_lights::set_colour_spot(int index, const glm::vec4& colour)
 	{
 		// Set the colour
 		data.spot_lights[index].colour = colour;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER,
-						data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data),
-						sizeof(glm::vec4),
-						&data.spot_lights[index].colour);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data), sizeof(glm::vec4));
 	}
 
 	void dynamic_lights::set_range_spot(int index, float range)
 	{
 		// Calculate the attenutation
-		data.point_lights[index].attenuation = glm::vec3(1.0f, 2.0f / range, 1.0f / (range * range));
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER,
-						data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data) + 3 * sizeof(glm::vec4), 
-						sizeof(glm::vec3), 
-						&data.spot_lights[index].attenuation);
-		// Display any errors
-		CHECK_GL_ERROR;
+		data.spot_lights[index].attenuation = glm::vec3(1.0f, 2.0f / range, 1.0f / (range * range));
+		// Upload with the next flush of the stream buffer
+		mark_dirty(data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data) + 3 * sizeof(glm::vec4), sizeof(glm::vec3));
 	}
 
 	void dynamic_lights::set_power_spot(int index, float power)
 	{
 		// Set the power
 		data.spot_lights[index].power = power;
-		// Check if buffer
-		if (!buffer)
-			return;
-		// Change the buffer data
-		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
-		glBufferSubData(GL_UNIFORM_BUFFER,
-						data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data) + 3 * sizeof(glm::vec4) + sizeof(glm::vec3),
-						sizeof(float),
-						&data.spot_lights[index].power);
-		// Display any errors
-		CHECK_GL_ERROR;
+		// Upload with the next flush of the stream buffer
+		mark_dirty(data.point_lights.size() * sizeof(point_light_data) + index * sizeof(spot_light_data) + 3 * sizeof(glm::vec4) + sizeof(glm::vec3), sizeof(float));
 	}
 
 	bool dynamic_lights::build()
@@ -369,4 +257,22 @@ namespace render_framework
 						&data.spot_lights[0]);
 		return !CHECK_GL_ERROR;
 	}
+
+	void dynamic_lights::copy_data(std::size_t offset, std::size_t size, void* destination) const
+	{
+		char* out = static_cast<char*>(destination);
+		std::size_t point_size = data.point_lights.size() * sizeof(point_light_data);
+		// Part of the range within the point lights
+		if (offset < point_size)
+		{
+			std::size_t count = (std::min)(size, point_size - offset);
+			std::memcpy(out, reinterpret_cast<const char*>(&data.point_lights[0]) + offset, count);
+			out += count;
+			offset += count;
+			size -= count;
+		}
+		// Remainder is within the spot lights
+		if (size > 0)
+			std::memcpy(out, reinterpret_cast<const char*>(&data.spot_lights[0]) + (offset - point_size), size);
+	}
 }
\ No newline at end of file
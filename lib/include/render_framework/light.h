@@ -4,6 +4,7 @@
 #include <glm\glm.hpp>
 #include <glm\gtc\quaternion.hpp>
 #include <GL\glew.h>
+#include "stream_buffer.h"
 
 namespace render_framework
 {
@@ -34,27 +35,11 @@ namespace render_framework
 	/*
 	Structure representing a directional light
 	*/
-	struct directional_light
+	struct directional_light : public streamed_data
 	{
-		// OpenGL buffer ID for directional light if relevant
-		GLuint buffer;
-
 		// Data representing the directional light
 		directional_light_data data;
 
-		// Creates a new directional light
-		directional_light() : buffer(0) { }
-
-		// Destroys directional light.  If buffer is valid (not 0) will delete
-		// the buffer
-		~directional_light()
-		{
-			// If buffer is valid delete
-			if (buffer) glDeleteBuffers(1, &buffer);
-			// Set buffer to 0
-			buffer = 0;
-		}
-
 		void rotate(const glm::vec3& rotation);
 
 		void rotate(const glm::quat& rotation);
@@ -64,8 +49,11 @@ namespace render_framework
 		void set_colour(const glm::vec4& colour);
 
 		bool build();
+
+		// Copies part of the light data for upload to the buffer
+		void copy_data(std::size_t offset, std::size_t size, void* destination) const;
 	};
-	
+
 	/*
 	Structure representing data necessary to define a point light
 	*/
@@ -95,26 +83,11 @@ namespace render_framework
 	/*
 	Structure representing a point light
 	*/
-	struct point_light
+	struct point_light : public streamed_data
 	{
-		// OpenGL buffer ID for the point light data
-		GLuint buffer;
-
 		// Actual point light data
 		point_light_data data;
 
-		// Creates a point light.  Sets buffer to 0 (no buffer)
-		point_light() : buffer(0) { }
-
-		// Deletes point light.  Deletes buffer if valid
-		~point_light()
-		{
-			// If buffer is valid, delete.
-			if (buffer) glDeleteBuffers(1, &buffer);
-			// Set buffer to 0 (no buffer)
-			buffer = 0;
-		}
-
 		void translate(const glm::vec3& translation);
 
 		void set_range(float range);
@@ -122,6 +95,9 @@ namespace render_framework
 		void set_colour(const glm::vec4& colour);
 
 		bool build();
+
+		// Copies part of the light data for upload to the buffer
+		void copy_data(std::size_t offset, std::size_t size, void* destination) const;
 	};
 
 	/*
@@ -163,20 +139,11 @@ namespace render_framework
 	/*
 	Structure representing a spot light
 	*/
-	struct spot_light
+	struct spot_light : public streamed_data
 	{
-		// OpenGL buffer ID for stored spot light data
-		GLuint buffer;
+		// Stored spot light data
 		spot_light_data data;
 
-		spot_light() : buffer(0) { }
-
-		~spot_light()
-		{
-			if (buffer) glDeleteBuffers(1, &buffer);
-			buffer = 0;
-		}
-
 		void translate(const glm::vec3& translation);
 
 		void rotate(const glm::vec3& rotation);
@@ -190,6 +157,9 @@ namespace render_framework
 		void set_power(float power);
 
 		bool build();
+
+		// Copies part of the light data for upload to the buffer
+		void copy_data(std::size_t offset, std::size_t size, void* destination) const;
 	};
 
 	/*
@@ -204,19 +174,12 @@ namespace render_framework
 	/*
 	Structure representing a set of dynamic lights
 	*/
-	struct dynamic_lights
+	struct dynamic_lights : public streamed_data
 	{
-		GLuint buffer;
+		// Point and spot light data.  The buffer holds the point lights
+		// followed by the spot lights
 		dynamic_lights_data data;
 
-		dynamic_lights() : buffer(0) { }
-
-		~dynamic_lights()
-		{
-			if (buffer) glDeleteBuffers(1, &buffer);
-			buffer = 0;
-		}
-
 		void translate_point(int index, const glm::vec3& translation);
 
 		void set_range_point(int index, float range);
@@ -236,5 +199,9 @@ namespace render_framework
 		void set_power_spot(int index, float power);
 
 		bool build();
+
+		// Copies part of the light data for upload to the buffer.  The range
+		// may span both the point and spot lights
+		void copy_data(std::size_t offset, std::size_t size, void* destination) const;
 	};
 }
\ No newline at end of file
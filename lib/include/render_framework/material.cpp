@@ -3,148 +3,287 @@
 #include "renderer.h"
 #include "light.h"
 #include "util.h"
+#include <cstring>
+#include <algorithm>
 
 namespace render_framework
 {
-    bool effect_values::bind()
-    {
-        // Now attempt to bind all the uniform values.
-		for (auto iter = value_map.begin(); iter != value_map.end(); ++iter)
+	// Alignment of each value in the data block.  Enough for a double
+	const std::size_t VALUE_ALIGNMENT = sizeof(double);
+
+	/*
+	Finds the entry with the given handle.  Setting values is rare next to
+	binding them, so a linear search is fine
+	*/
+	static std::vector<uniform_value>::iterator find_value(std::vector<uniform_value>& values, const uniform_handle& handle)
+	{
+		auto iter = values.begin();
+		for (; iter != values.end(); ++iter)
+		{
+			if (iter->handle.hash == handle.hash)
+				break;
+		}
+		return iter;
+	}
+
+	// Orders uniform values by location
+	static bool compare_location(const uniform_value& lhs, const uniform_value& rhs)
+	{
+		return lhs.location < rhs.location;
+	}
+
+	// Adds an entry, keeping the entries sorted by location
+	static void insert_value(std::vector<uniform_value>& values, const uniform_value& value)
+	{
+		values.insert(std::upper_bound(values.begin(), values.end(), value, compare_location), value);
+	}
+
+	// Gets the size of the value of a type in the data block
+	static std::size_t value_size(UNIFORM_TYPE type)
+	{
+		switch (type)
+		{
+		case INT:
+			return sizeof(int);
+		case DOUBLE:
+			return sizeof(double);
+		case FLOAT:
+			return sizeof(float);
+		case UNSIGNED_INT:
+			return sizeof(unsigned int);
+		case VEC2:
+			return sizeof(glm::vec2);
+		case VEC3:
+			return sizeof(glm::vec3);
+		case VEC4:
+			return sizeof(glm::vec4);
+		case MAT2:
+			return sizeof(glm::mat2);
+		case MAT3:
+			return sizeof(glm::mat3);
+		case MAT4:
+			return sizeof(glm::mat4);
+		default:
+			return 0;
+		}
+	}
+
+	/*
+	Copies a value into the data block.  A replaced value of the same size
+	is overwritten in place.  Otherwise the value is added to the end of the
+	block, and the old bytes are left unused
+	*/
+	bool effect_values::set_value(const effect& eff, const std::string& name, UNIFORM_TYPE type, const void* value, std::size_t size)
+	{
+		uniform_handle handle(name);
+		GLint location = eff.get_location(handle);
+		if (location == -1)
+		{
+			std::cerr << "Uniform " << name << " does not exist" << std::endl;
+			return false;
+		}
+
+		auto iter = find_value(values, handle);
+		if (iter != values.end() && (iter->location != location || value_size(iter->type) != size))
+		{
+			values.erase(iter);
+			iter = values.end();
+		}
+		if (iter == values.end())
+		{
+			std::size_t offset = (data.size() + VALUE_ALIGNMENT - 1) / VALUE_ALIGNMENT * VALUE_ALIGNMENT;
+			data.resize(offset + size);
+			insert_value(values, uniform_value(handle, location, type, static_cast<unsigned int>(offset)));
+			iter = find_value(values, handle);
+		}
+		iter->type = type;
+		std::memcpy(&data[iter->offset], value, size);
+		return true;
+	}
+
+	/*
+	Sets a light.  Lights are uniform blocks, except directional lights
+	without a buffer, which are set member by member
+	*/
+	bool effect_values::set_light(const effect& eff, const std::string& name, UNIFORM_TYPE type, std::shared_ptr<void> value)
+	{
+		uniform_handle handle(name);
+		GLint binding = eff.get_block_binding(handle);
+		auto iter = find_value(values, handle);
+		if (iter != values.end() && (iter->location != binding || iter->type < DIR_LIGHT))
+		{
+			values.erase(iter);
+			iter = values.end();
+		}
+		if (iter == values.end())
+		{
+			lights.push_back(value);
+			insert_value(values, uniform_value(handle, binding, type, static_cast<unsigned int>(lights.size() - 1)));
+			return true;
+		}
+		iter->type = type;
+		lights[iter->offset] = value;
+		return true;
+	}
+
+	/*
+	Sets a texture.  Textures are bound to units in the order they were
+	first set
+	*/
+	bool effect_values::set_texture(const effect& eff, const std::string& name, std::shared_ptr<texture> value)
+	{
+		uniform_handle handle(name);
+		GLint location = eff.get_location(handle);
+		if (location == -1)
+		{
+			std::cerr << "Uniform " << name << " does not exist" << std::endl;
+			return false;
+		}
+		for (auto iter = textures.begin(); iter != textures.end(); ++iter)
+		{
+			if (iter->handle.hash == handle.hash)
+			{
+				iter->location = location;
+				iter->value = value;
+				return true;
+			}
+		}
+		textures.push_back(texture_value<texture>(handle, location, value));
+		return true;
+	}
+
+	/*
+	Sets a cubemap.  Cubemaps are bound to units after the textures, in the
+	order they were first set
+	*/
+	bool effect_values::set_texture(const effect& eff, const std::string& name, std::shared_ptr<cube_map> value)
+	{
+		uniform_handle handle(name);
+		GLint location = eff.get_location(handle);
+		if (location == -1)
+		{
+			std::cerr << "Uniform " << name << " does not exist" << std::endl;
+			return false;
+		}
+		for (auto iter = cubemaps.begin(); iter != cubemaps.end(); ++iter)
 		{
-			switch (iter->second.first)
+			if (iter->handle.hash == handle.hash)
+			{
+				iter->location = location;
+				iter->value = value;
+				return true;
+			}
+		}
+		cubemaps.push_back(texture_value<cube_map>(handle, location, value));
+		return true;
+	}
+
+	/*
+	Walks the entries in location order, calling glUniform directly for each
+	value.  Errors are checked once at the end
+	*/
+	bool effect_values::bind(unsigned int first_unit)
+	{
+		frame_stats& stats = renderer::get_instance().edit_frame_stats();
+		const char* block = data.empty() ? nullptr : &data[0];
+		for (auto iter = values.begin(); iter != values.end(); ++iter)
+		{
+			const char* value = block + iter->offset;
+			switch (iter->type)
 			{
 			case INT:
-				{
-					int value = boost::get<int>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniform1i(iter->location, *reinterpret_cast<const int*>(value));
 				break;
 
 			case DOUBLE:
-				{
-					double value = boost::get<double>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniform1d(iter->location, *reinterpret_cast<const double*>(value));
 				break;
 
 			case FLOAT:
-				{
-					float value = boost::get<float>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniform1f(iter->location, *reinterpret_cast<const float*>(value));
 				break;
 
 			case UNSIGNED_INT:
-				{
-					float value = boost::get<unsigned int>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniform1ui(iter->location, *reinterpret_cast<const unsigned int*>(value));
 				break;
 
 			case VEC2:
-				{
-					glm::vec2 value = boost::get<glm::vec2>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniform2fv(iter->location, 1, reinterpret_cast<const float*>(value));
 				break;
 
 			case VEC3:
-				{
-					glm::vec3 value = boost::get<glm::vec3>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniform3fv(iter->location, 1, reinterpret_cast<const float*>(value));
 				break;
 
 			case VEC4:
-				{
-					glm::vec4 value = boost::get<glm::vec4>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniform4fv(iter->location, 1, reinterpret_cast<const float*>(value));
 				break;
 
 			case MAT2:
-				{
-					glm::mat2 value = boost::get<glm::mat2>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniformMatrix2fv(iter->location, 1, GL_FALSE, reinterpret_cast<const float*>(value));
 				break;
 
 			case MAT3:
-				{
-					glm::mat3 value = boost::get<glm::mat3>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniformMatrix3fv(iter->location, 1, GL_FALSE, reinterpret_cast<const float*>(value));
 				break;
 
 			case MAT4:
-				{
-					glm::mat4 value = boost::get<glm::mat4>(iter->second.second);
-					if (!renderer::get_instance().set_uniform(iter->first, value))
-						return false;
-				}
+				glUniformMatrix4fv(iter->location, 1, GL_FALSE, reinterpret_cast<const float*>(value));
 				break;
 
 			case DIR_LIGHT:
 				{
-					std::shared_ptr<directional_light> value = boost::get<std::shared_ptr<directional_light>>(iter->second.second);
+					auto light = static_cast<const directional_light*>(lights[iter->offset].get());
 					// Check if we have a buffer
-					if (value->buffer)
+					if (!light->buffer)
 					{
-						if (!renderer::get_instance().set_uniform_block(iter->first, value->buffer, sizeof(directional_light_data)))
+						if (!renderer::get_instance().set_uniform(iter->handle, *light))
 							return false;
+						continue;
 					}
-					else if (!renderer::get_instance().set_uniform(iter->first, *value))
+					if (iter->location == -1)
 						return false;
+					glBindBufferRange(GL_UNIFORM_BUFFER, iter->location, light->buffer, 0, sizeof(directional_light_data));
+					++stats.uniform_block_binds;
 				}
-				break;
+				continue;
 
 			case POINT_LIGHT:
-				{
-					std::shared_ptr<point_light> value = boost::get<std::shared_ptr<point_light>>(iter->second.second);
-					if (!renderer::get_instance().set_uniform_block(iter->first, value->buffer, sizeof(point_light)))
-						return false;
-				}
-				break;
+				if (iter->location == -1)
+					return false;
+				glBindBufferRange(GL_UNIFORM_BUFFER, iter->location, static_cast<const point_light*>(lights[iter->offset].get())->buffer, 0, sizeof(point_light_data));
+				++stats.uniform_block_binds;
+				continue;
 
 			case SPOT_LIGHT:
-				{
-					std::shared_ptr<spot_light> value = boost::get<std::shared_ptr<spot_light>>(iter->second.second);
-					if (!renderer::get_instance().set_uniform_block(iter->first, value->buffer, sizeof(spot_light)))
-						return false;
-				}
-				break;
+				if (iter->location == -1)
+					return false;
+				glBindBufferRange(GL_UNIFORM_BUFFER, iter->location, static_cast<const spot_light*>(lights[iter->offset].get())->buffer, 0, sizeof(spot_light_data));
+				++stats.uniform_block_binds;
+				continue;
 			}
+			++stats.uniform_calls;
 		}
 
-		// Now do the same for the textures
-		// Index of current texture
-		int index = 0;
-		for (auto iter = texture_map.begin(); iter != texture_map.end(); ++iter)
+		// Now bind the textures to units in order, then the cubemaps
+		int index = static_cast<int>(first_unit);
+		for (auto iter = textures.begin(); iter != textures.end(); ++iter, ++index)
 		{
-			if (!renderer::get_instance().bind_texture(iter->second, index))
+			if (!renderer::get_instance().bind_texture(iter->value, index))
 				return false;
-			if (!renderer::get_instance().set_uniform(iter->first, index))
+			glUniform1i(iter->location, index);
+			++stats.uniform_calls;
+		}
+		for (auto iter = cubemaps.begin(); iter != cubemaps.end(); ++iter, ++index)
+		{
+			if (!renderer::get_instance().bind_texture(iter->value, index))
 				return false;
-			++index;
+			glUniform1i(iter->location, index);
+			++stats.uniform_calls;
 		}
-        for (auto& e : cubemap_map)
-        {
-            if (!renderer::get_instance().bind_texture(e.second, index))
-                return false;
-            if (!renderer::get_instance().set_uniform(e.first, index))
-                return false;
-            ++index;
-        }
-    }
+
+		return !CHECK_GL_ERROR;
+	}
 
 
 	//****** TODO - check types of uniform values ******
@@ -154,17 +293,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		// Check if effect has uniform of given name
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(INT, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, INT, &value, sizeof(int));
 	}
 
 	template <>
@@ -172,16 +301,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(DOUBLE, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, DOUBLE, &value, sizeof(double));
 	}
 
 	template <>
@@ -189,16 +309,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(FLOAT, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, FLOAT, &value, sizeof(float));
 	}
 
 	template <>
@@ -206,16 +317,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(UNSIGNED_INT, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, UNSIGNED_INT, &value, sizeof(unsigned int));
 	}
 
 	template <>
@@ -223,16 +325,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(VEC2, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, VEC2, &value, sizeof(glm::vec2));
 	}
 
 	template <>
@@ -240,16 +333,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(VEC3, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, VEC3, &value, sizeof(glm::vec3));
 	}
 
 	template <>
@@ -257,16 +341,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(VEC4, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, VEC4, &value, sizeof(glm::vec4));
 	}
 
 	template <>
@@ -274,16 +349,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(MAT2, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, MAT2, &value, sizeof(glm::mat2));
 	}
 
 	template <>
@@ -291,16 +357,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(MAT3, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, MAT3, &value, sizeof(glm::mat3));
 	}
 
 	template <>
@@ -308,16 +365,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(MAT4, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*effect, name, MAT4, &value, sizeof(glm::mat4));
 	}
 
 	template <>
@@ -325,8 +373,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		uniform_values->value_map[name] = std::make_pair(DIR_LIGHT, value);
-		return true;
+		return uniform_values->set_light(*effect, name, DIR_LIGHT, value);
 	}
 
 	template <>
@@ -340,8 +387,7 @@ namespace render_framework
 			return false;
 		}
 		// Add uniform to material
-		uniform_values->value_map[name] = std::make_pair(POINT_LIGHT, value);
-		return true;
+		return uniform_values->set_light(*effect, name, POINT_LIGHT, value);
 	}
 
 	template <>
@@ -355,40 +401,21 @@ namespace render_framework
 			return false;
 		}
 		// Add uniform to material
-		uniform_values->value_map[name] = std::make_pair(SPOT_LIGHT, value);
-		return true;
+		return uniform_values->set_light(*effect, name, SPOT_LIGHT, value);
 	}
 
 	bool material::set_texture(const std::string& name, std::shared_ptr<texture> value)
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (effect->uniforms.find(name) != effect->uniforms.end())
-		{
-			uniform_values->texture_map[name] = value;
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_texture(*effect, name, value);
 	}
 
     bool material::set_texture(const std::string& name, std::shared_ptr<cube_map> value)
     {
         if (uniform_values == nullptr)
             uniform_values = std::make_shared<effect_values>();
-        if (effect->uniforms.find(name) != effect->uniforms.end())
-        {
-            uniform_values->cubemap_map[name] = value;
-            return true;
-        }
-        else
-        {
-            std::cerr << "Uniform " << name << " does not exist" << std::endl;
-            return false;
-        }
+        return uniform_values->set_texture(*effect, name, value);
     }
 
 	bool material::bind()
@@ -397,16 +424,37 @@ namespace render_framework
 		if (!renderer::get_instance().bind(effect))
 			return false;
 
+		// Bind the values used by the effect
+		return bind_values();
+	}
+
+	bool material::bind_values()
+	{
+		static const uniform_handle material_handle("material");
+		static const uniform_handle mat_handle("mat");
+
+		// Instances use the data of the base unless they override it
+		const material& source = (base && !overrides_data) ? *base : *this;
+
 		// Bind the standard material data to material if valid
-		if (buffer)
-			renderer::get_instance().set_uniform_block("material", buffer, sizeof(material_data));
+		if (source.buffer)
+			renderer::get_instance().set_uniform_block(material_handle, source.buffer, sizeof(material_data));
 		// Otherwise try and set the material values individually
 		else
-			renderer::get_instance().set_uniform("mat", *this);
+			renderer::get_instance().set_uniform(mat_handle, source);
 
+		// Bind the values of the base first, so the instance's overrides
+		// replace them.  Overriding textures use the units after the base's
+		unsigned int unit = 0;
+		if (base && base->uniform_values)
+		{
+			if (!base->uniform_values->bind())
+				return false;
+			unit = base->uniform_values->texture_count();
+		}
 		if (uniform_values)
 		{
-            if (!uniform_values->bind())
+            if (!uniform_values->bind(unit))
                 return false;
 		}
 
@@ -414,9 +462,40 @@ namespace render_framework
 		return true;
 	}
 
+	void material::copy_data(std::size_t offset, std::size_t size, void* destination) const
+	{
+		std::memcpy(destination, reinterpret_cast<const char*>(&data) + offset, size);
+	}
+
+	/*
+	Replaces the data.  An instance only has a buffer of its own once it
+	overrides the data, so the first override of an instance whose base is
+	already built has nothing for the stream buffer to upload to.  Build it
+	now, or the data would never reach the material block
+	*/
+	bool material::set_data(const material_data& value)
+	{
+		data = value;
+		if (base && !buffer)
+		{
+			overrides_data = true;
+			if (base->buffer && !build())
+			{
+				std::cerr << "Error creating buffer for material instance data" << std::endl;
+				return false;
+			}
+			return true;
+		}
+		mark_dirty(0, sizeof(material_data));
+		return true;
+	}
+
 	bool material::build()
 	{
-		glGenBuffers(1, &buffer);
+		if (base && !overrides_data)
+			return true;
+		if (!buffer)
+			glGenBuffers(1, &buffer);
 		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
 		glBufferData(GL_UNIFORM_BUFFER, sizeof(material_data), &data, GL_STATIC_DRAW);
 		return !CHECK_GL_ERROR;
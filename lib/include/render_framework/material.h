@@ -3,11 +3,12 @@
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <memory>
 #include <glm\glm.hpp>
 #include <GL\glew.h>
-#include <boost\variant.hpp>
 #include "light.h"
+#include "effect.h"
 
 namespace render_framework
 {
@@ -68,33 +69,114 @@ namespace render_framework
 		}
 	};
 
-	// Structure containing set uniform values for an effect
+	/*
+	Entry describing one uniform value set on an effect
+	*/
+	struct uniform_value
+	{
+		// Handle of the uniform name.  Used to find the entry when the value
+		// is replaced, and to set directional lights without a buffer
+		uniform_handle handle;
+		// Location of the uniform, or binding point for a light block.
+		// Resolved against the effect when the value is set
+		GLint location;
+		// Type of the value
+		UNIFORM_TYPE type;
+		// Offset of the value in effect_values::data, or index in
+		// effect_values::lights for the light types
+		unsigned int offset;
+
+		// Creates an entry
+		uniform_value(const uniform_handle& handle, GLint location, UNIFORM_TYPE type, unsigned int offset)
+			: handle(handle), location(location), type(type), offset(offset)
+		{
+		}
+	};
+
+	/*
+	Entry describing a texture set on an effect
+	*/
+	template <typename T>
+	struct texture_value
+	{
+		// Handle of the sampler name
+		uniform_handle handle;
+		// Location of the sampler uniform
+		GLint location;
+		// Texture bound to the sampler
+		std::shared_ptr<T> value;
+
+		// Creates an entry
+		texture_value(const uniform_handle& handle, GLint location, std::shared_ptr<T> value)
+			: handle(handle), location(location), value(value)
+		{
+		}
+	};
+
+	/*
+	Structure containing set uniform values for an effect.  Values are copied
+	into one block of memory, with an entry per uniform giving its location,
+	type and offset.  Locations are resolved when a value is set, so binding
+	is a walk over the entries in location order with no name lookups.  The
+	values must be bound with the effect they were set against
+	*/
 	struct effect_values
 	{
-		std::unordered_map<std::string, 
-			std::pair<UNIFORM_TYPE, boost::variant<int, 
-												   double,
-												   float,
-												   unsigned int,
-												   glm::vec2,
-												   glm::vec3,
-												   glm::vec4,
-												   glm::mat2,
-												   glm::mat3,
-												   glm::mat4,
-												   std::shared_ptr<directional_light>,
-												   std::shared_ptr<point_light>,
-												   std::shared_ptr<spot_light>>>> value_map;
-		std::unordered_map<std::string, std::shared_ptr<texture>> texture_map;
-        std::unordered_map<std::string, std::shared_ptr<cube_map>> cubemap_map;
+		// Entries for each value, sorted by location
+		std::vector<uniform_value> values;
+		// Block holding the values.  Each is aligned to sizeof(double)
+		std::vector<char> data;
+		// Lights set as values.  Lights are read when bound, as their buffers
+		// may be created after they are set
+		std::vector<std::shared_ptr<void>> lights;
+		// Textures, bound to units in order
+		std::vector<texture_value<texture>> textures;
+		// Cubemaps, bound to the units after the textures
+		std::vector<texture_value<cube_map>> cubemaps;
 
 		~effect_values()
 		{
-			value_map.clear();
-			texture_map.clear();
+			values.clear();
+			data.clear();
+			lights.clear();
+			textures.clear();
+			cubemaps.clear();
 		}
 
-        bool bind();
+		/*
+		Copies a value of the given type and size, replacing any value set
+		with the same name.  Returns false if the effect has no uniform of
+		that name
+		*/
+		bool set_value(const effect& eff, const std::string& name, UNIFORM_TYPE type, const void* value, std::size_t size);
+
+		/*
+		Sets a light of the given type, replacing any value set with the same
+		name
+		*/
+		bool set_light(const effect& eff, const std::string& name, UNIFORM_TYPE type, std::shared_ptr<void> value);
+
+		/*
+		Sets a texture, replacing any texture set with the same name
+		*/
+		bool set_texture(const effect& eff, const std::string& name, std::shared_ptr<texture> value);
+
+		/*
+		Sets a cubemap, replacing any cubemap set with the same name
+		*/
+		bool set_texture(const effect& eff, const std::string& name, std::shared_ptr<cube_map> value);
+
+		// Gets the number of texture units used
+		unsigned int texture_count() const
+		{
+			return static_cast<unsigned int>(textures.size() + cubemaps.size());
+		}
+
+		/*
+		Sets the values and binds the textures, starting from the given
+		texture unit.  Assumes the effect the values were set against is bound
+		*/
+        bool bind(unsigned int first_unit = 0);
 	};
 
 	// Forward declaration of texture
@@ -102,31 +184,50 @@ namespace render_framework
 
 	/*
 	Structure representing a material.  This includes the material data and the
-	buffer on the GPU (if relevant)
+	buffer on the GPU (if relevant).
+
+	A material created from a base material is an instance of it.  Instances
+	use the effect, data, buffer, uniform values and textures of the base, and
+	only hold the values they override, so many objects can share one buffer
+	and one set of textures.  Overridden uniform values and textures are bound
+	after the base's.  Instances only read the base, so the base should not be
+	changed once it has instances.
 	*/
-	struct material
+	struct material : public streamed_data
 	{
-		// The ID of the buffer as stored in OpenGL
-		GLuint buffer;
 		// Data stored in the buffer
 		material_data data;
 		// Effect attached to the material
 		std::shared_ptr<effect> effect;
-		// Uniform values to set in the effect
+		// Uniform values to set in the effect.  For an instance, only the
+		// values overriding the base
 		std::shared_ptr<effect_values> uniform_values;
-
-		// Creates a material object.  Ensures buffer is set to 0 (no buffer)
-		material() : buffer(0), effect(nullptr), uniform_values(nullptr) { }
-
-		// Deletes a material.  Will delete the buffer if it is valid (not 0)
-		~material()
+		// Material this is an instance of, if any
+		std::shared_ptr<material> base;
+		// Flag indicating an instance has its own data and buffer rather
+		// than using the base's
+		bool overrides_data;
+
+		// Creates a material object
+		material() : effect(nullptr), uniform_values(nullptr), base(nullptr), overrides_data(false) { }
+
+		// Creates an instance of a base material
+		explicit material(const std::shared_ptr<material>& base)
+			: data(base->data), effect(base->effect), uniform_values(nullptr), base(base), overrides_data(false)
 		{
-			// Check if buffer is valid (not 0), and if so delete
-			if (buffer) glDeleteBuffers(1, &buffer);
-			// Set buffer to 0 (no buffer)
-			buffer = 0;
 		}
 
+		/*
+		Replaces the material data.  The buffer is updated with the next flush
+		of the stream buffer.  An instance sharing the buffer of a built base
+		is given its own buffer straight away.  Returns false if the buffer
+		could not be created
+		*/
+		bool set_data(const material_data& value);
+
+		// Copies part of the material data for upload to the buffer
+		void copy_data(std::size_t offset, std::size_t size, void* destination) const;
+
 		/*
 		Provides a method to define a uniform value for the effect
 		*/
@@ -149,7 +250,15 @@ namespace render_framework
 		bool bind();
 
 		/*
-		Builds the material initialising the uniform buffer
+		Binds the material data, uniform values and textures.  Assumes the
+		effect of the material is already bound
+		*/
+		bool bind_values();
+
+		/*
+		Builds the material initialising the uniform buffer.  Instances not
+		overriding the data use the buffer of the base, so create nothing.
+		Building again uploads the data to the existing buffer
 		*/
 		bool build();
 	};
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <vector>
+#include <memory>
 #include "transform.h"
+#include "transform_hierarchy.h"
 
 namespace render_framework
 {
@@ -13,20 +16,46 @@ namespace render_framework
 	*/
 	struct mesh
 	{
-		// The world transform of the render object
+		// The world transform of the render object.  Not used if the mesh is
+		// attached to a transform hierarchy
 		transform trans;
 		// The geometry used by the render object
 		std::shared_ptr<geometry> geom;
 		// Material associated with the render object
 		std::shared_ptr<material> mat;
+		// Hierarchy holding the transform of the render object, if any
+		std::shared_ptr<transform_hierarchy> hierarchy;
+		// The node of the render object in the hierarchy
+		unsigned int node;
 
 		/*
 		Constructs a new mesh.  Sets values accordingly
 		*/
-		mesh() : geom(nullptr), mat(nullptr)
+		mesh() : geom(nullptr), mat(nullptr), hierarchy(nullptr), node(0)
 		{
 		}
 
+		/*
+		Gets the world matrix of the mesh.  If the mesh is in a hierarchy the
+		cached render matrix from the last update or interpolate is used
+		*/
+		glm::mat4 get_transform_matrix() const
+		{
+			if (hierarchy)
+				return hierarchy->get_render_matrix(node);
+			return trans.get_transform_matrix();
+		}
+
+		/*
+		Gets the world normal matrix of the mesh
+		*/
+		glm::mat3 get_normal_matrix() const
+		{
+			if (hierarchy)
+				return hierarchy->get_normal_matrix(node);
+			return trans.get_normal_matrix();
+		}
+
 		/*
 		Destroys a mesh.
 		*/
@@ -35,4 +64,70 @@ namespace render_framework
 			// Reference counting on shared pointers should handle this
 		}
 	};
+
+	/*
+	A data structure used to render many copies of the same geometry and
+	material in a single draw call.  The model matrices are streamed into the
+	instance buffer of the geometry, which effects read as a mat4 attribute at
+	location 7 (using locations 7 to 10)
+	*/
+	struct mesh_instances
+	{
+		// The geometry used by every instance
+		std::shared_ptr<geometry> geom;
+		// Material shared by every instance
+		std::shared_ptr<material> mat;
+		// The model matrix of each instance
+		std::vector<glm::mat4> matrices;
+
+		/*
+		Constructs an empty set of instances
+		*/
+		mesh_instances() : geom(nullptr), mat(nullptr)
+		{
+		}
+
+		/*
+		Constructs an empty set of instances of the geometry and material of
+		a mesh
+		*/
+		explicit mesh_instances(const mesh& value) : geom(value.geom), mat(value.mat)
+		{
+		}
+
+		/*
+		Adds an instance using a precomputed model matrix
+		*/
+		void add(const glm::mat4& model)
+		{
+			matrices.push_back(model);
+		}
+
+		/*
+		Adds an instance using a transform
+		*/
+		void add(const transform& trans)
+		{
+			matrices.push_back(trans.get_transform_matrix());
+		}
+
+		/*
+		Replaces the instances with the given array of transforms.  Storage is
+		kept so that updating each frame does not allocate
+		*/
+		void set(const transform* values, std::size_t count)
+		{
+			matrices.resize(count);
+			for (std::size_t i = 0; i < count; ++i)
+				matrices[i] = values[i].get_transform_matrix();
+		}
+
+		/*
+		Removes all instances.  Storage is kept
+		*/
+		void clear()
+		{
+			matrices.clear();
+		}
+	};
 }
\ No newline at end of file
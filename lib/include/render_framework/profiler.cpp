@@ -0,0 +1,297 @@
+#include "profiler.h"
+#include <iostream>
+#include <iomanip>
+#include "util.h"
+
+// The Visual Studio 2012 clocks only tick once a millisecond, so the
+// performance counter is used directly on Windows
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <chrono>
+#endif
+
+// Thread local storage.  Visual Studio 2012 does not support thread_local
+#if defined(_MSC_VER)
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL __thread
+#endif
+
+namespace render_framework
+{
+	// Flag indicating zones should be recorded
+	std::atomic<bool> profiler::_enabled(false);
+
+	// Next trace thread ID to hand out.  GPU zones use PROFILER_GPU_THREAD
+	static std::atomic<unsigned int> next_thread_id(PROFILER_GPU_THREAD + 1);
+
+	// Trace thread ID of the calling thread.  0 until first used
+	static PROFILER_THREAD_LOCAL unsigned int thread_id = 0;
+
+	// Gets the current CPU time in nanoseconds
+	std::int64_t profiler::get_time()
+	{
+#if defined(_WIN32)
+		static LARGE_INTEGER frequency = { 0 };
+		if (frequency.QuadPart == 0)
+			QueryPerformanceFrequency(&frequency);
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		// Split the conversion so large counts do not overflow
+		return (counter.QuadPart / frequency.QuadPart) * 1000000000LL
+			+ (counter.QuadPart % frequency.QuadPart) * 1000000000LL / frequency.QuadPart;
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Gets the trace thread ID of the calling thread, handing one out on first use
+	unsigned int profiler::get_thread_id()
+	{
+		if (thread_id == 0)
+			thread_id = next_thread_id++;
+		return thread_id;
+	}
+
+	/*
+	Opens the trace file and enables the zones.  GPU zones are only recorded
+	if timer queries are supported
+	*/
+	bool profiler::start_capture(const std::string& filename)
+	{
+		if (is_capturing())
+			stop_capture();
+
+		_file.open(filename.c_str(), std::ios::out | std::ios::trunc);
+		if (!_file.is_open())
+		{
+			std::cerr << "Error - could not open profile capture file " << filename << std::endl;
+			return false;
+		}
+		_file << std::fixed << std::setprecision(3);
+		_file << "{\"traceEvents\":[" << std::endl;
+		_first_event = true;
+		_dropped = 0;
+
+		_gpu_supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+		if (!_gpu_supported)
+			std::cerr << "Warning - timer queries not supported.  GPU zones will not be recorded" << std::endl;
+
+		// Name the GPU track
+		_file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << PROFILER_GPU_THREAD << ",\"args\":{\"name\":\"GPU\"}}";
+		_first_event = false;
+
+		_time_base = get_time();
+		_frame_start = _time_base;
+		for (unsigned int i = 0; i < PROFILER_FRAMES; ++i)
+		{
+			_gpu_frames[i].used = 0;
+			_gpu_frames[i].events.clear();
+		}
+		_gpu_frame = 0;
+		if (_gpu_supported)
+			begin_gpu_frame(_gpu_frame);
+
+		_enabled.store(true);
+		std::clog << "Profile capture started to " << filename << std::endl;
+		return true;
+	}
+
+	/*
+	Disables the zones and writes what is left.  The GPU is finished first so
+	the last frames are not lost
+	*/
+	void profiler::stop_capture()
+	{
+		if (!is_capturing())
+			return;
+
+		_enabled.store(false);
+		if (_gpu_supported)
+		{
+			glFinish();
+			for (unsigned int i = 1; i <= PROFILER_FRAMES; ++i)
+				read_gpu_frame((_gpu_frame + i) % PROFILER_FRAMES);
+		}
+		write_cpu_events();
+
+		_file << std::endl << "]}" << std::endl;
+		_file.close();
+		if (_dropped > 0)
+			std::clog << "Profile capture dropped GPU zones of " << _dropped << " frames" << std::endl;
+		std::clog << "Profile capture finished" << std::endl;
+	}
+
+	/*
+	Adds a frame zone covering the time since the last end_frame, writes the
+	CPU zones, then moves GPU zones on to the next frame in flight, reading
+	back the zones it held first
+	*/
+	void profiler::end_frame()
+	{
+		if (!is_enabled())
+			return;
+
+		std::int64_t now = get_time();
+		add_cpu_event("frame", _frame_start, now);
+		_frame_start = now;
+		write_cpu_events();
+
+		if (_gpu_supported)
+		{
+			_gpu_frame = (_gpu_frame + 1) % PROFILER_FRAMES;
+			read_gpu_frame(_gpu_frame);
+			begin_gpu_frame(_gpu_frame);
+		}
+	}
+
+	// Adds a finished CPU zone
+	void profiler::add_cpu_event(const char* name, std::int64_t start, std::int64_t end)
+	{
+		cpu_event value;
+		value.name = name;
+		value.thread = get_thread_id();
+		value.start = start;
+		value.end = end;
+		std::lock_guard<std::mutex> guard(_cpu_lock);
+		_cpu_events.push_back(value);
+	}
+
+	/*
+	Writes a timestamp query for the start of a GPU zone.  Queries come from
+	the frame's pool, which grows a block at a time the first frames round
+	*/
+	int profiler::begin_gpu(const char* name)
+	{
+		if (!_gpu_supported)
+			return -1;
+
+		auto& frame = _gpu_frames[_gpu_frame];
+		if (frame.used + 2 > frame.queries.size())
+		{
+			std::size_t size = frame.queries.size();
+			frame.queries.resize(size + PROFILER_QUERY_BLOCK);
+			glGenQueries(PROFILER_QUERY_BLOCK, &frame.queries[size]);
+		}
+
+		gpu_event value;
+		value.name = name;
+		value.begin = frame.queries[frame.used++];
+		value.end = frame.queries[frame.used++];
+		glQueryCounter(value.begin, GL_TIMESTAMP);
+		frame.events.push_back(value);
+		return static_cast<int>(frame.events.size() - 1);
+	}
+
+	// Writes a timestamp query for the end of a GPU zone
+	void profiler::end_gpu(int index)
+	{
+		auto& frame = _gpu_frames[_gpu_frame];
+		if (index < 0 || static_cast<std::size_t>(index) >= frame.events.size())
+			return;
+		glQueryCounter(frame.events[index].end, GL_TIMESTAMP);
+	}
+
+	/*
+	Writes a timestamp query at the start of a frame and records the CPU time
+	alongside it, so GPU zones can be placed on the CPU timeline.  The query
+	is read back with the frame's zones, rather than asking for the GPU time
+	now, which would wait for the GPU to receive every command so far
+	*/
+	void profiler::begin_gpu_frame(unsigned int index)
+	{
+		auto& frame = _gpu_frames[index];
+		frame.used = 0;
+		frame.events.clear();
+		if (frame.base == 0)
+			glGenQueries(1, &frame.base);
+		glQueryCounter(frame.base, GL_TIMESTAMP);
+		frame.cpu_base = get_time();
+	}
+
+	/*
+	Reads back the GPU zones of a frame.  Queries complete in order, so if the
+	last one is available they all are.  Otherwise the frame is dropped
+	*/
+	void profiler::read_gpu_frame(unsigned int index)
+	{
+		auto& frame = _gpu_frames[index];
+		if (frame.used == 0)
+			return;
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+		{
+			++_dropped;
+			frame.used = 0;
+			frame.events.clear();
+			return;
+		}
+
+		GLuint64 base = 0;
+		glGetQueryObjectui64v(frame.base, GL_QUERY_RESULT, &base);
+		std::int64_t gpu_base = static_cast<std::int64_t>(base);
+		for (auto iter = frame.events.begin(); iter != frame.events.end(); ++iter)
+		{
+			GLuint64 begin = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(iter->begin, GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(iter->end, GL_QUERY_RESULT, &end);
+			std::int64_t start = frame.cpu_base + (static_cast<std::int64_t>(begin) - gpu_base);
+			write_event(iter->name, PROFILER_GPU_THREAD, start, start + static_cast<std::int64_t>(end - begin));
+		}
+		CHECK_GL_ERROR;
+		frame.used = 0;
+		frame.events.clear();
+	}
+
+	// Writes and clears the finished CPU zones
+	void profiler::write_cpu_events()
+	{
+		std::vector<cpu_event> events;
+		{
+			std::lock_guard<std::mutex> guard(_cpu_lock);
+			events.swap(_cpu_events);
+		}
+		for (auto iter = events.begin(); iter != events.end(); ++iter)
+			write_event(iter->name, iter->thread, iter->start, iter->end);
+		// Hand the storage back for the next frame
+		events.clear();
+		std::lock_guard<std::mutex> guard(_cpu_lock);
+		if (_cpu_events.empty())
+			_cpu_events.swap(events);
+	}
+
+	// Writes a complete event, with times in microseconds from the capture start
+	void profiler::write_event(const char* name, unsigned int thread, std::int64_t start, std::int64_t end)
+	{
+		if (!_first_event)
+			_file << "," << std::endl;
+		_first_event = false;
+		_file << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread
+			  << ",\"ts\":" << (start - _time_base) / 1000.0
+			  << ",\"dur\":" << (end - start) / 1000.0 << "}";
+	}
+
+	// Stops any capture and deletes the timer queries
+	void profiler::shutdown()
+	{
+		stop_capture();
+		for (unsigned int i = 0; i < PROFILER_FRAMES; ++i)
+		{
+			auto& frame = _gpu_frames[i];
+			if (!frame.queries.empty())
+				glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), &frame.queries[0]);
+			if (frame.base)
+				glDeleteQueries(1, &frame.base);
+			frame.queries.clear();
+			frame.base = 0;
+			frame.used = 0;
+			frame.events.clear();
+		}
+	}
+}
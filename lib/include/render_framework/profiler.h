@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <GL\glew.h>
+
+// Joins two tokens after expanding them.  Used to give each zone a unique name
+#define PROFILE_CONCAT_TOKENS(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_TOKENS(a, b)
+
+// Defining RENDER_FRAMEWORK_NO_PROFILER removes every zone from the build.
+// Otherwise a zone costs a single flag test while the profiler is disabled
+#if defined(RENDER_FRAMEWORK_NO_PROFILER)
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(name)
+#else
+// Times the rest of the enclosing scope on the CPU.  The name must be a
+// string that outlives the capture, such as a literal
+#define PROFILE_ZONE(name) render_framework::profile_zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+// Times the rest of the enclosing scope on both the CPU and GPU.  OpenGL
+// thread only
+#define PROFILE_GPU_ZONE(name) PROFILE_ZONE(name); render_framework::gpu_profile_zone PROFILE_CONCAT(gpu_profile_zone_, __LINE__)(name)
+#endif
+
+namespace render_framework
+{
+	// Number of frames of GPU queries in flight.  Results are read back this
+	// many frames after they are issued, by which time they are available
+	const unsigned int PROFILER_FRAMES = 2;
+
+	// Number of timer queries created at once when a frame runs out
+	const unsigned int PROFILER_QUERY_BLOCK = 64;
+
+	// Trace thread ID used for GPU zones
+	const unsigned int PROFILER_GPU_THREAD = 0;
+
+	/*
+	Records CPU and GPU time spent in named zones and writes them to a Chrome
+	trace file (load it at chrome://tracing).
+
+	CPU zones can be recorded on any thread.  GPU zones issue GL_TIMESTAMP
+	queries at each end of the zone.  Each frame also issues a timestamp query
+	as it begins, which places its GPU zones on the CPU timeline.  The queries
+	of each frame are read back PROFILER_FRAMES frames later, once the GPU has
+	finished with them, so the profiler never waits on the GPU.  Frames whose
+	queries are still not available are dropped rather than stalling.
+
+	Zones are normally added with the PROFILE_ZONE and PROFILE_GPU_ZONE
+	macros.  While no capture is running the profiler is disabled and zones
+	do nothing beyond checking a flag.
+	*/
+	class profiler
+	{
+	private:
+		// A finished CPU zone
+		struct cpu_event
+		{
+			// Name of the zone
+			const char* name;
+			// Trace thread ID the zone ran on
+			unsigned int thread;
+			// Start time in nanoseconds
+			std::int64_t start;
+			// End time in nanoseconds
+			std::int64_t end;
+		};
+
+		// A GPU zone waiting for its queries
+		struct gpu_event
+		{
+			// Name of the zone
+			const char* name;
+			// Query written at the start of the zone
+			GLuint begin;
+			// Query written at the end of the zone.  0 until the zone ends
+			GLuint end;
+		};
+
+		// The GPU zones of a frame in flight
+		struct gpu_frame
+		{
+			// Timer queries owned by the frame, reused each time around
+			std::vector<GLuint> queries;
+			// Number of queries used this time around
+			std::size_t used;
+			// Zones issued
+			std::vector<gpu_event> events;
+			// Query written when the frame began.  0 until first used
+			GLuint base;
+			// CPU time in nanoseconds when the frame began
+			std::int64_t cpu_base;
+
+			// Creates a frame with no queries
+			gpu_frame() : used(0), base(0), cpu_base(0) { }
+		};
+
+		// Flag indicating zones should be recorded
+		static std::atomic<bool> _enabled;
+		// Flag indicating timer queries are supported
+		bool _gpu_supported;
+		// Trace file being written
+		std::ofstream _file;
+		// Flag indicating no event has been written yet
+		bool _first_event;
+		// Finished CPU zones not yet written
+		std::vector<cpu_event> _cpu_events;
+		// Protects the CPU zones
+		std::mutex _cpu_lock;
+		// GPU zones of each frame in flight
+		gpu_frame _gpu_frames[PROFILER_FRAMES];
+		// Frame in flight GPU zones are added to
+		unsigned int _gpu_frame;
+		// CPU time the current frame began
+		std::int64_t _frame_start;
+		// Time all trace times are relative to
+		std::int64_t _time_base;
+		// Number of frames of GPU zones dropped as not ready
+		unsigned int _dropped;
+
+		// Private constructor.  Class is a singleton
+		profiler() : _gpu_supported(false), _first_event(true), _gpu_frame(0), _frame_start(0), _time_base(0), _dropped(0) { }
+		// Private copy constructor
+		profiler(const profiler&);
+		// Private assignment operator
+		void operator=(const profiler&);
+
+		// Starts a new frame of GPU zones in the given slot
+		void begin_gpu_frame(unsigned int index);
+		// Reads back and writes the GPU zones of the given slot
+		void read_gpu_frame(unsigned int index);
+		// Writes and clears the finished CPU zones
+		void write_cpu_events();
+		// Writes a complete event to the trace
+		void write_event(const char* name, unsigned int thread, std::int64_t start, std::int64_t end);
+	public:
+		// Stops any capture
+		~profiler() { shutdown(); }
+
+		// Gets the singleton instance
+		static profiler& get_instance()
+		{
+			static profiler instance;
+			return instance;
+		}
+
+		// Checks if zones are being recorded
+		static bool is_enabled() { return _enabled.load(std::memory_order_relaxed); }
+
+		// Gets the current CPU time in nanoseconds from an arbitrary start
+		static std::int64_t get_time();
+
+		// Gets the trace thread ID of the calling thread
+		static unsigned int get_thread_id();
+
+		// Starts recording zones to the given trace file.  Needs a current
+		// OpenGL context
+		bool start_capture(const std::string& filename);
+
+		// Finishes the trace file and stops recording zones
+		void stop_capture();
+
+		// Checks if a capture is running
+		bool is_capturing() const { return _file.is_open(); }
+
+		// Ends the current frame, writing the zones finished so far.  Called
+		// by the renderer after swapping buffers
+		void end_frame();
+
+		// Adds a finished CPU zone
+		void add_cpu_event(const char* name, std::int64_t start, std::int64_t end);
+
+		// Begins a GPU zone, returning its index or -1 if not recorded
+		int begin_gpu(const char* name);
+
+		// Ends the GPU zone with the given index
+		void end_gpu(int index);
+
+		// Stops any capture and deletes the timer queries.  Called by the
+		// renderer while the context is still current
+		void shutdown();
+	};
+
+	/*
+	Times the scope it is declared in on the CPU.  Use PROFILE_ZONE rather
+	than declaring one directly
+	*/
+	class profile_zone
+	{
+	private:
+		// Name of the zone.  nullptr if the profiler was disabled
+		const char* _name;
+		// Time the zone began
+		std::int64_t _start;
+
+		// Private copy constructor
+		profile_zone(const profile_zone&);
+		// Private assignment operator
+		void operator=(const profile_zone&);
+	public:
+		// Begins the zone if the profiler is enabled
+		explicit profile_zone(const char* name) : _name(nullptr), _start(0)
+		{
+			if (profiler::is_enabled())
+			{
+				_name = name;
+				_start = profiler::get_time();
+			}
+		}
+
+		// Ends the zone
+		~profile_zone()
+		{
+			if (_name != nullptr)
+				profiler::get_instance().add_cpu_event(_name, _start, profiler::get_time());
+		}
+	};
+
+	/*
+	Times the scope it is declared in on the GPU.  Use PROFILE_GPU_ZONE rather
+	than declaring one directly
+	*/
+	class gpu_profile_zone
+	{
+	private:
+		// Index of the zone.  -1 if not recorded
+		int _index;
+
+		// Private copy constructor
+		gpu_profile_zone(const gpu_profile_zone&);
+		// Private assignment operator
+		void operator=(const gpu_profile_zone&);
+	public:
+		// Begins the zone if the profiler is enabled
+		explicit gpu_profile_zone(const char* name) : _index(-1)
+		{
+			if (profiler::is_enabled())
+				_index = profiler::get_instance().begin_gpu(name);
+		}
+
+		// Ends the zone
+		~gpu_profile_zone()
+		{
+			if (_index >= 0)
+				profiler::get_instance().end_gpu(_index);
+		}
+	};
+}
@@ -0,0 +1,218 @@
+#include "program_cache.h"
+#include "util.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace render_framework
+{
+	// Identifies a cache file.  Changed whenever the layout changes
+	static const char CACHE_MAGIC[4] = { 'R', 'F', 'P', '1' };
+
+	// Header written before each binary
+	struct cache_header
+	{
+		// CACHE_MAGIC
+		char magic[4];
+		// Binary format reported by the driver
+		GLenum format;
+		// Size of the binary in bytes
+		std::uint32_t length;
+		// Key the binary was saved under, checked on load
+		std::uint64_t key;
+	};
+
+	// Continues an FNV-1a hash over a block of memory
+	static std::uint64_t hash_bytes(const void* data, std::size_t size, std::uint64_t hash)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (std::size_t i = 0; i < size; ++i)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	// Continues an FNV-1a hash over a string, including its length so
+	// adjacent strings cannot run into each other
+	static std::uint64_t hash_string(const std::string& value, std::uint64_t hash)
+	{
+		std::uint64_t size = value.size();
+		hash = hash_bytes(&size, sizeof(size), hash);
+		return hash_bytes(value.data(), value.size(), hash);
+	}
+
+	// Continues an FNV-1a hash over a string from glGetString
+	static std::uint64_t hash_gl_string(GLenum name, std::uint64_t hash)
+	{
+		const GLubyte* value = glGetString(name);
+		return hash_string(value ? reinterpret_cast<const char*>(value) : "", hash);
+	}
+
+	/*
+	Checks once whether the driver can save and load program binaries.  Some
+	drivers expose the extension but offer no formats
+	*/
+	bool program_cache::is_supported()
+	{
+		if (_supported == -1)
+		{
+			GLint formats = 0;
+			if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			_supported = formats > 0 ? 1 : 0;
+			if (!_supported)
+				std::clog << "Program binaries not supported.  Shaders will be compiled every run" << std::endl;
+		}
+		return _supported == 1;
+	}
+
+	// Gets the path of the file for a key
+	std::string program_cache::get_path(std::uint64_t key) const
+	{
+		std::ostringstream path;
+		path << _directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+		return path.str();
+	}
+
+	/*
+	Hashes the driver strings, then the type and source of each shader.  A
+	binary from one driver is never offered to another
+	*/
+	std::uint64_t program_cache::make_key(const std::vector<GLenum>& types, const std::vector<std::string>& sources) const
+	{
+		std::uint64_t hash = 14695981039346656037ull;
+		hash = hash_bytes(CACHE_MAGIC, sizeof(CACHE_MAGIC), hash);
+		hash = hash_gl_string(GL_VENDOR, hash);
+		hash = hash_gl_string(GL_RENDERER, hash);
+		hash = hash_gl_string(GL_VERSION, hash);
+		for (std::size_t i = 0; i < sources.size(); ++i)
+		{
+			hash = hash_bytes(&types[i], sizeof(GLenum), hash);
+			hash = hash_string(sources[i], hash);
+		}
+		return hash;
+	}
+
+	/*
+	Loads a cached binary.  A missing file is a normal miss.  A file the
+	driver rejects is left for save to replace
+	*/
+	bool program_cache::load(GLuint program, std::uint64_t key)
+	{
+		if (!is_enabled())
+			return false;
+
+		std::ifstream file(get_path(key), std::ios_base::in | std::ios_base::binary);
+		if (!file.is_open())
+		{
+			++_misses;
+			return false;
+		}
+
+		cache_header header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(cache_header));
+		if (!file || !std::equal(CACHE_MAGIC, CACHE_MAGIC + 4, header.magic) || header.key != key)
+		{
+			std::cerr << "Ignoring invalid program cache file " << get_path(key) << std::endl;
+			++_misses;
+			return false;
+		}
+		std::vector<char> binary(header.length);
+		file.read(binary.data(), header.length);
+		if (!file)
+		{
+			std::cerr << "Ignoring truncated program cache file " << get_path(key) << std::endl;
+			++_misses;
+			return false;
+		}
+
+		glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(header.length));
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		// A rejected binary raises no error beyond the link status, so clear
+		// anything the driver did raise rather than report it later
+		CHECK_GL_ERROR;
+		if (!linked)
+		{
+			std::clog << "Driver rejected cached program " << get_path(key) << ".  Building from source" << std::endl;
+			++_misses;
+			return false;
+		}
+		++_hits;
+		return true;
+	}
+
+	// Marks a program to be built from source so its binary can be saved
+	void program_cache::prepare(GLuint program)
+	{
+		if (is_enabled())
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	/*
+	Saves the binary of a linked program.  It is written to a temporary file
+	first, so a run stopped part way through never leaves a truncated entry
+	*/
+	bool program_cache::save(GLuint program, std::uint64_t key)
+	{
+		if (!is_enabled())
+			return false;
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return false;
+		std::vector<char> binary(length);
+		cache_header header;
+		std::copy(CACHE_MAGIC, CACHE_MAGIC + 4, header.magic);
+		header.key = key;
+		glGetProgramBinary(program, length, &length, &header.format, binary.data());
+		if (CHECK_GL_ERROR)
+			return false;
+		header.length = static_cast<std::uint32_t>(length);
+
+		// Create the directory.  Failing because it exists is fine
+#if defined(_WIN32)
+		_mkdir(_directory.c_str());
+#else
+		mkdir(_directory.c_str(), 0755);
+#endif
+
+		std::string path = get_path(key);
+		std::string temp = path + ".tmp";
+		{
+			std::ofstream file(temp, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+			if (!file.is_open())
+			{
+				std::cerr << "Could not write program cache file " << temp << std::endl;
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(cache_header));
+			file.write(binary.data(), header.length);
+			if (!file)
+			{
+				std::cerr << "Could not write program cache file " << temp << std::endl;
+				file.close();
+				std::remove(temp.c_str());
+				return false;
+			}
+		}
+		// rename will not replace a file on Windows
+		std::remove(path.c_str());
+		if (std::rename(temp.c_str(), path.c_str()) != 0)
+		{
+			std::cerr << "Could not write program cache file " << path << std::endl;
+			std::remove(temp.c_str());
+			return false;
+		}
+		return true;
+	}
+}
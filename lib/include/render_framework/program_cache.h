@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <GL\glew.h>
+
+namespace render_framework
+{
+	/*
+	Stores linked programs on disk so later runs can skip compiling and
+	linking shaders.  Programs are keyed by a hash of their shader sources and
+	the driver, so editing a shader or updating the driver gives a new key
+	rather than a stale binary.  The driver may still reject a binary it wrote
+	itself, in which case the program is built from source and the cache
+	entry replaced.
+
+	Needs OpenGL 4.1 or ARB_get_program_binary, and a driver offering at least
+	one binary format.  Otherwise every lookup misses and nothing is written.
+	*/
+	class program_cache
+	{
+	private:
+		// Directory the binaries are stored in.  Empty disables the cache
+		std::string _directory;
+		// Flag indicating the driver supports program binaries.  Checked on
+		// first use, as this needs a context
+		int _supported;
+		// Number of programs loaded from the cache
+		unsigned int _hits;
+		// Number of programs built from source
+		unsigned int _misses;
+
+		// Private constructor.  Class is a singleton
+		program_cache() : _directory("shader_cache"), _supported(-1), _hits(0), _misses(0) { }
+		// Private copy constructor
+		program_cache(const program_cache&);
+		// Private assignment operator
+		void operator=(const program_cache&);
+
+		// Checks if the driver can save and load program binaries
+		bool is_supported();
+		// Gets the path of the file for a key
+		std::string get_path(std::uint64_t key) const;
+	public:
+		// Gets the singleton instance
+		static program_cache& get_instance()
+		{
+			static program_cache instance;
+			return instance;
+		}
+
+		// Sets the directory the binaries are stored in, relative to the
+		// working directory.  An empty string disables the cache
+		void set_directory(const std::string& value) { _directory = value; }
+
+		// Gets the directory the binaries are stored in
+		const std::string& get_directory() const { return _directory; }
+
+		// Checks if the cache is in use
+		bool is_enabled() { return !_directory.empty() && is_supported(); }
+
+		// Gets the number of programs loaded from the cache
+		unsigned int get_hits() const { return _hits; }
+
+		// Gets the number of programs built from source
+		unsigned int get_misses() const { return _misses; }
+
+		// Makes a key from the types and sources of the shaders in a program.
+		// The sources must be complete, with any defines already added
+		std::uint64_t make_key(const std::vector<GLenum>& types, const std::vector<std::string>& sources) const;
+
+		// Loads a cached binary into program.  Returns true if the program is
+		// now linked, false if there is no entry or the driver rejected it
+		bool load(GLuint program, std::uint64_t key);
+
+		// Marks a program to be built from source so its binary can be saved.
+		// Must be called before linking
+		void prepare(GLuint program);
+
+		// Saves the binary of a linked program
+		bool save(GLuint program, std::uint64_t key);
+	};
+}
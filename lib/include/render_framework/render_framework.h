@@ -1,21 +1,35 @@
 #pragma once
 
 #include "camera.h"
+#include "command_list.h"
 #include "content_manager.h"
 #include "effect.h"
 #include "frame_buffer.h"
+#include "frame_arena.h"
+#include "frame_data.h"
+#include "frame_stats.h"
+#include "frame_timing.h"
+#include "frustum_culler.h"
 #include "geometry.h"
+#include "geometry_pool.h"
+#include "gl_debug.h"
+#include "job_system.h"
 #include "light.h"
 #include "material.h"
 #include "model.h"
 #include "post_process.h"
+#include "profiler.h"
+#include "program_cache.h"
 #include "render_framework.h"
+#include "render_queue.h"
 #include "mesh.h"
 #include "renderer.h"
 #include "scene.h"
 #include "skybox.h"
+#include "stream_buffer.h"
 #include "terrain.h"
 #include "texture.h"
+#include "transform_hierarchy.h"
 #include "util.h"
 
 #include <glm\glm.hpp>
@@ -17,17 +17,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		// Check if effect has uniform of given name
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(INT, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, INT, &value, sizeof(int));
 	}
 
 	template <>
@@ -35,16 +25,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(DOUBLE, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, DOUBLE, &value, sizeof(double));
 	}
 
 	template <>
@@ -52,16 +33,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(FLOAT, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, FLOAT, &value, sizeof(float));
 	}
 
 	template <>
@@ -69,16 +41,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(UNSIGNED_INT, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, UNSIGNED_INT, &value, sizeof(unsigned int));
 	}
 
 	template <>
@@ -86,16 +49,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(VEC2, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, VEC2, &value, sizeof(glm::vec2));
 	}
 
 	template <>
@@ -103,16 +57,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(VEC3, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, VEC3, &value, sizeof(glm::vec3));
 	}
 
 	template <>
@@ -120,16 +65,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(VEC4, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, VEC4, &value, sizeof(glm::vec4));
 	}
 
 	template <>
@@ -137,16 +73,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(MAT2, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, MAT2, &value, sizeof(glm::mat2));
 	}
 
 	template <>
@@ -154,16 +81,7 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(MAT3, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, MAT3, &value, sizeof(glm::mat3));
 	}
 
 	template <>
@@ -171,47 +89,20 @@ namespace render_framework
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->value_map[name] = std::make_pair(MAT4, value);
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_value(*eff, name, MAT4, &value, sizeof(glm::mat4));
 	}
 
 	bool render_pass::set_texture(const std::string& name, std::shared_ptr<texture> value)
 	{
 		if (uniform_values == nullptr)
 			uniform_values = std::make_shared<effect_values>();
-		if (eff->uniforms.find(name) != eff->uniforms.end())
-		{
-			uniform_values->texture_map[name] = value;
-			return true;
-		}
-		else
-		{
-			std::cerr << "Uniform " << name << " does not exist" << std::endl;
-			return false;
-		}
+		return uniform_values->set_texture(*eff, name, value);
 	}
 
     bool render_pass::set_texture(const std::string& name, std::shared_ptr<cube_map> value)
     {
         if (uniform_values == nullptr)
             uniform_values = std::make_shared<effect_values>();
-        if (eff->uniforms.find(name) != eff->uniforms.end())
-        {
-            uniform_values->cubemap_map[name] = value;
-            return true;
-        }
-        else
-        {
-            std::cerr << "Uniform " << name << " does not exist" << std::endl;
-            return false;
-        }
+        return uniform_values->set_texture(*eff, name, value);
     }
 }
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "render_queue.h"
+#include "renderer.h"
+#include "camera.h"
+#include "mesh.h"
+#include "geometry.h"
+#include "geometry_pool.h"
+#include "material.h"
+#include "effect.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace render_framework
+{
+	/*
+	Builds a sort key from the layer, program, material, vertex array and view
+	depth of a draw.  Depth is stored logarithmically so that the large ranges
+	found in a scene still sort sensibly
+	*/
+	std::uint64_t render_queue::make_key(RENDER_LAYER layer, unsigned int program, unsigned int material, unsigned int vao, float depth)
+	{
+		// Quantise the depth.  Each doubling of distance gets 2^14 steps
+		float log_depth = std::log2(1.0f + std::max(depth, 0.0f)) * 16384.0f;
+		std::uint64_t d = static_cast<std::uint64_t>(std::min(log_depth, static_cast<float>(0xFFFFF)));
+
+		// Layer always occupies the top 4 bits
+		std::uint64_t key = static_cast<std::uint64_t>(layer & 0xF) << 60;
+		// Transparent draws must be blended back to front, so depth (inverted)
+		// takes priority over state.  The material is left out, as its bits
+		// come from an address.  Draws at the same depth and with the same
+		// program then keep the order they were queued in, since the sort is
+		// stable
+		if (layer == LAYER_TRANSPARENT)
+			return key | ((0xFFFFF - d) << 40) | (static_cast<std::uint64_t>(program & 0xFFF) << 28);
+
+		// Otherwise sort by state, and then front to back
+		key |= static_cast<std::uint64_t>(program & 0xFFF) << 48;
+		key |= static_cast<std::uint64_t>(material & 0xFFFF) << 32;
+		key |= static_cast<std::uint64_t>(vao & 0xFFF) << 20;
+		key |= d;
+		return key;
+	}
+
+	/*
+	Clears the queue ready for a new frame.  The storage is kept so that the
+	queue does not need to allocate once it has warmed up
+	*/
+	void render_queue::clear()
+	{
+		_records.clear();
+		_keys.clear();
+		_culler.clear();
+		_sorted = true;
+	}
+
+	/*
+	Adds a mesh to the queue.  The model matrix and view depth are calculated
+	here so the renderer does not need to recalculate them
+	*/
+	void render_queue::push(const mesh& value, RENDER_LAYER layer)
+	{
+		// Ignore meshes which cannot be drawn
+		if (value.geom == nullptr)
+			return;
+
+		render_record record;
+		record.value = &value;
+		record.model = value.get_transform_matrix();
+
+		// Calculate depth of the mesh in view space
+		auto& cam = renderer::get_instance().get_camera();
+		glm::mat4 view = cam ? cam->get_view() : renderer::get_instance().get_view();
+		float depth = -(view * record.model[3]).z;
+
+		// Get state identifiers.  The material identifier only needs to group
+		// draws of the same material, so the address is enough.  Instances
+		// use the address of their base, so they are drawn together and
+		// share its buffer and textures
+		unsigned int program = 0;
+		unsigned int mat = 0;
+		if (value.mat)
+		{
+			if (value.mat->effect)
+				program = value.mat->effect->program;
+			const material* group = value.mat->base ? value.mat->base.get() : value.mat.get();
+			mat = static_cast<unsigned int>(reinterpret_cast<std::uintptr_t>(group) >> 4);
+		}
+
+		// Pooled geometry shares the vertex array of its pool
+		unsigned int vao = value.geom->pool ? value.geom->pool->get_vertex_array() : value.geom->vertex_array_object;
+
+		record.key = make_key(layer, program, mat, vao, depth);
+		// Bounding sphere index matches the record index
+		_culler.add(*value.geom, record.model);
+		_keys.push_back(std::make_pair(record.key, static_cast<std::uint32_t>(_records.size())));
+		_records.push_back(record);
+		_sorted = false;
+	}
+
+	/*
+	Tests the bounding sphere of every queued draw against the frustum and
+	rebuilds the key list from the draws that survive.  Records are left in
+	place so that indices held by the remaining keys stay valid
+	*/
+	void render_queue::cull(const glm::mat4& view_projection, bool test_far)
+	{
+		if (_records.empty())
+			return;
+
+		_culler.set_frustum(view_projection, test_far);
+		_culler.cull();
+
+		// Visible indices come back in record order
+		_keys.clear();
+		for (auto index : _culler.get_visible())
+			_keys.push_back(std::make_pair(_records[index].key, index));
+		_sorted = false;
+	}
+
+	/*
+	Sorts the queued keys using an LSD radix sort over the 8 bytes of the key.
+	Passes where every key shares the same byte are skipped
+	*/
+	void render_queue::sort()
+	{
+		if (_sorted || _keys.empty())
+			return;
+
+		_scratch.resize(_keys.size());
+		for (unsigned int shift = 0; shift < 64; shift += 8)
+		{
+			// Build histogram of this byte
+			std::size_t counts[256] = { 0 };
+			for (auto& k : _keys)
+				++counts[(k.first >> shift) & 0xFF];
+
+			// If every key has the same byte, this pass changes nothing
+			if (counts[(_keys[0].first >> shift) & 0xFF] == _keys.size())
+				continue;
+
+			// Convert counts into offsets
+			std::size_t offset = 0;
+			for (auto& c : counts)
+			{
+				auto count = c;
+				c = offset;
+				offset += count;
+			}
+
+			// Scatter into scratch and swap
+			for (auto& k : _keys)
+				_scratch[counts[(k.first >> shift) & 0xFF]++] = k;
+			_keys.swap(_scratch);
+		}
+
+		_sorted = true;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <glm\glm.hpp>
+#include "frustum_culler.h"
+
+namespace render_framework
+{
+	// Forward declarations
+	struct mesh;
+
+	/*
+	Layers that a draw can be submitted to.  Layers are drawn in order, so
+	anything in the background is drawn before opaque objects, etc.
+	*/
+	enum RENDER_LAYER
+	{
+		LAYER_BACKGROUND,
+		LAYER_OPAQUE,
+		LAYER_TRANSPARENT,
+		LAYER_OVERLAY
+	};
+
+	/*
+	A single draw held in a render queue.  The key packs the state used by the
+	draw so that sorting the keys groups draws sharing the same state together
+	*/
+	struct render_record
+	{
+		// The packed sort key for the draw
+		std::uint64_t key;
+		// The mesh to be drawn.  Borrowed from the caller of push
+		const mesh* value;
+		// The model matrix of the mesh, calculated when the draw is queued
+		glm::mat4 model;
+	};
+
+	/*
+	Collects draws for a frame, sorts them by their packed state key and hands
+	them to the renderer in order.  Sorting means that the renderer only has to
+	re-bind the state that has actually changed between two draws.  Storage is
+	kept between frames, so once warmed up queuing a frame does not allocate.
+
+	Key layout (most significant bit first):
+		layer    - 4 bits
+		program  - 12 bits
+		material - 16 bits
+		vao      - 12 bits
+		depth    - 20 bits (front to back)
+	Draws in the transparent layer instead use the bits below the layer for an
+	inverted depth, so they are drawn back to front, followed by the program.
+	Transparent draws at the same depth are drawn in the order they were
+	queued.
+	*/
+	class render_queue
+	{
+	private:
+		// The draws queued this frame
+		std::vector<render_record> _records;
+		// Sort keys paired with the index of their record
+		std::vector<std::pair<std::uint64_t, std::uint32_t>> _keys;
+		// Scratch space used by the radix sort
+		std::vector<std::pair<std::uint64_t, std::uint32_t>> _scratch;
+		// World space bounding spheres of the records, in record order
+		frustum_culler _culler;
+		// Flag indicating if the keys have been sorted since the last push
+		bool _sorted;
+	public:
+		// Creates an empty render queue
+		render_queue() : _sorted(true) { }
+
+		// Removes all the queued draws.  Storage is kept for the next frame
+		void clear();
+
+		// Adds a mesh to the queue in the given layer.  The mesh is borrowed,
+		// so must outlive the render of the queue
+		void push(const mesh& value, RENDER_LAYER layer = LAYER_OPAQUE);
+
+		// Removes draws whose bounds are outside the frustum of the given
+		// view-projection matrix.  Should be called before sort
+		void cull(const glm::mat4& view_projection, bool test_far = true);
+
+		// Sorts the queued draws by their key
+		void sort();
+
+		// Gets the number of queued draws
+		std::size_t size() const { return _keys.size(); }
+
+		// Gets the draw at the given position in sorted order
+		const render_record& get_record(std::size_t index) const { return _records[_keys[index].second]; }
+
+		// Builds a sort key from its component parts
+		static std::uint64_t make_key(RENDER_LAYER layer, unsigned int program, unsigned int material, unsigned int vao, float depth);
+	};
+}
@@ -4,13 +4,28 @@
 #pragma comment(lib, "GLEW32")
 #pragma comment(lib, "OpenGL32")
 
+// Headless rendering uses EGL when RENDER_FRAMEWORK_EGL is defined, such as
+// with Mesa on display-less Linux machines.  GLEW must then be built with
+// GLEW_EGL.  Otherwise a hidden GLFW window is used
+#if defined(RENDER_FRAMEWORK_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "libEGL")
+#endif
+#endif
+
 #include <ctime>
+#include <cstring>
+#include <algorithm>
 #include <glm\gtc\type_ptr.hpp>
 
 #include "content_manager.h"
 #include "effect.h"
 #include "frame_buffer.h"
+#include "gl_debug.h"
 #include "post_process.h"
+#include "program_cache.h"
 #include "geometry.h"
 #include "transform.h"
 #include "material.h"
@@ -19,6 +34,11 @@
 #include "texture.h"
 #include "skybox.h"
 #include "camera.h"
+#include "render_queue.h"
+#include "geometry_pool.h"
+#include "command_list.h"
+#include "job_system.h"
+#include "profiler.h"
 #include "util.h"
 
 namespace render_framework
@@ -40,9 +60,10 @@ namespace render_framework
 	}
 
 	/*
-	Initialises the renderer
+	Creates the window.  In debug the window is 800 x 600, otherwise it is the
+	size of the desktop
 	*/
-	bool renderer::initialise()
+	bool renderer::create_window()
 	{
 		// Initialise GLFW
 		if (!glfwInit())
@@ -56,6 +77,11 @@ namespace render_framework
 		// Now get its current video mode
 		const GLFWvidmode* vidmode = glfwGetVideoMode(monitor);
 
+#if defined(RENDER_FRAMEWORK_GL_DEBUG)
+		// Ask for a debug context so the driver reports problems in full
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+
 		// If we are in debug mode, then set window dimensions to 800 x 600
 #if defined(DEBUG) | defined(_DEBUG)
 		_window = glfwCreateWindow(800, 600, _caption.c_str(), nullptr, nullptr);
@@ -67,8 +93,8 @@ namespace render_framework
 #else
 		// If we are in release mode, then set window dimensions to desktop dimensions
 		_window = glfwCreateWindow(vidmode->width, vidmode->height, _caption.c_str(), nullptr, nullptr);
-		_width = video_mode.Width;
-		_height = video_mode.Height;
+		_width = vidmode->width;
+		_height = vidmode->height;
 #endif
 		// Check if window was created
 		if (_window == nullptr)
@@ -80,6 +106,137 @@ namespace render_framework
 
 		// Make the window's context current
 		glfwMakeContextCurrent(_window);
+		return true;
+	}
+
+	/*
+	Creates an offscreen context of the size given to set_headless.  With EGL
+	the Mesa surfaceless platform is preferred, as it needs no display server
+	at all, falling back to the default display.  Rendering goes to a pbuffer
+	surface, which acts as the screen frame buffer
+	*/
+	bool renderer::create_offscreen_context()
+	{
+#if defined(RENDER_FRAMEWORK_EGL)
+		EGLDisplay display = EGL_NO_DISPLAY;
+		auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (get_platform_display != nullptr)
+			display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display == EGL_NO_DISPLAY)
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		EGLint major, minor;
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		{
+			std::cerr << "Error initialising EGL" << std::endl;
+			return false;
+		}
+		_egl_display = display;
+		std::clog << "EGL Version: " << major << "." << minor << std::endl;
+
+		// Choose a config matching a normal window's frame buffer
+		const EGLint config_attributes[] =
+		{
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8,
+			EGL_GREEN_SIZE, 8,
+			EGL_BLUE_SIZE, 8,
+			EGL_ALPHA_SIZE, 8,
+			EGL_DEPTH_SIZE, 24,
+			EGL_STENCIL_SIZE, 8,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint config_count = 0;
+		if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count) || config_count == 0)
+		{
+			std::cerr << "Error - no EGL config supports offscreen OpenGL rendering" << std::endl;
+			return false;
+		}
+
+		const EGLint surface_attributes[] =
+		{
+			EGL_WIDTH, static_cast<EGLint>(_width),
+			EGL_HEIGHT, static_cast<EGLint>(_height),
+			EGL_NONE
+		};
+		_egl_surface = eglCreatePbufferSurface(display, config, surface_attributes);
+		if (_egl_surface == EGL_NO_SURFACE)
+		{
+			std::cerr << "Error creating " << _width << " x " << _height << " pbuffer surface" << std::endl;
+			return false;
+		}
+
+		// Desktop OpenGL, with the default compatibility profile the fixed
+		// function paths need
+		eglBindAPI(EGL_OPENGL_API);
+		_egl_context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+		if (_egl_context == EGL_NO_CONTEXT)
+		{
+			std::cerr << "Error creating EGL context" << std::endl;
+			return false;
+		}
+		if (!eglMakeCurrent(display, _egl_surface, _egl_surface, _egl_context))
+		{
+			std::cerr << "Error making EGL context current" << std::endl;
+			return false;
+		}
+		return true;
+#else
+		// Without EGL, use a window that is never shown
+		if (!glfwInit())
+		{
+			std::cerr << "Error initialising GLFW" << std::endl;
+			return false;
+		}
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+#if defined(RENDER_FRAMEWORK_GL_DEBUG)
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+		_window = glfwCreateWindow(_width, _height, _caption.c_str(), nullptr, nullptr);
+		if (_window == nullptr)
+		{
+			std::cerr << "Error creating hidden window" << std::endl;
+			glfwTerminate();
+			return false;
+		}
+		glfwMakeContextCurrent(_window);
+		return true;
+#endif
+	}
+
+	/*
+	Gets the address of an OpenGL function from whichever of EGL and GLFW
+	created the context
+	*/
+	void* renderer::get_proc_address(const char* name) const
+	{
+#if defined(RENDER_FRAMEWORK_EGL)
+		if (_egl_display != nullptr)
+			return reinterpret_cast<void*>(eglGetProcAddress(name));
+#endif
+		return reinterpret_cast<void*>(glfwGetProcAddress(name));
+	}
+
+	/*
+	Initialises the renderer
+	*/
+	bool renderer::initialise()
+	{
+		// Create a window, or an offscreen context if headless
+		if (_headless)
+		{
+			if (!create_offscreen_context())
+				return false;
+			std::clog << "Rendering headless at " << _width << " x " << _height;
+			if (_frame_limit > 0)
+				std::clog << " for " << _frame_limit << " frames";
+			std::clog << std::endl;
+		}
+		else if (!create_window())
+			return false;
+		_frame_count = 0;
+		_frame_timing.clear();
 
 		// Print OpenGL info
 		print_GL_info();
@@ -92,6 +249,12 @@ namespace render_framework
 			return false;
 		}
 
+#if defined(RENDER_FRAMEWORK_GL_DEBUG)
+		// Report OpenGL errors through the debug callback where supported,
+		// so CHECK_GL_ERROR no longer waits on glGetError
+		gl_debug::get_instance().initialise();
+#endif
+
         // Enable textures
         glEnable(GL_TEXTURE_1D);
         glEnable(GL_TEXTURE_2D);
@@ -157,6 +320,45 @@ namespace render_framework
 		if (CHECK_GL_ERROR)
 			std::cerr << "Error enabling point sizes in shaders" << std::endl;
 
+		// Create the frame uniform buffer and bind it to its reserved binding
+		// point.  It stays bound there for the life of the renderer
+		glGenBuffers(1, &_frame_uniforms);
+		glBindBuffer(GL_UNIFORM_BUFFER, _frame_uniforms);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(frame_data), nullptr, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, _frame_uniforms);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		gl_debug::label(GL_BUFFER, _frame_uniforms, "frame uniforms");
+
+		if (CHECK_GL_ERROR)
+			std::cerr << "Error creating frame uniform buffer" << std::endl;
+
+		// Allocate the arenas for transient per frame data
+		if (!_frame_memory.initialise())
+			return false;
+
+		// Create the ring buffer for streaming data to the GPU
+		if (!_stream.initialise())
+			std::cerr << "Error creating stream buffer.  Updates will be uploaded directly" << std::endl;
+
+		// Create the ring of model matrices read by single draws
+		_model_capacity = MODEL_RING_SLOTS;
+		_model_slot = 0;
+		glGenBuffers(1, &_model_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, _model_buffer);
+		glBufferData(GL_ARRAY_BUFFER, _model_capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		gl_debug::label(GL_BUFFER, _model_buffer, "model ring");
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error creating model ring" << std::endl;
+			return false;
+		}
+
+		// Start the job threads, and create a command list for each to record into
+		if (!job_system::get_instance().initialise())
+			return false;
+		_command_lists.resize(job_system::get_instance().get_thread_count());
+
 		// Set running to true
 		_running = true;
 
@@ -226,10 +428,70 @@ namespace render_framework
 		// Set running to false
 		_running = false;
 
+		// Report how much of the frame arenas was used, so they can be sized
+		std::clog << "Frame arena high water: " << _frame_memory.get_high_water() << " bytes" << std::endl;
+		std::clog << "Program cache: " << program_cache::get_instance().get_hits() << " hits, "
+				  << program_cache::get_instance().get_misses() << " misses" << std::endl;
+
+		// Finish any profile capture while the context is current
+		profiler::get_instance().shutdown();
+		stop_stats_csv();
+
+		// Delete the stream buffer and model ring
+		_stream.shutdown();
+		if (_model_buffer)
+			glDeleteBuffers(1, &_model_buffer);
+		_model_buffer = 0;
+
+		// Delete the frame uniform buffer
+		if (_frame_uniforms)
+			glDeleteBuffers(1, &_frame_uniforms);
+		_frame_uniforms = 0;
+
+		// Remove the debug callback before the context goes
+		gl_debug::get_instance().shutdown();
+
+#if defined(RENDER_FRAMEWORK_EGL)
+		// Destroy the offscreen context
+		if (_egl_display != nullptr)
+		{
+			eglMakeCurrent(_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (_egl_context != nullptr)
+				eglDestroyContext(_egl_display, _egl_context);
+			if (_egl_surface != nullptr)
+				eglDestroySurface(_egl_display, _egl_surface);
+			eglTerminate(_egl_display);
+			_egl_display = _egl_surface = _egl_context = nullptr;
+			return;
+		}
+#endif
+
 		// Terminate GLFW
 		glfwTerminate();
 	}
 
+	/*
+	Checks if escape is pressed or the window closed.  Headless renders have
+	no input, and only stop when the frame limit is reached
+	*/
+	bool renderer::close_requested()
+	{
+		if (_headless)
+			return false;
+		return glfwGetKey(_window, GLFW_KEY_ESCAPE) || glfwWindowShouldClose(_window);
+	}
+
+	/*
+	Gets the time passed to effects.  Headless renders advance a fixed 1/60 s
+	each frame, so batch renders are the same every run
+	*/
+	double renderer::get_time() const
+	{
+		if (_headless)
+			return _frame_count / 60.0;
+		return glfwGetTime();
+	}
+
 	/*
 	Clears the screen
 	*/
@@ -253,15 +515,74 @@ namespace render_framework
 			return false;
 
 		// Check if escape is pressed or window closed.  If so, set running to false and return
-		if (glfwGetKey(_window, GLFW_KEY_ESCAPE) || glfwWindowShouldClose(_window))
+		if (close_requested())
 		{
 			_running = false;
 			return false;
 		}
 
+		// State may have been changed outside the renderer since the last
+		// render (e.g. loading content), so forget what we know about it
+		_state.invalidate();
+
 		// Clear the screen
 		clear();
 
+		// begin_render is called for each post process pass.  The frame
+		// uniforms are only uploaded on the first call of a frame, so this
+		// is also where the next frame arena and stream region are started
+		if (!_frame_uploaded)
+		{
+			_frame_stats.reset();
+			_state.reset_counters();
+			_frame_memory.begin_frame();
+			// Upload lights and materials changed since the last frame
+			if (!_stream.flush())
+				std::cerr << "Error flushing stream buffer" << std::endl;
+		}
+
+		// Upload the values shared by every draw this frame
+		return upload_frame_data();
+	}
+
+	/*
+	Uploads the frame uniform block.  begin_render is called for each post
+	process pass, so the upload only happens once between end_render calls
+	*/
+	bool renderer::upload_frame_data()
+	{
+		if (_frame_uploaded)
+			return true;
+
+		// Use the camera if we have one, otherwise the bound view and projection
+		if (_camera != nullptr)
+		{
+			_frame_data.view = _camera->get_view();
+			_frame_data.projection = _camera->get_projection();
+			_frame_data.eye_position = _camera->get_position();
+		}
+		else
+		{
+			_frame_data.view = _view;
+			_frame_data.projection = _projection;
+			_frame_data.eye_position = glm::vec3(glm::inverse(_view)[3]);
+		}
+		_frame_data.view_projection = _frame_data.projection * _frame_data.view;
+		_frame_data.time = static_cast<float>(get_time());
+		// Without a sun, the default light is used
+		_frame_data.sun = _sun != nullptr ? _sun->data : directional_light_data();
+
+		glBindBuffer(GL_UNIFORM_BUFFER, _frame_uniforms);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame_data), &_frame_data);
+		_frame_stats.bytes_uploaded += sizeof(frame_data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error uploading frame uniform buffer" << std::endl;
+			return false;
+		}
+
+		_frame_uploaded = true;
 		return true;
 	}
 
@@ -275,11 +596,55 @@ namespace render_framework
 			return false;
 
 		// Swap the buffers
-		swap_buffers();
+		{
+			PROFILE_GPU_ZONE("swap_buffers");
+			swap_buffers();
+		}
+		profiler::get_instance().end_frame();
+		gl_debug::get_instance().end_frame();
+
+		// Finish the frame counters and write them out if asked
+		_frame_stats.state_changes = _state.get_issued();
+		_frame_stats.state_changes_elided = _state.get_elided();
+		if (_stats_file.is_open())
+			_frame_stats.write_csv(_stats_file, _frame_count);
+
+		// The next begin_render starts a new frame
+		_frame_uploaded = false;
+
+		// Time the frame against the end of the last one
+		auto now = std::chrono::steady_clock::now();
+		if (_frame_count > 0)
+			_frame_timing.add(std::chrono::duration<double>(now - _last_frame).count());
+		_last_frame = now;
+
+		// Stop once a headless render has produced all its frames
+		++_frame_count;
+		if (_frame_limit > 0 && _frame_count >= _frame_limit)
+			_running = false;
 
-		// Poll events
-		glfwPollEvents();
+		// Poll events.  Headless renders have no input
+		if (!_headless)
+			glfwPollEvents();
+
+		return true;
+	}
 
+	/*
+	Opens a CSV file for the frame counters and writes the header.  A row is
+	added by each end_render until stop_stats_csv is called
+	*/
+	bool renderer::start_stats_csv(const std::string& filename)
+	{
+		_stats_file.close();
+		_stats_file.clear();
+		_stats_file.open(filename.c_str(), std::ios::out | std::ios::trunc);
+		if (!_stats_file.is_open())
+		{
+			std::cerr << "Error - could not open frame statistics file " << filename << std::endl;
+			return false;
+		}
+		frame_stats::write_csv_header(_stats_file);
 		return true;
 	}
 
@@ -303,12 +668,15 @@ namespace render_framework
 		}
 
 		// Check if escape is pressed or window closed.  If so, set running to false and return
-		if (glfwGetKey(_window, GLFW_KEY_ESCAPE) || glfwWindowShouldClose(_window))
+		if (close_requested())
 		{
 			_running = false;
 			return false;
 		}
 
+		// Forget any state changed outside the renderer
+		_state.invalidate();
+
 		// Clear the depth buffer
 		glClear(GL_DEPTH_BUFFER_BIT);
 
@@ -318,7 +686,7 @@ namespace render_framework
         _shadow_map->projection_matrix = glm::perspective(glm::degrees(glm::half_pi<float>()), static_cast<float>(_width) / static_cast<float>(_height), 1.0f, 1000.0f);
 
 		// Enable front face culling
-		glCullFace(GL_FRONT);
+		_state.set_cull_mode(GL_FRONT);
 
 		return !CHECK_GL_ERROR;
 	}
@@ -333,6 +701,13 @@ namespace render_framework
 			return;
 
 		// Swap the buffers
+#if defined(RENDER_FRAMEWORK_EGL)
+		if (_egl_display != nullptr)
+		{
+			eglSwapBuffers(_egl_display, _egl_surface);
+			return;
+		}
+#endif
 		glfwSwapBuffers(_window);
 	}
 
@@ -340,12 +715,14 @@ namespace render_framework
     Binds an effect to the renderer
 	*/
 	template <>
-	bool renderer::bind(std::shared_ptr<effect> value)
+	bool renderer::bind(const std::shared_ptr<effect>& value)
 	{
-        // Set the effect on the rendere
-		_effect = value;
-        // Use the program
-		glUseProgram(value->program);
+        // Set the effect on the rendere.  Only copy the pointer if it has
+        // changed to avoid reference counting every draw
+		if (_effect != value)
+			_effect = value;
+        // Use the program.  Skipped if already in use
+		_state.use_program(value->program);
         // Return error check
 		return (!CHECK_GL_ERROR);
 	}
@@ -354,10 +731,10 @@ namespace render_framework
     Binds a framebuffer for use on the renderer
     */
 	template <>
-	bool renderer::bind(std::shared_ptr<frame_buffer> value)
+	bool renderer::bind(const std::shared_ptr<frame_buffer>& value)
 	{
         // Bind the framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, value->buffer);
+		_state.bind_frame_buffer(value->buffer);
         // Return error check
 		return (!CHECK_GL_ERROR);
 	}
@@ -366,10 +743,10 @@ namespace render_framework
     Binds a depth buffer (framebuffer) for use on the renderer
     */
 	template <>
-	bool renderer::bind(std::shared_ptr<depth_buffer> value)
+	bool renderer::bind(const std::shared_ptr<depth_buffer>& value)
 	{
         // Bind the framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, value->buffer);
+		_state.bind_frame_buffer(value->buffer);
         // Return error check
 		return (!CHECK_GL_ERROR);
 	}
@@ -378,7 +755,7 @@ namespace render_framework
     Binds a shadow map for use on the renderer
     */
 	template <>
-	bool renderer::bind(std::shared_ptr<shadow_map> value)
+	bool renderer::bind(const std::shared_ptr<shadow_map>& value)
 	{
 		// Set the shadow map
 		_shadow_map = value;
@@ -387,7 +764,7 @@ namespace render_framework
 	}
 
 	template <>
-	bool renderer::bind(std::shared_ptr<post_process> value)
+	bool renderer::bind(const std::shared_ptr<post_process>& value)
 	{
         // Bind the first framebuffer
         return bind(value->passes[0]->buffer);
@@ -397,12 +774,10 @@ namespace render_framework
     Binds a texture for us in an effect
     */
 	template <>
-	bool renderer::bind_texture(std::shared_ptr<texture> value, unsigned int index)
+	bool renderer::bind_texture(const std::shared_ptr<texture>& value, unsigned int index)
 	{
-        // Set the active texture index
-		glActiveTexture(GL_TEXTURE0 + index);
-        // Bind the type of texture
-		glBindTexture(value->type, value->image);
+        // Bind the type of texture at the index
+		_state.bind_texture(index, value->type, value->image);
         // Return error check
 		return (!CHECK_GL_ERROR);
 	}
@@ -411,12 +786,10 @@ namespace render_framework
     Binds a cube map texture in an effect
     */
 	template <>
-	bool renderer::bind_texture(std::shared_ptr<cube_map> value, unsigned int index)
+	bool renderer::bind_texture(const std::shared_ptr<cube_map>& value, unsigned int index)
 	{
-        // Set the active texture index
-		glActiveTexture(GL_TEXTURE0 + index);
-        // Bind the type of texture
-		glBindTexture(GL_TEXTURE_CUBE_MAP, value->image);
+        // Bind the type of texture at the index
+		_state.bind_texture(index, GL_TEXTURE_CUBE_MAP, value->image);
         // Return error check
         return (!CHECK_GL_ERROR);
 	}
@@ -438,7 +811,7 @@ namespace render_framework
 		}
 
 		// Enable back face culling
-		glCullFace(GL_BACK);
+		_state.set_cull_mode(GL_BACK);
 
 		return !CHECK_GL_ERROR;
 	}
@@ -470,6 +843,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniform1i(found->second, value);
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -499,6 +873,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniform1d(found->second, value);
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -528,6 +903,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniform1f(found->second, value);
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -557,6 +933,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniform1ui(found->second, value);
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -586,6 +963,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniform2fv(found->second, 1, glm::value_ptr(value));
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -615,6 +993,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniform3fv(found->second, 1, glm::value_ptr(value));
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -644,6 +1023,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniform4fv(found->second, 1, glm::value_ptr(value));
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -673,6 +1053,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniformMatrix2fv(found->second, 1, GL_FALSE, glm::value_ptr(value));
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -702,6 +1083,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniformMatrix3fv(found->second, 1, GL_FALSE, glm::value_ptr(value));
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -731,6 +1113,7 @@ namespace render_framework
 		{
             // Uniform of name does exist.  Set value
 			glUniformMatrix4fv(found->second, 1, GL_FALSE, glm::value_ptr(value));
+			++_frame_stats.uniform_calls;
             // Return error check
 			return (!CHECK_GL_ERROR);
 		}
@@ -739,61 +1122,15 @@ namespace render_framework
 	template <>
 	bool renderer::set_uniform(const std::string& name, const material& value)
 	{
-		// Check that effect is bound
-        if (_effect == nullptr)
-        {
-            // Display error
-            std::cerr << "Cannot set uniform - no effect bound with renderer" << std::endl;
-            // Return false
-            return false;
-        }
-		else
-		{
-			auto found = _effect->uniforms.find(name + ".emissive");
-			if (found != _effect->uniforms.end())
-				glUniform4fv(found->second, 1, glm::value_ptr(value.data.emissive));
-			found = _effect->uniforms.find(name + ".diffuse_reflection");
-			if (found != _effect->uniforms.end())
-				glUniform4fv(found->second, 1, glm::value_ptr(value.data.diffuse_reflection));
-			found = _effect->uniforms.find(name + ".specular_reflection");
-			if (found != _effect->uniforms.end())
-				glUniform4fv(found->second, 1, glm::value_ptr(value.data.specular_reflection));
-			found = _effect->uniforms.find(name + ".shininess");
-			if (found != _effect->uniforms.end())
-				glUniform1f(found->second, value.data.shininess);
-			return true;
-		}
+		// Hash the name once and set the members using the handle
+		return set_uniform(uniform_handle(name), value);
 	}
 
 	template <>
 	bool renderer::set_uniform(const std::string& name, const directional_light& value)
 	{
-        // Check that effect is bound
-        if (_effect == nullptr)
-        {
-            // Display error
-            std::cerr << "Cannot set uniform - no effect bound with renderer" << std::endl;
-            // Return false
-            return false;
-        }
-		// Check if buffer has been created or not
-		if (value.buffer)
-		{
-			// TODO : Bind buffer
-		}
-		else
-		{
-			auto found = _effect->uniforms.find(name + ".ambient_intensity");
-			if (found != _effect->uniforms.end())
-				glUniform4fv(found->second, 1, glm::value_ptr(value.data.ambient_intensity));
-			found = _effect->uniforms.find(name + ".colour");
-			if (found != _effect->uniforms.end())
-				glUniform4fv(found->second, 1, glm::value_ptr(value.data.colour));
-			found = _effect->uniforms.find(name + ".direction");
-			if (found != _effect->uniforms.end())
-				glUniform3fv(found->second, 1, glm::value_ptr(value.data.direction));
-		}
-		return true;
+		// Hash the name once and set the members using the handle
+		return set_uniform(uniform_handle(name), value);
 	}
 
 	template <>
@@ -826,163 +1163,571 @@ namespace render_framework
 		else
 		{
 			glBindBufferRange(GL_UNIFORM_BUFFER, found->second, buffer, 0, size);
+			++_frame_stats.uniform_block_binds;
 			return true;
 		}
 	}
 
-	/*
-	Helper function to set model-view and projection matrices
-	*/
-	void set_mvp(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+	bool renderer::set_uniform_block(const uniform_handle& handle, unsigned int buffer, int size)
 	{
-		// Set the projection matrix
-		glMatrixMode(GL_PROJECTION);
-		glLoadMatrixf(glm::value_ptr(projection));
-
-		// Set the model view matrix
-		glm::mat4 modelView = view * model;
-		glMatrixMode(GL_MODELVIEW);
-		glLoadMatrixf(glm::value_ptr(modelView));
+		// Check that effect is bound
+		if (_effect == nullptr)
+		{
+			// Display error
+			std::cerr << "Cannot set uniform - no effect bound with renderer" << std::endl;
+			// Return false
+			return false;
+		}
+		GLint binding = _effect->get_block_binding(handle);
+		if (binding == -1)
+			return false;
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, 0, size);
+		++_frame_stats.uniform_block_binds;
+		return true;
 	}
 
 	/*
-	Helper function to set model-view and projection matrices on a effect
+	Gets the location of a uniform in the currently bound effect from a handle
 	*/
-	void set_mvp(std::shared_ptr<effect> eff, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+	bool renderer::find_uniform(const uniform_handle& handle, GLint& location)
 	{
-		// Try and set the model matrix
-        if (eff->uniforms.find("model") != eff->uniforms.end())
-		    renderer::get_instance().set_uniform("model", model);
-		// Try and set the view matrix
-        if (eff->uniforms.find("view") != eff->uniforms.end())
-		    renderer::get_instance().set_uniform("view", view);
-		// Try and set the projection matrix
-        if (eff->uniforms.find("projection") != eff->uniforms.end())
-		    renderer::get_instance().set_uniform("projection", projection);
-		// Create model-view matrix and try and set
-        if (eff->uniforms.find("MV") != eff->uniforms.end())
-        {
-		    glm::mat4 modelView = view * model;
-		    renderer::get_instance().set_uniform("MV", modelView);
-        }
-		// Create model-view-projection matrix and try and set
-        if (eff->uniforms.find("MVP") != eff->uniforms.end())
-        {
-		    glm::mat4 modelViewProjection = projection * view * model;
-		    renderer::get_instance().set_uniform("MVP", modelViewProjection);
-        }
+		// Check that effect is bound
+		if (_effect == nullptr)
+		{
+			// Display error
+			std::cerr << "Cannot set uniform - no effect bound with renderer" << std::endl;
+			// Return false
+			return false;
+		}
+		// Try and find the uniform on the effect
+		location = _effect->get_location(handle);
+		if (location == -1)
+		{
+			// Uniform does not exist in bound effect.  Display error
+			std::cerr << "Uniform with hash " << handle.hash << " does not exist in current effect" << std::endl;
+			return false;
+		}
+		return true;
 	}
 
-    bool validate_program(std::shared_ptr<effect> value)
-    {
-        glValidateProgram(value->program);
-        GLint status;
-        glGetProgramiv(value->program, GL_VALIDATE_STATUS, &status);
-        if (!status)
-        {
-            GLsizei length;
-            glGetProgramiv(value->program, GL_INFO_LOG_LENGTH, &length);
-            std::unique_ptr<char[]> log(new char[length]);
-            glGetProgramInfoLog(value->program, length, &length, log.get());
-            std::cerr << "Error running program - could not validate" << std::endl;
-            std::cerr << log.get() << std::endl;
-            return false;
-        }
-        return true;
-    }
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const int& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniform1i(location, value);
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<geometry> value)
+	bool renderer::set_uniform(const uniform_handle& handle, const double& value)
 	{
-        // Check if running
-		if (!_running)
+		GLint location;
+		if (!find_uniform(handle, location))
 			return false;
+		glUniform1d(location, value);
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
 
-		// If an effect is enabled, then set view and projection values
-		if (_effect != nullptr)
-		{
-            // If we have a set camera, use it to get view and projection matrices
-			if (_camera != nullptr)
-				set_mvp(_effect, glm::mat4(1.0f), _camera->get_view(), _camera->get_projection());
-            // Otherwise use the bound view and projection
-			else
-				set_mvp(_effect, glm::mat4(1.0f), _view, _projection);
-            if (!validate_program(_effect))
-                return false;
-		}
-        // Otherwise use deprecated matrix binding
-		else
-		{
-            // If we have a set camera, use it to get view and projection matrices
-			if (_camera != nullptr)
-				set_mvp(glm::mat4(1.0f), _camera->get_view(), _camera->get_projection());
-            // Otherwise use the bound view and projection
-			else
-				set_mvp(glm::mat4(1.0f), _view, _projection);
-		}
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const float& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniform1f(location, value);
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
 
-		// Now render the geometry
-        // Try and bind the vertex array
-		glBindVertexArray(value->vertex_array_object);
-        // Check if error
-		if (CHECK_GL_ERROR)
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const unsigned int& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniform1ui(location, value);
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
+
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::vec2& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniform2fv(location, 1, glm::value_ptr(value));
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
+
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::vec3& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniform3fv(location, 1, glm::value_ptr(value));
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
+
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::vec4& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniform4fv(location, 1, glm::value_ptr(value));
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
+
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::mat2& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniformMatrix2fv(location, 1, GL_FALSE, glm::value_ptr(value));
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
+
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::mat3& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
+
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::mat4& value)
+	{
+		GLint location;
+		if (!find_uniform(handle, location))
+			return false;
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+		++_frame_stats.uniform_calls;
+		return (!CHECK_GL_ERROR);
+	}
+
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const material& value)
+	{
+		// Check that effect is bound
+		if (_effect == nullptr)
 		{
-			std::cerr << "Error trying to bind vertex array for geometry" << std::endl;
+			// Display error
+			std::cerr << "Cannot set uniform - no effect bound with renderer" << std::endl;
+			// Return false
 			return false;
 		}
+		// Set each member that exists in the effect
+		GLint location = _effect->get_location(handle.member(".emissive"));
+		if (location != -1)
+		{
+			glUniform4fv(location, 1, glm::value_ptr(value.data.emissive));
+			++_frame_stats.uniform_calls;
+		}
+		location = _effect->get_location(handle.member(".diffuse_reflection"));
+		if (location != -1)
+		{
+			glUniform4fv(location, 1, glm::value_ptr(value.data.diffuse_reflection));
+			++_frame_stats.uniform_calls;
+		}
+		location = _effect->get_location(handle.member(".specular_reflection"));
+		if (location != -1)
+		{
+			glUniform4fv(location, 1, glm::value_ptr(value.data.specular_reflection));
+			++_frame_stats.uniform_calls;
+		}
+		location = _effect->get_location(handle.member(".shininess"));
+		if (location != -1)
+		{
+			glUniform1f(location, value.data.shininess);
+			++_frame_stats.uniform_calls;
+		}
+		return true;
+	}
 
-		// If we have indices, use accordingly.
-		if (value->index_buffer)
+	template <>
+	bool renderer::set_uniform(const uniform_handle& handle, const directional_light& value)
+	{
+		// Check that effect is bound
+		if (_effect == nullptr)
 		{
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, value->index_buffer);
-			if (CHECK_GL_ERROR)
+			// Display error
+			std::cerr << "Cannot set uniform - no effect bound with renderer" << std::endl;
+			// Return false
+			return false;
+		}
+		// Check if buffer has been created or not
+		if (value.buffer)
+		{
+			// TODO : Bind buffer
+		}
+		else
+		{
+			GLint location = _effect->get_location(handle.member(".ambient_intensity"));
+			if (location != -1)
 			{
-				std::cerr << "Error trying to bind index buffer for use in geometry render" << std::endl;
-				return false;
+				glUniform4fv(location, 1, glm::value_ptr(value.data.ambient_intensity));
+				++_frame_stats.uniform_calls;
 			}
+			location = _effect->get_location(handle.member(".colour"));
+			if (location != -1)
+			{
+				glUniform4fv(location, 1, glm::value_ptr(value.data.colour));
+				++_frame_stats.uniform_calls;
+			}
+			location = _effect->get_location(handle.member(".direction"));
+			if (location != -1)
+			{
+				glUniform3fv(location, 1, glm::value_ptr(value.data.direction));
+				++_frame_stats.uniform_calls;
+			}
+		}
+		return true;
+	}
 
-			glDrawElements(value->geometry_type, value->indices.size(), GL_UNSIGNED_INT, 0);
-			if (CHECK_GL_ERROR)
+	/*
+	Helper function to set model-view and projection matrices
+	*/
+	void set_mvp(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+	{
+		// Set the projection matrix
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(glm::value_ptr(projection));
+
+		// Set the model view matrix
+		glm::mat4 modelView = view * model;
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(glm::value_ptr(modelView));
+	}
+
+	/*
+	Helper function to set model-view and projection matrices on a effect.
+	Uses the built in uniform locations resolved when the effect was built
+	*/
+	void set_mvp(const std::shared_ptr<effect>& eff, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+	{
+		frame_stats& stats = renderer::get_instance().edit_frame_stats();
+		auto locations = eff->builtin_uniforms;
+		// Try and set the model matrix
+		if (locations[UNIFORM_MODEL] != -1)
+		{
+			glUniformMatrix4fv(locations[UNIFORM_MODEL], 1, GL_FALSE, glm::value_ptr(model));
+			++stats.uniform_calls;
+		}
+		// Try and set the view matrix
+		if (locations[UNIFORM_VIEW] != -1)
+		{
+			glUniformMatrix4fv(locations[UNIFORM_VIEW], 1, GL_FALSE, glm::value_ptr(view));
+			++stats.uniform_calls;
+		}
+		// Try and set the projection matrix
+		if (locations[UNIFORM_PROJECTION] != -1)
+		{
+			glUniformMatrix4fv(locations[UNIFORM_PROJECTION], 1, GL_FALSE, glm::value_ptr(projection));
+			++stats.uniform_calls;
+		}
+		// Create model-view matrix and try and set
+		if (locations[UNIFORM_MV] != -1)
+		{
+			glm::mat4 modelView = view * model;
+			glUniformMatrix4fv(locations[UNIFORM_MV], 1, GL_FALSE, glm::value_ptr(modelView));
+			++stats.uniform_calls;
+		}
+		// Create model-view-projection matrix and try and set
+		if (locations[UNIFORM_MVP] != -1)
+		{
+			glm::mat4 modelViewProjection = projection * view * model;
+			glUniformMatrix4fv(locations[UNIFORM_MVP], 1, GL_FALSE, glm::value_ptr(modelViewProjection));
+			++stats.uniform_calls;
+		}
+	}
+
+	/*
+	Helper function to set the normal matrix on an effect if it is used
+	*/
+	void set_normal_matrix(const std::shared_ptr<effect>& eff, const glm::mat3& normal)
+	{
+		frame_stats& stats = renderer::get_instance().edit_frame_stats();
+		if (eff->builtin_uniforms[UNIFORM_NORMAL_MATRIX] != -1)
+		{
+			glUniformMatrix3fv(eff->builtin_uniforms[UNIFORM_NORMAL_MATRIX], 1, GL_FALSE, glm::value_ptr(normal));
+			++stats.uniform_calls;
+		}
+	}
+
+	/*
+	Helper function to set the matrices of a recorded draw on an effect.  The
+	matrices were composed when the draw was recorded, so are only uploaded
+	*/
+	void set_command_matrices(const std::shared_ptr<effect>& eff, const draw_command& command, const glm::mat4& view, const glm::mat4& projection)
+	{
+		frame_stats& stats = renderer::get_instance().edit_frame_stats();
+		auto& locations = eff->builtin_uniforms;
+		if (locations[UNIFORM_MODEL] != -1)
+		{
+			glUniformMatrix4fv(locations[UNIFORM_MODEL], 1, GL_FALSE, glm::value_ptr(command.model));
+			++stats.uniform_calls;
+		}
+		if (locations[UNIFORM_VIEW] != -1)
+		{
+			glUniformMatrix4fv(locations[UNIFORM_VIEW], 1, GL_FALSE, glm::value_ptr(view));
+			++stats.uniform_calls;
+		}
+		if (locations[UNIFORM_PROJECTION] != -1)
+		{
+			glUniformMatrix4fv(locations[UNIFORM_PROJECTION], 1, GL_FALSE, glm::value_ptr(projection));
+			++stats.uniform_calls;
+		}
+		if (locations[UNIFORM_MV] != -1)
+		{
+			glUniformMatrix4fv(locations[UNIFORM_MV], 1, GL_FALSE, glm::value_ptr(command.model_view));
+			++stats.uniform_calls;
+		}
+		if (locations[UNIFORM_MVP] != -1)
+		{
+			glUniformMatrix4fv(locations[UNIFORM_MVP], 1, GL_FALSE, glm::value_ptr(command.model_view_projection));
+			++stats.uniform_calls;
+		}
+		if (locations[UNIFORM_NORMAL_MATRIX] != -1)
+		{
+			glUniformMatrix3fv(locations[UNIFORM_NORMAL_MATRIX], 1, GL_FALSE, glm::value_ptr(command.normal));
+			++stats.uniform_calls;
+		}
+	}
+
+    bool validate_program(const std::shared_ptr<effect>& value)
+    {
+        glValidateProgram(value->program);
+        GLint status;
+        glGetProgramiv(value->program, GL_VALIDATE_STATUS, &status);
+        if (!status)
+        {
+            GLsizei length;
+            glGetProgramiv(value->program, GL_INFO_LOG_LENGTH, &length);
+            std::unique_ptr<char[]> log(new char[length]);
+            glGetProgramInfoLog(value->program, length, &length, log.get());
+            std::cerr << "Error running program - could not validate" << std::endl;
+            std::cerr << log.get() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+	/*
+	Validates the bound program against the bound vertex array and frame
+	buffer.  Validation stalls the pipeline, so it is only performed in debug
+	builds, and only once for each combination of state
+	*/
+	bool renderer::validate_draw()
+	{
+#if defined(DEBUG) | defined(_DEBUG)
+		// Pack the state into a key.  Names are small, so 20 bits is plenty
+		std::uint64_t key = (static_cast<std::uint64_t>(_state.get_program() & 0xFFFFF) << 40)
+						  | (static_cast<std::uint64_t>(_state.get_vertex_array() & 0xFFFFF) << 20)
+						  | (_state.get_frame_buffer() & 0xFFFFF);
+		// Check if this combination has already been validated
+		if (_validated.find(key) != _validated.end())
+			return true;
+		if (!validate_program(_effect))
+			return false;
+		_validated.insert(key);
+#endif
+		return true;
+	}
+
+	/*
+	Writes the matrices into the model ring.  Where possible they are copied
+	in on the GPU through the stream buffer, so the CPU never waits for a
+	draw reading the ring.  Otherwise the slots are written through an
+	unsynchronised mapping, which is safe because a slot is only written once
+	between the ring being orphaned
+	*/
+	unsigned int renderer::stream_models(const glm::mat4* models, unsigned int count)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, _model_buffer);
+		if (_model_slot + count > _model_capacity)
+		{
+			// Start the ring again in new storage.  Draws in flight keep
+			// reading the old storage
+			_model_capacity = (std::max)(_model_capacity, count);
+			glBufferData(GL_ARRAY_BUFFER, _model_capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+			_model_slot = 0;
+		}
+		unsigned int first = _model_slot;
+		_model_slot += count;
+
+		GLintptr offset = first * sizeof(glm::mat4);
+		GLsizeiptr size = count * sizeof(glm::mat4);
+		if (!_stream.write(_model_buffer, offset, size, models))
+		{
+			void* destination = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if (destination != nullptr)
 			{
-				std::cerr << "Error trying to draw using index buffer using geometry" << std::endl;
-				return false;
+				std::memcpy(destination, models, static_cast<std::size_t>(size));
+				glUnmapBuffer(GL_ARRAY_BUFFER);
 			}
+			else
+				glBufferSubData(GL_ARRAY_BUFFER, offset, size, models);
+			_frame_stats.bytes_uploaded += size;
 		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return first;
+	}
+
+	/*
+	Draws a piece of geometry with the currently bound effect.  Pooled geometry
+	is drawn from the pool's shared buffers.  If the effect reads the model
+	matrix from the instance_model attribute, the model matrix is streamed
+	into the model ring and the draw reads it as its only instance.  The
+	instance buffer of the geometry is left for real instance data
+	*/
+	bool renderer::draw_geometry(const geometry& geom, const glm::mat4& model)
+	{
+		bool instance_model = _effect != nullptr && _effect->uses_instance_model;
+		GLuint slot = instance_model ? stream_models(&model, 1) : 0;
+
+		// Bind the vertex array of the pool or the geometry
+		if (geom.pool != nullptr)
+			_state.bind_vertex_array(geom.pool->get_vertex_array());
 		else
 		{
-			glDrawArrays(value->geometry_type, 0, value->positions.size());
-			if (CHECK_GL_ERROR)
+			_state.bind_vertex_array(geom.vertex_array_object);
+			// Read the instance attributes from the model ring
+			if (instance_model && geom.instance_source != _model_buffer)
 			{
-				std::cerr << "Error trying to draw geometry" << std::endl;
-				return false;
+				geometry_builder::set_instance_attributes(_model_buffer);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+				geom.instance_source = _model_buffer;
 			}
 		}
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error trying to bind vertex array for geometry" << std::endl;
+			return false;
+		}
+
+		// Validate the program against the bound state
+		if (_effect != nullptr && !validate_draw())
+			return false;
+
+		// The pool's vertex array reads instance_model from the model ring,
+		// so a single draw only needs the base instance to select its slot
+		if (geom.pool != nullptr)
+		{
+			const GLvoid* first_index = reinterpret_cast<const GLvoid*>(geom.pool_first_index * sizeof(unsigned int));
+			if (instance_model)
+				glDrawElementsInstancedBaseVertexBaseInstance(geom.geometry_type, geom.pool_index_count, GL_UNSIGNED_INT,
+					first_index, 1, geom.pool_base_vertex, slot);
+			else
+				glDrawElementsBaseVertex(geom.geometry_type, geom.pool_index_count, GL_UNSIGNED_INT, first_index, geom.pool_base_vertex);
+			_frame_stats.add_draw(geom.geometry_type, geom.pool_index_count);
+		}
+		// If we have indices, use accordingly.  The index buffer is part of
+		// the vertex array state, so it does not need to be bound again
+		else if (geom.index_buffer)
+		{
+			if (instance_model)
+				glDrawElementsInstancedBaseInstance(geom.geometry_type, geom.indices.size(), GL_UNSIGNED_INT, 0, 1, slot);
+			else
+				glDrawElements(geom.geometry_type, geom.indices.size(), GL_UNSIGNED_INT, 0);
+			_frame_stats.add_draw(geom.geometry_type, geom.indices.size());
+		}
+		else
+		{
+			if (instance_model)
+				glDrawArraysInstancedBaseInstance(geom.geometry_type, 0, geom.positions.size(), 1, slot);
+			else
+				glDrawArrays(geom.geometry_type, 0, geom.positions.size());
+			_frame_stats.add_draw(geom.geometry_type, geom.positions.size());
+		}
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error trying to draw geometry" << std::endl;
+			return false;
+		}
 
 		return true;
 	}
 
+	/*
+	Renders a piece of geometry.  The value is borrowed, so no reference is taken
+	*/
+	bool renderer::render(const geometry& value)
+	{
+        // Check if running
+		if (!_running)
+			return false;
+
+		// If an effect is enabled, then set view and projection values
+		if (_effect != nullptr)
+		{
+            // If we have a set camera, use it to get view and projection matrices
+			if (_camera != nullptr)
+				set_mvp(_effect, glm::mat4(1.0f), _camera->get_view(), _camera->get_projection());
+            // Otherwise use the bound view and projection
+			else
+				set_mvp(_effect, glm::mat4(1.0f), _view, _projection);
+		}
+        // Otherwise use deprecated matrix binding
+		else
+		{
+            // If we have a set camera, use it to get view and projection matrices
+			if (_camera != nullptr)
+				set_mvp(glm::mat4(1.0f), _camera->get_view(), _camera->get_projection());
+            // Otherwise use the bound view and projection
+			else
+				set_mvp(glm::mat4(1.0f), _view, _projection);
+		}
+
+		// Now render the geometry
+		return draw_geometry(value, glm::mat4(1.0f));
+	}
+
+	template <>
+	bool renderer::render(const std::shared_ptr<geometry>& value)
+	{
+		return render(*value);
+	}
+
 	template<>
-	bool renderer::render(std::shared_ptr<model> value)
+	bool renderer::render(const std::shared_ptr<model>& value)
 	{
 		return false;
 	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<texture> value)
+	bool renderer::render(const std::shared_ptr<texture>& value)
 	{
 		return false;
 	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<skybox> value)
+	bool renderer::render(const std::shared_ptr<skybox>& value)
 	{
+		PROFILE_GPU_ZONE("skybox");
+
         // Create model matrix for geometry
         glm::mat4 model = glm::translate(glm::mat4(1.0f), _camera->get_position());
         model = glm::scale(model, glm::vec3(10.0f, 10.0f, 10.0f));
 
         // Disable depth testing
-        glDisable(GL_DEPTH_TEST);
-        glDepthMask(GL_FALSE);
+        _state.set_depth_test(false);
+        _state.set_depth_mask(false);
 
         // Bind effect
         bind(value->eff);
@@ -996,132 +1741,416 @@ namespace render_framework
 			set_mvp(model, _view, _projection);
 
         // Set cubemap on effect
+        static const uniform_handle cubemap_handle("cubemap");
         bind_texture(value->tex, 0);
-        set_uniform("cubemap", 0);
+        set_uniform(cubemap_handle, 0);
 
         // Now render the geometry
-        auto geom = content_manager::get_instance().get<geometry>("SKYBOX");
+        static auto geom = content_manager::get_instance().get<geometry>("SKYBOX");
         // Try and bind the vertex array
-		glBindVertexArray(geom->vertex_array_object);
+		_state.bind_vertex_array(geom->vertex_array_object);
         // Check if error
 		if (CHECK_GL_ERROR)
 		{
 			std::cerr << "Error trying to bind vertex array for skybox geometry" << std::endl;
 			return false;
 		}
+		if (!validate_draw())
+			return false;
 		glDrawArrays(geom->geometry_type, 0, geom->positions.size());
+		_frame_stats.add_draw(geom->geometry_type, geom->positions.size());
 		if (CHECK_GL_ERROR)
 		{
 			std::cerr << "Error trying to draw skybox geometry" << std::endl;
 			return false;
 		}
 
-        glDepthMask(true);
-        glEnable(GL_DEPTH_TEST);
+        _state.set_depth_mask(true);
+        _state.set_depth_test(true);
 
 		return true;
 	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<terrain> value)
+	bool renderer::render(const std::shared_ptr<terrain>& value)
 	{
 		return false;
 	}
 
-	template <>
-	bool renderer::render(std::shared_ptr<mesh> value)
+	/*
+	Renders a mesh.  The value is borrowed, so no reference is taken
+	*/
+	bool renderer::render(const mesh& value)
 	{
 		if (!_running)
 			return false;
 
 		// Check if mesh has a material
-		if (value->mat)
+		if (value.mat)
 			// Mesh has a material.  Bind
-			value->mat->bind();
+			value.mat->bind();
 		else
 			// Mesh doesn't have a material.  Set _effect to nullptr
 			_effect = nullptr;
 
+		// World matrix is used for the MVP and the draw, so only get it once
+		glm::mat4 model = value.get_transform_matrix();
+
 		// If an effect is enabled, then set view and projection values
 		if (_effect != nullptr)
 		{
 			if (_camera)
-				set_mvp(_effect, value->trans.get_transform_matrix(), _camera->get_view(), _camera->get_projection());
+				set_mvp(_effect, model, _camera->get_view(), _camera->get_projection());
 			else
-				set_mvp(_effect, value->trans.get_transform_matrix(), _view, _projection);
+				set_mvp(_effect, model, _view, _projection);
 			// Set the normal matrix if present
-            if (_effect->uniforms.find("normal_matrix") != _effect->uniforms.end())
-			    set_uniform("normal_matrix", value->trans.get_normal_matrix());
-            if (!validate_program(_effect))
-                return false;
+			set_normal_matrix(_effect, value.get_normal_matrix());
 		}
 		else
 		{
 			if (_camera)
-				set_mvp(value->trans.get_transform_matrix(), _camera->get_view(), _camera->get_projection());
+				set_mvp(model, _camera->get_view(), _camera->get_projection());
 			else
-				set_mvp(value->trans.get_transform_matrix(), _view, _projection);
+				set_mvp(model, _view, _projection);
 		}
 
 		// Now render the geometry
-		glBindVertexArray(value->geom->vertex_array_object);
-		if (CHECK_GL_ERROR)
+		return draw_geometry(*value.geom, model);
+	}
+
+	template <>
+	bool renderer::render(const std::shared_ptr<mesh>& value)
+	{
+		return render(*value);
+	}
+
+	/*
+	Renders a set of mesh instances.  The value is borrowed, so no reference is taken
+	*/
+	bool renderer::render(const mesh_instances& value)
+	{
+		if (!_running)
+			return false;
+
+		// Nothing to draw
+		if (value.matrices.empty())
+			return true;
+
+		// Instanced rendering requires an effect to read the instance matrices
+		if (value.mat == nullptr || value.mat->effect == nullptr)
 		{
-			std::cerr << "Error trying to bind vertex array for mesh" << std::endl;
+			std::cerr << "Cannot render mesh instances - no material or effect set" << std::endl;
 			return false;
 		}
+		if (!value.mat->bind())
+			return false;
+
+		// The instance matrices hold the model transform, so the built in
+		// matrices are set using an identity model matrix
+		if (_camera)
+			set_mvp(_effect, glm::mat4(1.0f), _camera->get_view(), _camera->get_projection());
+		else
+			set_mvp(_effect, glm::mat4(1.0f), _view, _projection);
 
-		// If we have indices, use accordingly.
-		if (value->geom->index_buffer)
+		// Pooled geometry reads its matrices from the model ring.  Stream them
+		// in and draw every instance in one call, starting at the first slot
+		auto& geom = value.geom;
+		auto count = static_cast<unsigned int>(value.matrices.size());
+		if (geom->pool != nullptr)
 		{
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, value->geom->index_buffer);
+			GLuint first = stream_models(&value.matrices[0], count);
+			_state.bind_vertex_array(geom->pool->get_vertex_array());
+			if (!validate_draw())
+				return false;
+			glDrawElementsInstancedBaseVertexBaseInstance(geom->geometry_type, geom->pool_index_count, GL_UNSIGNED_INT,
+				reinterpret_cast<const GLvoid*>(geom->pool_first_index * sizeof(unsigned int)), count, geom->pool_base_vertex, first);
+			_frame_stats.add_draw(geom->geometry_type, geom->pool_index_count, count);
 			if (CHECK_GL_ERROR)
 			{
-				std::cerr << "Error trying to bind index buffer for use in mesh render" << std::endl;
+				std::cerr << "Error trying to draw pooled mesh instances" << std::endl;
 				return false;
 			}
+			return true;
+		}
 
-			glDrawElements(value->geom->geometry_type, value->geom->indices.size(), GL_UNSIGNED_INT, 0);
-			if (CHECK_GL_ERROR)
+		// Stream the matrices into the instance buffer.  The buffer only grows
+		if (count > geom->instance_capacity)
+		{
+			geom->instance_capacity = count;
+			glBindBuffer(GL_ARRAY_BUFFER, geom->instance_buffer);
+			glBufferData(GL_ARRAY_BUFFER, geom->instance_capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+		}
+		// Copy through the stream buffer if we can.  Otherwise orphan the
+		// buffer so we never wait on a draw still reading the old contents
+		if (!_stream.write(geom->instance_buffer, 0, count * sizeof(glm::mat4), &value.matrices[0]))
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, geom->instance_buffer);
+			glBufferData(GL_ARRAY_BUFFER, geom->instance_capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), &value.matrices[0]);
+			_frame_stats.bytes_uploaded += count * sizeof(glm::mat4);
+		}
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error trying to update instance buffer" << std::endl;
+			return false;
+		}
+
+		// Now render the geometry.  Single draws may have pointed the
+		// instance attributes at the model ring, so point them back
+		_state.bind_vertex_array(geom->vertex_array_object);
+		if (geom->instance_source != geom->instance_buffer)
+		{
+			geometry_builder::set_instance_attributes(geom->instance_buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			geom->instance_source = geom->instance_buffer;
+		}
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error trying to bind vertex array for mesh instances" << std::endl;
+			return false;
+		}
+
+		// Validate the program against the bound state
+		if (!validate_draw())
+			return false;
+
+		// Draw every instance in one call
+		if (geom->index_buffer)
+		{
+			glDrawElementsInstanced(geom->geometry_type, geom->indices.size(), GL_UNSIGNED_INT, 0, count);
+			_frame_stats.add_draw(geom->geometry_type, geom->indices.size(), count);
+		}
+		else
+		{
+			glDrawArraysInstanced(geom->geometry_type, 0, geom->positions.size(), count);
+			_frame_stats.add_draw(geom->geometry_type, geom->positions.size(), count);
+		}
+		if (CHECK_GL_ERROR)
+		{
+			std::cerr << "Error trying to draw mesh instances" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	template <>
+	bool renderer::render(const std::shared_ptr<mesh_instances>& value)
+	{
+		return render(*value);
+	}
+
+	/*
+	Culls, sorts and renders the draws in a render queue.  Large queues are
+	split into contiguous ranges of the sorted order, which are recorded into
+	command lists by the job system.  The value is borrowed, so no
+	reference is taken
+	*/
+	bool renderer::render(render_queue& value)
+	{
+		if (!_running)
+			return false;
+
+		PROFILE_GPU_ZONE("render_queue");
+
+		// View and projection are the same for every draw in the queue
+		glm::mat4 view = _camera ? _camera->get_view() : _view;
+		glm::mat4 projection = _camera ? _camera->get_projection() : _projection;
+
+		// Drop draws outside the view.  Effects write logarithmic depth, so the
+		// far plane of the projection does not clip and is not tested
+		value.cull(projection * view, false);
+
+		// Sort the draws so that draws sharing state are adjacent
+		value.sort();
+
+		// Only split the recording if there is enough work to go round
+		std::size_t lists = value.size() >= PARALLEL_RECORD_THRESHOLD ? _command_lists.size() : 1;
+		std::size_t range = (value.size() + lists - 1) / lists;
+		for (std::size_t i = 0; i < lists; ++i)
+			_command_lists[i].begin(view, projection);
+
+		// Record each range as a job.  This thread records too while it waits
+		command_list* command_lists = &_command_lists[0];
+		const render_queue* queue = &value;
+		job_system::get_instance().parallel_for(lists, 1, [command_lists, queue, range](std::size_t begin, std::size_t end)
+		{
+			PROFILE_ZONE("record commands");
+			for (std::size_t i = begin; i < end; ++i)
+				command_lists[i].record(*queue, i * range, (i + 1) * range);
+		});
+
+		// Ranges were taken from the sorted queue, so the merge just joins them
+		return render(&_command_lists[0], lists);
+	}
+
+	template <>
+	bool renderer::render(const std::shared_ptr<render_queue>& value)
+	{
+		return render(*value);
+	}
+
+	/*
+	Replays a single command list.  The value is borrowed, so no reference is taken
+	*/
+	bool renderer::render(const command_list& value)
+	{
+		return render(&value, 1);
+	}
+
+	template <>
+	bool renderer::render(const std::shared_ptr<command_list>& value)
+	{
+		return render(*value);
+	}
+
+	/*
+	Merges the commands of several lists by key and replays them.  Each list
+	must already be sorted.  A list keeps supplying commands for as long as
+	its keys come before the heads of every other list, so lists covering
+	separate ranges of the same sorted queue are joined without comparing
+	each command.  Equal keys are taken from the earlier list first
+	*/
+	bool renderer::render(const command_list* lists, std::size_t count)
+	{
+		if (!_running)
+			return false;
+
+		// Merged order of the commands, along with the list each came from
+		typedef std::pair<const command_list*, const draw_command*> entry;
+		auto& arena = get_frame_arena();
+		std::size_t total = 0;
+		for (std::size_t i = 0; i < count; ++i)
+			total += lists[i].size();
+		frame_vector<entry>::type order((arena_allocator<entry>(arena)));
+		order.reserve(total);
+		frame_vector<std::size_t>::type heads(count, 0, arena_allocator<std::size_t>(arena));
+
+		while (order.size() < total)
+		{
+			// Find the list with the lowest head, and the next lowest after it
+			std::size_t best = count;
+			std::size_t next = count;
+			for (std::size_t i = 0; i < count; ++i)
 			{
-				std::cerr << "Error trying to draw using index buffer using mesh" << std::endl;
-				return false;
+				if (heads[i] == lists[i].size())
+					continue;
+				auto key = lists[i].get_command(heads[i]).key;
+				if (best == count || key < lists[best].get_command(heads[best]).key)
+				{
+					next = best;
+					best = i;
+				}
+				else if (next == count || key < lists[next].get_command(heads[next]).key)
+					next = i;
 			}
+
+			// Take commands from the lowest list until another list should go first
+			const command_list& list = lists[best];
+			do
+			{
+				order.push_back(entry(&list, &list.get_command(heads[best])));
+				++heads[best];
+			} while (heads[best] < list.size() &&
+					 (next == count || list.get_command(heads[best]).key < lists[next].get_command(heads[next]).key ||
+					  (best < next && list.get_command(heads[best]).key == lists[next].get_command(heads[next]).key)));
 		}
-		else
+
+		// Material bound by the previous draw
+		material* last_mat = nullptr;
+
+		for (std::size_t i = 0; i < order.size(); ++i)
 		{
-			glDrawArrays(value->geom->geometry_type, 0, value->geom->positions.size());
-			if (CHECK_GL_ERROR)
+			auto& command = *order[i].second;
+			auto& view = order[i].first->get_view();
+			auto& projection = order[i].first->get_projection();
+			auto mat = command.mat;
+
+			// Only bind the material if it has changed
+			if (i == 0 || mat != last_mat)
 			{
-				std::cerr << "Error trying to draw mesh" << std::endl;
-				return false;
+				if (mat)
+				{
+					// Only switch program if the effect has changed
+					if (_effect != mat->effect)
+					{
+						if (!bind(mat->effect))
+							return false;
+					}
+					if (!mat->bind_values())
+						return false;
+				}
+				else
+					_effect = nullptr;
+				last_mat = mat;
+			}
+
+			// Pooled geometry drawn with an effect reading instance_model can
+			// be batched.  Collect the following draws using the same material
+			// and pool, and submit them with a single multi draw
+			if (_effect != nullptr && _effect->uses_instance_model && command.geom->pool != nullptr)
+			{
+				auto pool = command.geom->pool;
+				pool->begin_batch();
+				std::size_t j = i;
+				for (; j < order.size(); ++j)
+				{
+					auto& next = *order[j].second;
+					if (next.mat != last_mat || next.geom->pool != pool)
+						break;
+					pool->add_draw(*next.geom, next.model);
+				}
+				_state.bind_vertex_array(pool->get_vertex_array());
+				if (!validate_draw() || !pool->draw_batch())
+					return false;
+				// Continue from the last draw in the batch
+				i = j - 1;
+				continue;
 			}
+
+			// Set the per draw matrices
+			if (_effect != nullptr)
+				set_command_matrices(_effect, command, view, projection);
+			else
+			{
+				glMatrixMode(GL_PROJECTION);
+				glLoadMatrixf(glm::value_ptr(projection));
+				glMatrixMode(GL_MODELVIEW);
+				glLoadMatrixf(glm::value_ptr(command.model_view));
+			}
+
+			// Draw the geometry.  Vertex arrays that are already bound are
+			// skipped by the state tracker
+			if (!draw_geometry(*command.geom, command.model))
+				return false;
 		}
 
 		return true;
 	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<frame_buffer> value)
+	bool renderer::render(const std::shared_ptr<frame_buffer>& value)
 	{
 		return false;
 	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<depth_buffer> value)
+	bool renderer::render(const std::shared_ptr<depth_buffer>& value)
 	{
 		return false;
 	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<shadow_map> value)
+	bool renderer::render(const std::shared_ptr<shadow_map>& value)
 	{
 		return false;
 	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<render_pass> value)
+	bool renderer::render(const std::shared_ptr<render_pass>& value)
 	{
+        PROFILE_GPU_ZONE("render_pass");
+
         static auto geom = content_manager::get_instance().get<geometry>("SCREEN_QUAD");
         // Begin render
         begin_render();
@@ -1133,10 +2162,10 @@ namespace render_framework
         // Bind the texture
         auto index = 0;
         if (value->uniform_values != nullptr)
-            index = value->uniform_values->texture_map.size()
-                  + value->uniform_values->cubemap_map.size();
+            index = value->uniform_values->texture_count();
+        static const uniform_handle tex_handle("tex");
         bind_texture(value->buffer->tex, index);
-        set_uniform("tex", index);
+        set_uniform(tex_handle, index);
         
         // Render geometry
         render(geom);
@@ -1144,7 +2173,7 @@ namespace render_framework
 	}
 
 	template <>
-	bool renderer::render(std::shared_ptr<post_process> value)
+	bool renderer::render(const std::shared_ptr<post_process>& value)
 	{
         // Render each pass
         for (auto i = 1; i < value->passes.size(); ++i)
@@ -1155,13 +2184,16 @@ namespace render_framework
             render(value->passes[i - 1]);
         }
         // Render final pass using the screen
-        bind(content_manager::get_instance().get<frame_buffer>("SCREEN"));
+        static auto screen = content_manager::get_instance().get<frame_buffer>("SCREEN");
+        bind(screen);
         render(value->passes[value->passes.size() - 1]);
 		return true;
 	}
 
-	template <>
-	bool renderer::shadow_render(std::shared_ptr<geometry> value)
+	/*
+	Renders a piece of geometry to the shadow map.  The value is borrowed, so no reference is taken
+	*/
+	bool renderer::shadow_render(const geometry& value)
 	{
 		// Check if running
 		if (!_running)
@@ -1171,8 +2203,6 @@ namespace render_framework
 		if (_effect != nullptr)
 		{
             set_mvp(_effect, glm::mat4(1.0f), _shadow_map->view_matrix, _shadow_map->projection_matrix);
-            if (!validate_program(_effect))
-                return false;
 		}
         // Otherwise we have a problem - shadow shader not bound
 		else
@@ -1182,70 +2212,42 @@ namespace render_framework
 		}
 
 		// Now render the geometry
-        // Try and bind the vertex array
-		glBindVertexArray(value->vertex_array_object);
-        // Check if error
-		if (CHECK_GL_ERROR)
-		{
-			std::cerr << "Error trying to bind vertex array for geometry" << std::endl;
-			return false;
-		}
-
-		// If we have indices, use accordingly.
-		if (value->index_buffer)
-		{
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, value->index_buffer);
-			if (CHECK_GL_ERROR)
-			{
-				std::cerr << "Error trying to bind index buffer for use in geometry render" << std::endl;
-				return false;
-			}
-
-			glDrawElements(value->geometry_type, value->indices.size(), GL_UNSIGNED_INT, 0);
-			if (CHECK_GL_ERROR)
-			{
-				std::cerr << "Error trying to draw using index buffer using geometry" << std::endl;
-				return false;
-			}
-		}
-		else
-		{
-			glDrawArrays(value->geometry_type, 0, value->positions.size());
-			if (CHECK_GL_ERROR)
-			{
-				std::cerr << "Error trying to draw geometry" << std::endl;
-				return false;
-			}
-		}
+		return draw_geometry(value, glm::mat4(1.0f));
+	}
 
-		return true;
+	template <>
+	bool renderer::shadow_render(const std::shared_ptr<geometry>& value)
+	{
+		return shadow_render(*value);
 	}
 
 	template <>
-	bool renderer::shadow_render(std::shared_ptr<model> value)
+	bool renderer::shadow_render(const std::shared_ptr<model>& value)
 	{
 		return false;
 	}
 
 	template <>
-	bool renderer::shadow_render(std::shared_ptr<terrain> value)
+	bool renderer::shadow_render(const std::shared_ptr<terrain>& value)
 	{
 		return false;
 	}
 
-	template <>
-	bool renderer::shadow_render(std::shared_ptr<mesh> value)
+	/*
+	Renders a mesh to the shadow map.  The value is borrowed, so no reference is taken
+	*/
+	bool renderer::shadow_render(const mesh& value)
 	{
 		if (!_running)
 			return false;
 
 
+		glm::mat4 model = value.get_transform_matrix();
+
 		// If an effect is enabled, then set view and projection values
 		if (_effect != nullptr)
 		{
-			set_mvp(_effect, value->trans.get_transform_matrix(), _shadow_map->view_matrix, _shadow_map->projection_matrix);
-			if (!validate_program(_effect))
-                return false;
+			set_mvp(_effect, model, _shadow_map->view_matrix, _shadow_map->projection_matrix);
 		}
 		else
 		{
@@ -1254,40 +2256,12 @@ namespace render_framework
 		}
 
 		// Now render the geometry
-		glBindVertexArray(value->geom->vertex_array_object);
-		if (CHECK_GL_ERROR)
-		{
-			std::cerr << "Error trying to bind vertex array for mesh" << std::endl;
-			return false;
-		}
-
-		// If we have indices, use accordingly.
-		if (value->geom->index_buffer)
-		{
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, value->geom->index_buffer);
-			if (CHECK_GL_ERROR)
-			{
-				std::cerr << "Error trying to bind index buffer for use in mesh render" << std::endl;
-				return false;
-			}
-
-			glDrawElements(value->geom->geometry_type, value->geom->indices.size(), GL_UNSIGNED_INT, 0);
-			if (CHECK_GL_ERROR)
-			{
-				std::cerr << "Error trying to draw using index buffer using mesh" << std::endl;
-				return false;
-			}
-		}
-		else
-		{
-			glDrawArrays(value->geom->geometry_type, 0, value->geom->positions.size());
-			if (CHECK_GL_ERROR)
-			{
-				std::cerr << "Error trying to draw mesh" << std::endl;
-				return false;
-			}
-		}
+		return draw_geometry(*value.geom, model);
+	}
 
-		return true;
+	template <>
+	bool renderer::shadow_render(const std::shared_ptr<mesh>& value)
+	{
+		return shadow_render(*value);
 	}
 }
\ No newline at end of file
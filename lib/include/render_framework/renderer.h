@@ -3,12 +3,28 @@
 #include <string>
 #include <iostream>
 #include <memory>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+#include <chrono>
+#include <fstream>
 #include <GL\glew.h>
 #include <GL\glfw3.h>
 #include <glm\glm.hpp>
 
+#include "gl_state.h"
+#include "frame_data.h"
+#include "frame_arena.h"
+#include "frame_stats.h"
+#include "frame_timing.h"
+#include "stream_buffer.h"
+#include "command_list.h"
+
 namespace render_framework
 {
+	// Number of model matrices the model ring holds before it is orphaned
+	const unsigned int MODEL_RING_SLOTS = 4096;
+
 	// Forward declaration of camera
 	class camera;
 
@@ -29,6 +45,7 @@ namespace render_framework
 
 	// Forward declaration of mesh
 	struct mesh;
+	struct mesh_instances;
 
 	// Forward declaration of lighting
 	struct directional_light;
@@ -38,6 +55,7 @@ namespace render_framework
 
 	// Forward declaration of effect
 	struct effect;
+	struct uniform_handle;
 
 	// Forward declaration for buffers
 	struct frame_buffer;
@@ -48,6 +66,9 @@ namespace render_framework
 	struct render_pass;
 	struct post_process;
 
+	// Forward declaration for render queues
+	class render_queue;
+
 	/*
 	This class is responsible for rendering objects to the screen, by allowing
 	the binding of values such as effects and buffers, and also the rendering of
@@ -77,12 +98,76 @@ namespace render_framework
 		glm::mat4 _projection;
 		// Current shadow map being used - if relevant
 		std::shared_ptr<shadow_map> _shadow_map;
+		// Tracks the OpenGL state so redundant calls can be skipped
+		gl_state _state;
+		// Program, vertex array and frame buffer combinations already validated
+		std::unordered_set<std::uint64_t> _validated;
+		// The main scene light shared by every effect through the frame block
+		std::shared_ptr<directional_light> _sun;
+		// Values uploaded to the frame uniform block
+		frame_data _frame_data;
+		// OpenGL ID of the frame uniform buffer
+		GLuint _frame_uniforms;
+		// Flag indicating the frame uniforms have been uploaded this frame
+		bool _frame_uploaded;
+		// Arenas for transient data, one per frame in flight
+		frame_memory _frame_memory;
+		// Ring buffer used to upload light, material and instance data
+		stream_buffer _stream;
+		// Ring of model matrices read through the instance_model attribute
+		// by single draws and pooled batches
+		GLuint _model_buffer;
+		// Number of matrices the model ring holds
+		unsigned int _model_capacity;
+		// Next free slot in the model ring
+		unsigned int _model_slot;
+		// Command lists render queues are recorded into, one per job thread
+		std::vector<command_list> _command_lists;
+		// Flag indicating the renderer uses an offscreen context
+		bool _headless;
+		// Frames to render before stopping when headless.  0 for no limit
+		unsigned int _frame_limit;
+		// Number of frames rendered
+		unsigned int _frame_count;
+		// Rolling histogram of the time between end_render calls
+		frame_timing _frame_timing;
+		// Time the last frame ended.  Only valid after the first frame
+		std::chrono::steady_clock::time_point _last_frame;
+		// Counters of the work sent to OpenGL this frame
+		frame_stats _frame_stats;
+		// File the counters of each frame are written to.  Closed if unused
+		std::ofstream _stats_file;
+		// EGL display, surface and context used when headless
+		void* _egl_display;
+		void* _egl_surface;
+		void* _egl_context;
 		// Private constructor.  Class is a singleton
-		renderer() : _caption("Render Framework") { }
+		renderer()
+			: _window(nullptr), _caption("Render Framework"), _frame_uniforms(0), _frame_uploaded(false),
+			  _model_buffer(0), _model_capacity(0), _model_slot(0), _headless(false), _frame_limit(0), _frame_count(0), _egl_display(nullptr), _egl_surface(nullptr), _egl_context(nullptr)
+		{
+			_state.set_stats(&_frame_stats);
+		}
 		// Private copy constructor
 		renderer(const renderer&) { }
 		// Private assignment operator
 		void operator=(renderer&) { }
+		// Gets the location of a uniform in the bound effect from a handle
+		bool find_uniform(const uniform_handle& handle, GLint& location);
+		// Validates the bound program against the currently bound state
+		bool validate_draw();
+		// Draws a piece of geometry using the bound effect
+		bool draw_geometry(const geometry& geom, const glm::mat4& model);
+		// Uploads the frame uniform block if not already done this frame
+		bool upload_frame_data();
+		// Creates the window and its context
+		bool create_window();
+		// Creates an offscreen context for headless rendering
+		bool create_offscreen_context();
+		// Checks if the user has asked to close the window
+		bool close_requested();
+		// Gets the time in seconds used by effects
+		double get_time() const;
 	public:
 		// Destructor for renderer.
 		~renderer() { shutdown(); }
@@ -95,9 +180,55 @@ namespace render_framework
 			return instance;
 		}
 
-		// Gets the window used by the renderer
+		// Gets the window used by the renderer.  nullptr when headless
 		GLFWwindow* get_window() { return _window; }
 
+		// Renders offscreen at the given resolution instead of opening a
+		// window, stopping after the given number of frames (0 for no
+		// limit).  Must be called before initialise
+		void set_headless(unsigned int width, unsigned int height, unsigned int frames = 0)
+		{
+			_headless = true;
+			_width = width;
+			_height = height;
+			_frame_limit = frames;
+		}
+
+		// Checks if the renderer is using an offscreen context
+		bool is_headless() const { return _headless; }
+
+		// Gets the address of an OpenGL function GLEW does not load, or
+		// nullptr if unavailable.  Needs the context to be current
+		void* get_proc_address(const char* name) const;
+
+		// Gets the number of frames rendered since initialise
+		unsigned int get_frame_count() const { return _frame_count; }
+
+		// Gets the times of recent frames, measured between end_render calls
+		const frame_timing& get_frame_timing() const { return _frame_timing; }
+
+		// Gets the counters of the work sent to OpenGL in the current frame.
+		// Complete once end_render has been called
+		const frame_stats& get_frame_stats() const { return _frame_stats; }
+
+		// Gets the counters of the current frame so framework code can add to them
+		frame_stats& edit_frame_stats() { return _frame_stats; }
+
+		// Gets the model ring.  Pooled geometry points its instance_model
+		// attribute at it
+		GLuint get_model_buffer() const { return _model_buffer; }
+
+		// Writes model matrices into consecutive slots of the model ring and
+		// returns the first slot.  Draws select the slot as their base
+		// instance, so nothing a draw in flight reads is overwritten
+		unsigned int stream_models(const glm::mat4* models, unsigned int count);
+
+		// Writes the counters of every frame from now on to a CSV file
+		bool start_stats_csv(const std::string& filename);
+
+		// Stops writing the counters and closes the CSV file
+		void stop_stats_csv() { _stats_file.close(); }
+
 		// Sets the window caption
 		void set_caption(const std::string& caption) { _caption = caption; }
 
@@ -114,10 +245,10 @@ namespace render_framework
 		unsigned int get_screen_height() const { return _height; }
 
 		// Gets the currently used camera for the renderer
-		std::shared_ptr<camera> get_camera() { return _camera; }
+		const std::shared_ptr<camera>& get_camera() const { return _camera; }
 
 		// Sets the currently used camera for the renderer
-		void set_camera(std::shared_ptr<camera> value) { _camera = value; }
+		void set_camera(const std::shared_ptr<camera>& value) { _camera = value; }
 
 		// Gets the current view matrix used by the renderer
 		glm::mat4 get_view() const { return _view; }
@@ -131,6 +262,35 @@ namespace render_framework
 		// Sets the current projection matrix used by the renderer
 		void set_projection(const glm::mat4& value) { _projection = value; }
 
+		// Gets the state tracker.  Used to query the issued and elided call counts
+		const gl_state& get_state() const { return _state; }
+
+		// Resets the issued and elided call counts of the state tracker
+		void reset_state_counters() { _state.reset_counters(); }
+
+		// Forgets the tracked OpenGL state.  Call after changing state outside the renderer
+		void invalidate_state() { _state.invalidate(); }
+
+		// Gets the main scene light
+		const std::shared_ptr<directional_light>& get_sun() const { return _sun; }
+
+		// Sets the main scene light.  Shared by every effect using the frame block
+		void set_sun(const std::shared_ptr<directional_light>& value) { _sun = value; }
+
+		// Gets the values last uploaded to the frame uniform block
+		const frame_data& get_frame_data() const { return _frame_data; }
+
+		// Gets the arena for transient data this frame.  Allocations are
+		// valid until FRAMES_IN_FLIGHT more frames have begun
+		frame_arena& get_frame_arena() { return _frame_memory.get_current(); }
+
+		// Gets the frame arenas.  Used to query their high water marks
+		const frame_memory& get_frame_memory() const { return _frame_memory; }
+
+		// Gets the stream buffer.  Changed lights and materials queue their
+		// dirty ranges with it, which are uploaded at the start of each frame
+		stream_buffer& get_stream() { return _stream; }
+
 		// Initialises the render framework
 		bool initialise();
 
@@ -157,26 +317,47 @@ namespace render_framework
 
 		// Binds a value with the renderer.
 		template <typename T>
-		bool bind(std::shared_ptr<T> value);
+		bool bind(const std::shared_ptr<T>& value);
 
 		// Binds a texture with the renderer
 		template <typename T>
-		bool bind_texture(std::shared_ptr<T> value, unsigned int index);
+		bool bind_texture(const std::shared_ptr<T>& value, unsigned int index);
 
 		// Sets a uniform on the currently bound effect
 		template <typename T>
 		bool set_uniform(const std::string& name, const T& value);
 
+		// Sets a uniform on the currently bound effect using a handle
+		template <typename T>
+		bool set_uniform(const uniform_handle& handle, const T& value);
+
 		// Sets a uniform block on the currently bound effect
 		bool set_uniform_block(const std::string& name, unsigned int buffer, int size);
+
+		// Sets a uniform block on the currently bound effect using a handle
+		bool set_uniform_block(const uniform_handle& handle, unsigned int buffer, int size);
 		
 		// Renders an object to the screen
 		template <typename T>
-		bool render(std::shared_ptr<T> value);
+		bool render(const std::shared_ptr<T>& value);
 
 		// Renders an object to the shadow texture
 		template <typename T>
-		bool shadow_render(std::shared_ptr<T> value);
+		bool shadow_render(const std::shared_ptr<T>& value);
+
+		// Renders borrowed objects.  These avoid the reference counting of
+		// shared pointers, so are preferred in the frame loop
+		bool render(const geometry& value);
+		bool render(const mesh& value);
+		bool render(const mesh_instances& value);
+		bool render(render_queue& value);
+		bool render(const command_list& value);
+
+		// Merges command lists by key and replays them.  Must be called on
+		// the OpenGL thread once every list has finished recording
+		bool render(const command_list* lists, std::size_t count);
+		bool shadow_render(const geometry& value);
+		bool shadow_render(const mesh& value);
 	};
 
 	/*
@@ -184,7 +365,7 @@ namespace render_framework
 	an unknown / incorrect type.  Will display an error and return false.
 	*/
 	template <typename T>
-	bool renderer::bind(std::shared_ptr<T> value)
+	bool renderer::bind(const std::shared_ptr<T>& value)
 	{
 		// Display error.  Incorrect type used
 		std::cerr << "Error binding value of unknown type" << std::endl;
@@ -198,42 +379,42 @@ namespace render_framework
 	effect is bound in its place
 	*/
 	extern template
-	bool renderer::bind(std::shared_ptr<effect> value);
+	bool renderer::bind(const std::shared_ptr<effect>& value);
 
 	/*
 	Binds a frame buffer with the renderer.  The frame buffer will be used until
 	another frame buffer is bound in its place
 	*/
 	extern template
-	bool renderer::bind(std::shared_ptr<frame_buffer> value);
+	bool renderer::bind(const std::shared_ptr<frame_buffer>& value);
 
 	/*
 	Binds a depth buffer with the renderer.  The depth buffer will be used until
 	another frame buffer is bound in its place
 	*/
 	extern template
-	bool renderer::bind(std::shared_ptr<depth_buffer> value);
+	bool renderer::bind(const std::shared_ptr<depth_buffer>& value);
 
 	/*
 	Binds a shadow map with the renderer.  The shadow map will be used until 
 	another frame buffer is bound in its place.
 	*/
 	extern template
-	bool renderer::bind(std::shared_ptr<shadow_map> value);
+	bool renderer::bind(const std::shared_ptr<shadow_map>& value);
 
 	/*
 	Binds a render pass with the renderer.  The render pass will be used until
 	another render pass / frame buffer is bound in its place
 	*/
 	extern template
-	bool renderer::bind(std::shared_ptr<render_pass> value);
+	bool renderer::bind(const std::shared_ptr<render_pass>& value);
 
 	/*
 	Binds a post_process with the renderer.  The post process will be used until
 	another post process is bound in its place
 	*/
 	extern template
-	bool renderer::bind(std::shared_ptr<post_process> value);
+	bool renderer::bind(const std::shared_ptr<post_process>& value);
 
 	/*
 	Default method called when a bind texture call is made.  This is called when
@@ -241,7 +422,7 @@ namespace render_framework
 	display an error and return false.
 	*/
 	template <typename T>
-	bool renderer::bind_texture(std::shared_ptr<T> value, unsigned int index)
+	bool renderer::bind_texture(const std::shared_ptr<T>& value, unsigned int index)
 	{
 		std::cerr << "Attempted to bind texture of unknown type" << std::endl;
 		std::cerr << "Type: " << typeid(T).name() << std::endl;
@@ -252,13 +433,13 @@ namespace render_framework
 	Binds a texture at the given index.  Index is then used in a uniform binding
 	*/
 	extern template
-	bool renderer::bind_texture(std::shared_ptr<texture> value, unsigned int index);
+	bool renderer::bind_texture(const std::shared_ptr<texture>& value, unsigned int index);
 
 	/*
 	Binds a cube map at the given index.  Index is then used in a uniform binding
 	*/
 	extern template
-	bool renderer::bind_texture(std::shared_ptr<cube_map> value, unsigned int index);
+	bool renderer::bind_texture(const std::shared_ptr<cube_map>& value, unsigned int index);
 
 	/*
 	Default method called when a set uniform call is made.  This is called when
@@ -359,13 +540,100 @@ namespace render_framework
 	extern template
 	bool renderer::set_uniform(const std::string& name, const spot_light& value);
 
+	/*
+	Default method called when a set uniform call is made using a handle.  This
+	is called when an attempt to set a uniform of an unknown type is made.  Will
+	display an error and return false.
+	*/
+	template <typename T>
+	bool renderer::set_uniform(const uniform_handle& handle, const T& value)
+	{
+		// Display error messsage
+		std::cerr << "Error trying to set uniform of unknown type" << std::endl;
+		std::cerr << "Type: " << typeid(T).name() << std::endl;
+		// Return false
+		return false;
+	}
+
+	/*
+	Sets the uniform of the given handle with the int value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const int& value);
+
+	/*
+	Sets the uniform of the given handle with the double value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const double& value);
+
+	/*
+	Sets the uniform of the given handle with the float value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const float& value);
+
+	/*
+	Sets the uniform of the given handle with the unsigned int value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const unsigned int& value);
+
+	/*
+	Sets the uniform of the given handle with the vec2 value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::vec2& value);
+
+	/*
+	Sets the uniform of the given handle with the vec3 value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::vec3& value);
+
+	/*
+	Sets the uniform of the given handle with the vec4 value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::vec4& value);
+
+	/*
+	Sets the uniform of the given handle with the mat2 value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::mat2& value);
+
+	/*
+	Sets the uniform of the given handle with the mat3 value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::mat3& value);
+
+	/*
+	Sets the uniform of the given handle with the mat4 value provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const glm::mat4& value);
+
+	/*
+	Sets the uniform of the given handle with the material provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const material& value);
+
+	/*
+	Sets the uniform of the given handle with the directional light provided
+	*/
+	extern template
+	bool renderer::set_uniform(const uniform_handle& handle, const directional_light& value);
+
 	/*
 	Default method called when a render call is made.  This method is called when
 	the type of object is unknown / incorrect.  This method will display an error
 	and return false.
 	*/
 	template <typename T>
-	bool renderer::render(std::shared_ptr<T> value)
+	bool renderer::render(const std::shared_ptr<T>& value)
 	{
 		// Display error message
 		std::cerr << "Error trying to render object of unknown type" << std::endl;
@@ -378,73 +646,93 @@ namespace render_framework
 	Renders a piece of geometry to the scene
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<geometry> value);
+	bool renderer::render(const std::shared_ptr<geometry>& value);
 
 	/*
 	Renders a model to the scene
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<model> value);
+	bool renderer::render(const std::shared_ptr<model>& value);
 
 	/*
 	Renders a texture to the screen.  Assumes that the texture should take up 
 	the whole screen
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<texture> value);
+	bool renderer::render(const std::shared_ptr<texture>& value);
 
 	/*
 	Renders a skybox to the scene
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<skybox> value);
+	bool renderer::render(const std::shared_ptr<skybox>& value);
 
 	/*
 	Renders a piece of terrain to the scene
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<terrain> value);
+	bool renderer::render(const std::shared_ptr<terrain>& value);
 
 	/*
 	Renders a mesh to the scene
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<mesh> value);
+	bool renderer::render(const std::shared_ptr<mesh>& value);
 
 	/*
 	Renders a frame buffer to the screen.  Assumes that the frame buffer should
 	take up the entire screen.
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<frame_buffer> value);
+	bool renderer::render(const std::shared_ptr<frame_buffer>& value);
 
 	/*
 	Renders a depth buffer to the screen.  Assumes that the depth buffer should
 	take up the entire screen
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<depth_buffer> value);
+	bool renderer::render(const std::shared_ptr<depth_buffer>& value);
 
 	/*
 	Renders a shadow map to the screen.  Assumes that the shadow map should take
 	up the entire screen
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<shadow_map> value);
+	bool renderer::render(const std::shared_ptr<shadow_map>& value);
 
 	/*
 	Renders a render pass to the screen.  Assumes that the render pass should
 	take up the entire screen
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<render_pass> value);
+	bool renderer::render(const std::shared_ptr<render_pass>& value);
 
 	/*
 	Renders a post process to the screen.  Assumes that the post process should 
 	take up the entire screen
 	*/
 	extern template
-	bool renderer::render(std::shared_ptr<post_process> value);
+	bool renderer::render(const std::shared_ptr<post_process>& value);
+
+	/*
+	Renders every instance of a set of mesh instances in a single draw call
+	*/
+	extern template
+	bool renderer::render(const std::shared_ptr<mesh_instances>& value);
+
+	/*
+	Renders the draws in a render queue.  The queue is sorted first, and state
+	is only re-bound when it differs from the previous draw
+	*/
+	extern template
+	bool renderer::render(const std::shared_ptr<render_queue>& value);
+
+	/*
+	Replays the draws recorded in a command list.  The list must have finished
+	recording before it is rendered
+	*/
+	extern template
+	bool renderer::render(const std::shared_ptr<command_list>& value);
 
 	/*
 	Default method called when a shadow render call is made.  This method is called when
@@ -452,7 +740,7 @@ namespace render_framework
 	and return false.
 	*/
 	template <typename T>
-	bool renderer::shadow_render(std::shared_ptr<T> value)
+	bool renderer::shadow_render(const std::shared_ptr<T>& value)
 	{
 		// Display error message
 		std::cerr << "Error trying to render the shadow of an object of unknown type" << std::endl;
@@ -465,23 +753,23 @@ namespace render_framework
 	Renders the shadow of a piece of geometry to the scene
 	*/
 	extern template
-	bool renderer::shadow_render(std::shared_ptr<geometry> value);
+	bool renderer::shadow_render(const std::shared_ptr<geometry>& value);
 
 	/*
 	Renders the shadow of a model to the scene
 	*/
 	extern template
-	bool renderer::shadow_render(std::shared_ptr<model> value);
+	bool renderer::shadow_render(const std::shared_ptr<model>& value);
 
 	/*
 	Renders the shadow of a piece of terrain to the scene
 	*/
 	extern template
-	bool renderer::shadow_render(std::shared_ptr<terrain> value);
+	bool renderer::shadow_render(const std::shared_ptr<terrain>& value);
 
 	/*
 	Renders the shadow of a mesh to the scene
 	*/
 	extern template
-	bool renderer::shadow_render(std::shared_ptr<mesh> value);
+	bool renderer::shadow_render(const std::shared_ptr<mesh>& value);
 }
\ No newline at end of file
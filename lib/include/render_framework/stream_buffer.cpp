@@ -0,0 +1,251 @@
+#include "stream_buffer.h"
+#include "renderer.h"
+#include "gl_debug.h"
+#include "util.h"
+#include <algorithm>
+#include <cstring>
+
+namespace render_framework
+{
+	// Cancels any pending upload and deletes the buffer if valid
+	streamed_data::~streamed_data()
+	{
+		if (is_dirty())
+			renderer::get_instance().get_stream().cancel(this);
+		if (buffer)
+			glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+
+	/*
+	Widens the dirty range to include the given bytes.  The first change in a
+	frame adds the data to the stream buffer's upload list
+	*/
+	void streamed_data::mark_dirty(std::size_t offset, std::size_t size)
+	{
+		// Nothing to upload to until built.  build uploads everything
+		if (!buffer)
+			return;
+
+		if (!is_dirty())
+		{
+			dirty_begin = offset;
+			dirty_end = offset + size;
+			renderer::get_instance().get_stream().queue(this);
+		}
+		else
+		{
+			dirty_begin = (std::min)(dirty_begin, offset);
+			dirty_end = (std::max)(dirty_end, offset + size);
+		}
+	}
+
+	stream_buffer::stream_buffer()
+		: _buffer(0), _mapped(nullptr), _region_size(0), _region_count(1), _region(0), _offset(0), _stalls(0)
+	{
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+			_fences[i] = 0;
+	}
+
+	/*
+	Creates the ring buffer.  With ARB_buffer_storage it is mapped once for
+	the life of the buffer, otherwise the regions are staged in memory
+	*/
+	bool stream_buffer::initialise(GLsizeiptr region_size)
+	{
+		shutdown();
+		_region_size = region_size;
+		glGenBuffers(1, &_buffer);
+		glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+		gl_debug::label(GL_BUFFER, _buffer, "stream buffer");
+		if (GLEW_ARB_buffer_storage)
+		{
+			_region_count = FRAMES_IN_FLIGHT;
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_COPY_READ_BUFFER, _region_size * _region_count, nullptr, flags);
+			_mapped = static_cast<char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, _region_size * _region_count, flags));
+			if (_mapped == nullptr)
+			{
+				std::cerr << "Error - could not map stream buffer" << std::endl;
+				glBindBuffer(GL_COPY_READ_BUFFER, 0);
+				CHECK_GL_ERROR;
+				return false;
+			}
+			std::clog << "Stream buffer persistently mapped" << std::endl;
+		}
+		else
+		{
+			_region_count = 1;
+			_staging.resize(static_cast<std::size_t>(_region_size));
+			glBufferData(GL_COPY_READ_BUFFER, _region_size, nullptr, GL_STREAM_DRAW);
+			std::clog << "Stream buffer using orphaning" << std::endl;
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		_region = 0;
+		_offset = 0;
+		return !CHECK_GL_ERROR;
+	}
+
+	// Deletes the ring buffer and fences
+	void stream_buffer::shutdown()
+	{
+		for (unsigned int i = 0; i < FRAMES_IN_FLIGHT; ++i)
+		{
+			if (_fences[i])
+				glDeleteSync(_fences[i]);
+			_fences[i] = 0;
+		}
+		if (_mapped)
+		{
+			glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+			glUnmapBuffer(GL_COPY_READ_BUFFER);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			_mapped = nullptr;
+		}
+		if (_buffer)
+			glDeleteBuffers(1, &_buffer);
+		_buffer = 0;
+		_staging.clear();
+		_copies.clear();
+	}
+
+	// Adds data to the list uploaded by the next flush
+	void stream_buffer::queue(streamed_data* data)
+	{
+		_dirty.push_back(data);
+	}
+
+	// Removes data from the list uploaded by the next flush
+	void stream_buffer::cancel(streamed_data* data)
+	{
+		_dirty.erase(std::remove(_dirty.begin(), _dirty.end(), data), _dirty.end());
+	}
+
+	// Reserves space in the current region.  Returns nullptr if full
+	char* stream_buffer::stage(GLsizeiptr size, GLintptr& source_offset)
+	{
+		// Keep each write 16 byte aligned
+		GLsizeiptr start = (_offset + 15) & ~static_cast<GLsizeiptr>(15);
+		if (_buffer == 0 || start + size > _region_size)
+			return nullptr;
+		_offset = start + size;
+		if (_mapped)
+		{
+			source_offset = _region * _region_size + start;
+			return _mapped + source_offset;
+		}
+		source_offset = start;
+		return &_staging[static_cast<std::size_t>(start)];
+	}
+
+	// Copies from the ring buffer to a destination buffer
+	void stream_buffer::copy(GLuint target, GLintptr target_offset, GLintptr source_offset, GLsizeiptr size)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source_offset, target_offset, size);
+	}
+
+	/*
+	Writes the data into the current region and copies it to the buffer.  The
+	copy is ordered on the GPU after any earlier draws reading the buffer, so
+	the CPU does not wait for them
+	*/
+	bool stream_buffer::write(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+	{
+		if (!_mapped)
+			return false;
+		GLintptr source_offset;
+		char* destination = stage(size, source_offset);
+		if (destination == nullptr)
+			return false;
+		std::memcpy(destination, data, static_cast<std::size_t>(size));
+		copy(buffer, offset, source_offset, size);
+		renderer::get_instance().edit_frame_stats().bytes_uploaded += size;
+		return !CHECK_GL_ERROR;
+	}
+
+	/*
+	Uploads the dirty range of every queued piece of data, then fences the
+	region and moves on to the next.  If the next region's fence has not yet
+	signalled the GPU is more than FRAMES_IN_FLIGHT frames behind, and we have
+	to wait for it
+	*/
+	bool stream_buffer::flush()
+	{
+		frame_stats& stats = renderer::get_instance().edit_frame_stats();
+		for (auto iter = _dirty.begin(); iter != _dirty.end(); ++iter)
+		{
+			streamed_data* data = *iter;
+			GLsizeiptr size = static_cast<GLsizeiptr>(data->dirty_end - data->dirty_begin);
+			stats.bytes_uploaded += size;
+			GLintptr source_offset;
+			char* destination = stage(size, source_offset);
+			if (destination != nullptr)
+			{
+				data->copy_data(data->dirty_begin, static_cast<std::size_t>(size), destination);
+				if (_mapped)
+					copy(data->buffer, data->dirty_begin, source_offset, size);
+				else
+				{
+					pending_copy c = { data->buffer, static_cast<GLintptr>(data->dirty_begin), source_offset, size };
+					_copies.push_back(c);
+				}
+			}
+			else
+			{
+				// The region is full.  Map the dirty range and write it
+				// directly instead
+				glBindBuffer(GL_COPY_WRITE_BUFFER, data->buffer);
+				void* range = glMapBufferRange(GL_COPY_WRITE_BUFFER, data->dirty_begin, size,
+					GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+				if (range != nullptr)
+				{
+					data->copy_data(data->dirty_begin, static_cast<std::size_t>(size), range);
+					glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+				}
+				else
+					std::cerr << "Error - could not map buffer " << data->buffer << " to upload it" << std::endl;
+			}
+			data->dirty_begin = data->dirty_end = 0;
+		}
+		_dirty.clear();
+
+		if (_mapped)
+		{
+			// Fence the region just written, then move on to the next
+			if (_offset > 0)
+				_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			_region = (_region + 1) % _region_count;
+			if (_fences[_region])
+			{
+				GLenum result = glClientWaitSync(_fences[_region], 0, 0);
+				if (result == GL_TIMEOUT_EXPIRED)
+				{
+					++_stalls;
+					do
+					{
+						result = glClientWaitSync(_fences[_region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+					} while (result == GL_TIMEOUT_EXPIRED);
+				}
+				glDeleteSync(_fences[_region]);
+				_fences[_region] = 0;
+			}
+		}
+		else if (_offset > 0)
+		{
+			// Orphan the ring so the upload does not wait on last frame's copies
+			glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+			glBufferData(GL_COPY_READ_BUFFER, _region_size, nullptr, GL_STREAM_DRAW);
+			glBufferSubData(GL_COPY_READ_BUFFER, 0, _offset, &_staging[0]);
+			for (auto iter = _copies.begin(); iter != _copies.end(); ++iter)
+				copy(iter->target, iter->target_offset, iter->source_offset, iter->size);
+			_copies.clear();
+		}
+		_offset = 0;
+
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return !CHECK_GL_ERROR;
+	}
+}
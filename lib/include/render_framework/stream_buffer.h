@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <GL\glew.h>
+#include "frame_arena.h"
+
+namespace render_framework
+{
+	// Default size in bytes of each frame region of the stream buffer
+	const GLsizeiptr DEFAULT_STREAM_REGION_SIZE = 1 << 20;
+
+	/*
+	Base for data mirrored in an OpenGL buffer, such as lights and materials.
+	Changing the data only marks a byte range as dirty.  Dirty ranges are
+	collected by the renderer's stream buffer and uploaded once per frame,
+	rather than each change binding the buffer and uploading on its own
+	*/
+	struct streamed_data
+	{
+		// OpenGL ID of the buffer holding the data
+		GLuint buffer;
+		// Start of the dirty byte range
+		std::size_t dirty_begin;
+		// End of the dirty byte range.  Equal to dirty_begin when clean
+		std::size_t dirty_end;
+
+		// Creates streamed data with no buffer
+		streamed_data() : buffer(0), dirty_begin(0), dirty_end(0) { }
+
+		// Cancels any pending upload and deletes the buffer if valid
+		virtual ~streamed_data();
+
+		// Checks if any of the data needs uploading
+		bool is_dirty() const { return dirty_end != dirty_begin; }
+
+		// Marks a byte range of the buffer as changed.  Does nothing until
+		// the buffer has been built
+		void mark_dirty(std::size_t offset, std::size_t size);
+
+		// Copies a byte range of the buffer contents to the destination
+		virtual void copy_data(std::size_t offset, std::size_t size, void* destination) const = 0;
+	};
+
+	/*
+	A ring of per frame regions used to upload data to other buffers without
+	stalling.  Data is written into the current region, then copied on the
+	GPU to the destination buffer with glCopyBufferSubData.
+
+	With ARB_buffer_storage the ring is persistently mapped, and a fence is
+	placed after each frame's region so it is not overwritten while the GPU
+	may still be copying from it.  Without it, a single region is staged in
+	memory and the buffer is orphaned each frame instead.
+	*/
+	class stream_buffer
+	{
+	private:
+		// A copy from the ring to a destination buffer
+		struct pending_copy
+		{
+			GLuint target;
+			GLintptr target_offset;
+			GLintptr source_offset;
+			GLsizeiptr size;
+		};
+
+		// OpenGL ID of the ring buffer
+		GLuint _buffer;
+		// Persistent mapping of the ring.  nullptr when orphaning
+		char* _mapped;
+		// Staging memory for the region when orphaning
+		std::vector<char> _staging;
+		// Size of each region in bytes
+		GLsizeiptr _region_size;
+		// Number of regions.  FRAMES_IN_FLIGHT when mapped, 1 when orphaning
+		unsigned int _region_count;
+		// The region being written this frame
+		unsigned int _region;
+		// Bytes used in the current region
+		GLsizeiptr _offset;
+		// Fence placed after the last use of each region
+		GLsync _fences[FRAMES_IN_FLIGHT];
+		// Data with dirty ranges waiting to be uploaded
+		std::vector<streamed_data*> _dirty;
+		// Copies waiting to be issued when orphaning
+		std::vector<pending_copy> _copies;
+		// Number of times a fence had not signalled when a region was reused
+		unsigned int _stalls;
+
+		// Private copy constructor.  The stream buffer owns OpenGL objects
+		stream_buffer(const stream_buffer&);
+		// Private assignment operator
+		void operator=(const stream_buffer&);
+
+		// Reserves space in the current region.  Returns nullptr if full
+		char* stage(GLsizeiptr size, GLintptr& source_offset);
+		// Copies from the ring buffer to a destination buffer
+		void copy(GLuint target, GLintptr target_offset, GLintptr source_offset, GLsizeiptr size);
+	public:
+		// Creates an empty stream buffer.  initialise must be called first
+		stream_buffer();
+
+		// Creates the ring buffer, mapping it if possible
+		bool initialise(GLsizeiptr region_size = DEFAULT_STREAM_REGION_SIZE);
+
+		// Deletes the ring buffer and fences
+		void shutdown();
+
+		// Checks if the ring is persistently mapped
+		bool is_persistent() const { return _mapped != nullptr; }
+
+		// Gets the number of times a region was still in use when needed
+		unsigned int get_stalls() const { return _stalls; }
+
+		// Adds data to the list uploaded by the next flush
+		void queue(streamed_data* data);
+
+		// Removes data from the list uploaded by the next flush
+		void cancel(streamed_data* data);
+
+		// Copies data into part of a buffer straight away, without waiting
+		// for the GPU.  Only available when persistently mapped; returns
+		// false if the data could not be streamed
+		bool write(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+
+		// Uploads every dirty range and moves on to the next region.  Called
+		// once per frame by the renderer
+		bool flush();
+	};
+}
@@ -1,9 +1,11 @@
 #include "texture.h"
 #include "util.h"
+#include "gl_debug.h"
 
 #include <FreeImage.h>
 #include <memory>
 #include <array>
+#include <iostream>
 #include <glm\gtc\type_ptr.hpp>
 
 #pragma comment(lib, "FreeImage")
@@ -11,21 +13,54 @@
 namespace render_framework
 {
 	std::shared_ptr<texture> texture_loader::load(const std::string& name, bool mipmaps, bool anisotropic)
+	{
+		image_data image;
+		if (!decode(name, image))
+			return nullptr;
+		auto tex = load(image, mipmaps, anisotropic);
+		if (tex != nullptr)
+			gl_debug::label(GL_TEXTURE, tex->image, name);
+		return tex;
+	}
+
+	/*
+	Reads an image with FreeImage and converts it to 32 bit BGRA.  Nothing
+	here touches OpenGL, so textures can be decoded on worker threads and
+	handed to the OpenGL thread to be created
+	*/
+	bool texture_loader::decode(const std::string& name, image_data& result)
 	{
 		const char* char_name = name.c_str();
 		FREE_IMAGE_FORMAT format = FreeImage_GetFileType(char_name);
 		FIBITMAP* image = FreeImage_Load(format, char_name, 0);
+		if (image == nullptr)
+		{
+			std::cerr << "Error - could not load image " << name << std::endl;
+			return false;
+		}
 		FIBITMAP* temp = image;
 		image = FreeImage_ConvertTo32Bits(image);
 		FreeImage_Unload(temp);
         temp = image;
         image = FreeImage_Rotate(image, 180.0f);
         FreeImage_Unload(temp);
-		
-		int width = FreeImage_GetWidth(image);
-		int height = FreeImage_GetHeight(image);
 
+		result.width = FreeImage_GetWidth(image);
+		result.height = FreeImage_GetHeight(image);
+
+		// 32 bit rows are never padded, so the pixels can be copied in one go
 		GLubyte* pixel_data = FreeImage_GetBits(image);
+		result.pixels.assign(pixel_data, pixel_data + result.width * result.height * 4);
+
+		FreeImage_Unload(image);
+		return true;
+	}
+
+	/*
+	Creates an OpenGL texture from a decoded image
+	*/
+	std::shared_ptr<texture> texture_loader::load(const image_data& image, bool mipmaps, bool anisotropic)
+	{
 		GLuint id;
 		glGenTextures(1, &id);
 		glBindTexture(GL_TEXTURE_2D, id);
@@ -49,18 +84,16 @@ namespace render_framework
 			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, max_anisotropy);
 			CHECK_GL_ERROR;
 		}
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, (GLvoid*)pixel_data);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_BGRA, GL_UNSIGNED_BYTE, (GLvoid*)&image.pixels[0]);
 		CHECK_GL_ERROR;
 		if (mipmaps)
 			glGenerateMipmap(GL_TEXTURE_2D);
 
 		auto tex = std::make_shared<texture>();
-		tex->height = height;
-		tex->width = width;
+		tex->height = image.height;
+		tex->width = image.width;
 		tex->image = id;
 
-		FreeImage_Unload(image);
-
 		CHECK_GL_ERROR;
 
 		return tex;
@@ -107,6 +140,9 @@ namespace render_framework
         // Create the cube map image with OpenGL
         glGenTextures(1, &cube->image);
         CHECK_GL_ERROR;
+        // Cube maps are named after their first face
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cube->image);
+        gl_debug::label(GL_TEXTURE, cube->image, names[0]);
 
         // Bind the texture as a cube map
         glBindTexture(GL_TEXTURE_CUBE_MAP, cube->image);
@@ -58,6 +58,23 @@ namespace render_framework
 		}
 	};
 
+	/*
+	The pixels of an image read from file, ready to be given to OpenGL.
+	Decoding does not use OpenGL, so it can be done on any thread
+	*/
+	struct image_data
+	{
+		// The width of the image
+		unsigned int width;
+		// The height of the image
+		unsigned int height;
+		// The pixels in BGRA order
+		std::vector<unsigned char> pixels;
+
+		// Creates an empty image
+		image_data() : width(0), height(0) { }
+	};
+
 	/*
 	Helper class used to load textures
 	*/
@@ -68,6 +85,10 @@ namespace render_framework
 		static std::shared_ptr<texture> load(const std::string& filename, bool mipmaps = true, bool anisotropic = true);
 		// Loads a cube maps using the given array of file names
 		static std::shared_ptr<cube_map> load(const std::vector<std::string>& names, bool mipmaps = true, bool anisotropic = true);
+		// Reads and decodes an image file.  Safe to call from any thread
+		static bool decode(const std::string& filename, image_data& image);
+		// Creates a texture from a decoded image.  Must be called on the OpenGL thread
+		static std::shared_ptr<texture> load(const image_data& image, bool mipmaps = true, bool anisotropic = true);
 	};
 
 	/*
@@ -69,7 +69,7 @@ namespace render_framework
 		/*
 		Gets the 4 x 4 transformation matrix for the object.
 		*/
-		glm::mat4 get_transform_matrix()
+		glm::mat4 get_transform_matrix() const
 		{
 			// Create translation matrix
 			glm::mat4 matrix = glm::translate(glm::mat4(1.0f), position);
@@ -87,7 +87,7 @@ namespace render_framework
 		/*
 		Gets the 3 x 3 normal matrix for the object
 		*/
-		glm::mat3 get_normal_matrix()
+		glm::mat3 get_normal_matrix() const
 		{
 			// The transform only uses affine matrices.  Simply return the 
 			// rotation matrix
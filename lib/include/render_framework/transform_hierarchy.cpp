@@ -0,0 +1,195 @@
+#include "transform_hierarchy.h"
+#include <iostream>
+#include <algorithm>
+#include <glm\gtc\matrix_inverse.hpp>
+
+namespace render_framework
+{
+	// Removes all the nodes
+	void transform_hierarchy::clear()
+	{
+		_local.clear();
+		_parent.clear();
+		_local_matrix.clear();
+		_world_matrix.clear();
+		_dirty.clear();
+		_changed.clear();
+		_first_dirty = 0;
+		_previous.clear();
+		_render_matrix.clear();
+		_moved.clear();
+		_interpolated.clear();
+		_render_changed.clear();
+		_first_moved = 0;
+		_first_interpolated = 0;
+	}
+
+	// Reserves storage for the given number of nodes
+	void transform_hierarchy::reserve(std::size_t count)
+	{
+		_local.reserve(count);
+		_parent.reserve(count);
+		_local_matrix.reserve(count);
+		_world_matrix.reserve(count);
+		_dirty.reserve(count);
+		_changed.reserve(count);
+		_previous.reserve(count);
+		_render_matrix.reserve(count);
+		_moved.reserve(count);
+		_interpolated.reserve(count);
+		_render_changed.reserve(count);
+	}
+
+	/*
+	Adds a node.  Parents must be created before their children so that the
+	update pass always reaches a parent first
+	*/
+	unsigned int transform_hierarchy::create(const transform& local, unsigned int parent)
+	{
+		unsigned int node = static_cast<unsigned int>(_local.size());
+		if (parent != NO_PARENT && parent >= node)
+		{
+			std::cerr << "Error - transform parent " << parent << " does not exist" << std::endl;
+			std::cerr << "Node " << node << " created at the root" << std::endl;
+			parent = NO_PARENT;
+		}
+
+		_local.push_back(local);
+		_parent.push_back(parent);
+		_local_matrix.push_back(glm::mat4(1.0f));
+		_world_matrix.push_back(glm::mat4(1.0f));
+		_dirty.push_back(1);
+		_changed.push_back(0);
+		_previous.push_back(local);
+		_render_matrix.push_back(glm::mat4(1.0f));
+		_moved.push_back(0);
+		_interpolated.push_back(0);
+		_render_changed.push_back(0);
+		if (node < _first_dirty)
+			_first_dirty = node;
+
+		return node;
+	}
+
+	/*
+	Gets the local transform of a node for editing.  Marks it as dirty.  The
+	lowest dirty node is lowered with a compare and swap, so props on other
+	threads can edit their own nodes at the same time
+	*/
+	transform& transform_hierarchy::edit_local(unsigned int node)
+	{
+		_dirty[node] = 1;
+		unsigned int first = _first_dirty.load();
+		while (node < first && !_first_dirty.compare_exchange_weak(first, node))
+			;
+		return _local[node];
+	}
+
+	/*
+	Walks the nodes in storage order.  As parents come before children, a
+	parent's world matrix is always final by the time its children are
+	reached.  Nodes before the first dirty node cannot have changed
+	*/
+	std::size_t transform_hierarchy::update()
+	{
+		unsigned int count = static_cast<unsigned int>(_local.size());
+		++_pass;
+		if (_first_dirty >= count)
+			return 0;
+
+		std::size_t updated = 0;
+		for (unsigned int i = _first_dirty; i < count; ++i)
+		{
+			unsigned int parent = _parent[i];
+			bool parent_changed = parent != NO_PARENT && _changed[parent] == _pass;
+			if (!_dirty[i] && !parent_changed)
+				continue;
+
+			// Only rebuild the local matrix if the local transform changed
+			if (_dirty[i])
+			{
+				_local_matrix[i] = _local[i].get_transform_matrix();
+				_dirty[i] = 0;
+				_moved[i] = 1;
+				if (i < _first_moved)
+					_first_moved = i;
+			}
+
+			if (parent == NO_PARENT)
+				_world_matrix[i] = _local_matrix[i];
+			else
+				_world_matrix[i] = _world_matrix[parent] * _local_matrix[i];
+			_render_matrix[i] = _world_matrix[i];
+			_changed[i] = _pass;
+			++updated;
+		}
+
+		_first_dirty = count;
+		return updated;
+	}
+
+	/*
+	Copies the local transforms and clears the moved flags.  Call at the start
+	of each simulation step, before any node is edited
+	*/
+	void transform_hierarchy::save_previous()
+	{
+		_previous = _local;
+		for (unsigned int i = _first_moved; i < _moved.size(); ++i)
+			_moved[i] = 0;
+		_first_moved = static_cast<unsigned int>(_local.size());
+	}
+
+	/*
+	Walks the nodes in storage order, like update.  Nodes which moved in the
+	last step get a local matrix blended from their previous and current
+	transforms, and their children follow them.  Nodes interpolated by the
+	last call which no longer need it are put back to their world matrix
+	*/
+	void transform_hierarchy::interpolate(float alpha)
+	{
+		unsigned int count = static_cast<unsigned int>(_local.size());
+		unsigned int first = (std::min)(_first_moved, _first_interpolated);
+		unsigned int next_first = count;
+		++_render_pass;
+
+		for (unsigned int i = first; i < count; ++i)
+		{
+			unsigned int parent = _parent[i];
+			bool parent_changed = parent != NO_PARENT && _render_changed[parent] == _render_pass;
+			if (!_moved[i] && !parent_changed && !_interpolated[i])
+				continue;
+
+			glm::mat4 local = _local_matrix[i];
+			if (_moved[i])
+			{
+				transform blend;
+				blend.position = glm::mix(_previous[i].position, _local[i].position, alpha);
+				blend.orientation = glm::slerp(_previous[i].orientation, _local[i].orientation, alpha);
+				blend.scale = glm::mix(_previous[i].scale, _local[i].scale, alpha);
+				local = blend.get_transform_matrix();
+			}
+
+			if (parent == NO_PARENT)
+				_render_matrix[i] = local;
+			else
+				_render_matrix[i] = _render_matrix[parent] * local;
+			_render_changed[i] = _render_pass;
+
+			_interpolated[i] = _moved[i] || parent_changed;
+			if (_interpolated[i] && i < next_first)
+				next_first = i;
+		}
+
+		_first_interpolated = next_first;
+	}
+
+	/*
+	Gets the normal matrix a node is rendered with.  Parents may scale their
+	children, so the inverse transpose is used rather than just the rotation
+	*/
+	glm::mat3 transform_hierarchy::get_normal_matrix(unsigned int node) const
+	{
+		return glm::inverseTranspose(glm::mat3(_render_matrix[node]));
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <glm\glm.hpp>
+#include "transform.h"
+
+namespace render_framework
+{
+	/*
+	A parent / child hierarchy of transforms.  Each node holds a local
+	transform relative to its parent, and caches both its local matrix and
+	its world matrix (the parent's world matrix multiplied by the local one).
+
+	Nodes are stored in contiguous arrays, and a parent is always stored
+	before its children.  update can therefore recalculate every world matrix
+	in a single forward pass, and only nodes whose local transform changed,
+	or whose parent's world matrix changed, are recalculated.
+
+	Different nodes can be edited from several threads at once, as long as
+	nodes are not created and update is not called at the same time.
+
+	For fixed step simulations, save_previous is called at the start of each
+	step and interpolate before rendering.  This blends the local transforms
+	of the nodes that moved during the last step into separate render
+	matrices, leaving the world matrices at the simulated state.
+	*/
+	class transform_hierarchy
+	{
+	public:
+		// Parent value of a node at the root of the hierarchy
+		static const unsigned int NO_PARENT = 0xFFFFFFFF;
+	private:
+		// Local transform of each node
+		std::vector<transform> _local;
+		// Parent of each node, or NO_PARENT
+		std::vector<unsigned int> _parent;
+		// Cached local matrix of each node
+		std::vector<glm::mat4> _local_matrix;
+		// Cached world matrix of each node
+		std::vector<glm::mat4> _world_matrix;
+		// Flag set on each node whose local transform has changed
+		std::vector<std::uint8_t> _dirty;
+		// The update pass in which the world matrix of each node last changed
+		std::vector<std::uint32_t> _changed;
+		// Number of update passes performed
+		std::uint32_t _pass;
+		// Lowest dirty node.  Nodes before this need not be visited
+		std::atomic<unsigned int> _first_dirty;
+		// Local transform of each node at the start of the last step
+		std::vector<transform> _previous;
+		// Matrix each node is rendered with.  Equal to the world matrix
+		// unless interpolated
+		std::vector<glm::mat4> _render_matrix;
+		// Flag set on each node whose local matrix changed since save_previous
+		std::vector<std::uint8_t> _moved;
+		// Flag set on each node whose render matrix was last interpolated
+		std::vector<std::uint8_t> _interpolated;
+		// The interpolate pass in which the render matrix of each node last changed
+		std::vector<std::uint32_t> _render_changed;
+		// Number of interpolate passes performed
+		std::uint32_t _render_pass;
+		// Lowest moved node
+		unsigned int _first_moved;
+		// Lowest node whose render matrix is interpolated
+		unsigned int _first_interpolated;
+	public:
+		// Creates an empty hierarchy
+		transform_hierarchy() : _pass(0), _first_dirty(0), _render_pass(0), _first_moved(0), _first_interpolated(0) { }
+
+		// Removes all the nodes
+		void clear();
+
+		// Reserves storage for the given number of nodes
+		void reserve(std::size_t count);
+
+		// Adds a node.  The parent must already exist.  Returns the new node
+		unsigned int create(const transform& local = transform(), unsigned int parent = NO_PARENT);
+
+		// Gets the number of nodes
+		std::size_t size() const { return _local.size(); }
+
+		// Gets the parent of a node
+		unsigned int get_parent(unsigned int node) const { return _parent[node]; }
+
+		// Gets the local transform of a node
+		const transform& get_local(unsigned int node) const { return _local[node]; }
+
+		// Gets the local transform of a node for editing.  Marks it as dirty.
+		// Safe to call for different nodes on different threads
+		transform& edit_local(unsigned int node);
+
+		// Replaces the local transform of a node
+		void set_local(unsigned int node, const transform& value) { edit_local(node) = value; }
+
+		// Recalculates the matrices of dirty nodes and their children.
+		// Returns the number of world matrices recalculated
+		std::size_t update();
+
+		// Records the local transforms at the start of a simulation step
+		void save_previous();
+
+		// Blends the nodes that moved in the last step between their previous
+		// and current local transforms, and recalculates the render matrices.
+		// alpha is the fraction of a step since the last step (0 to 1)
+		void interpolate(float alpha);
+
+		// Gets the cached local matrix of a node
+		const glm::mat4& get_local_matrix(unsigned int node) const { return _local_matrix[node]; }
+
+		// Gets the cached world matrix of a node, as of the last update
+		const glm::mat4& get_world_matrix(unsigned int node) const { return _world_matrix[node]; }
+
+		// Gets the world position of a node, as of the last update
+		glm::vec3 get_world_position(unsigned int node) const { return glm::vec3(_world_matrix[node][3]); }
+
+		// Gets the matrix a node is rendered with, as of the last update or interpolate
+		const glm::mat4& get_render_matrix(unsigned int node) const { return _render_matrix[node]; }
+
+		// Gets the position a node is rendered at
+		glm::vec3 get_render_position(unsigned int node) const { return glm::vec3(_render_matrix[node][3]); }
+
+		// Gets the normal matrix a node is rendered with
+		glm::mat3 get_normal_matrix(unsigned int node) const;
+
+		// Checks if the world matrix of a node changed during the last update
+		bool changed(unsigned int node) const { return _changed[node] == _pass; }
+	};
+}
@@ -1,6 +1,7 @@
 #pragma comment(lib, "Glu32")
 
 #include "util.h"
+#include "gl_debug.h"
 #define GLFW_INCLUDE_GLU
 #include <GL\glfw3.h>
 #include <iostream>
@@ -16,6 +17,10 @@ namespace render_framework
 
 	bool get_GL_error(int line, const std::string& file)
 	{
+		// The debug callback reports errors itself.  Only synchronous errors
+		// can be tied to the line being checked
+		if (gl_debug::is_active())
+			return gl_debug::get_instance().take_error();
 		GLenum error = glGetError();
 		if (error)
 		{
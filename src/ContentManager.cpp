@@ -10,6 +10,7 @@
 bool ContentManager::initialize()
 {
     path = "proplist.csv";
+    _loaded = false;
 
     if (!load_skybox()) {
         cout << "Skybox failed to load" << '\n';
@@ -20,6 +21,13 @@ bool ContentManager::initialize()
         return false;
     }
 
+    // Create the geometry pool before any props are loaded into it
+    pool = make_shared<geometry_pool>();
+    if (!pool->initialise()) {
+        cout << "Geometry pool failed to initialise" << '\n';
+        return false;
+    }
+
     if (!load_props()) {
         cout << "Props failed to load" << '\n';
         return false;
@@ -106,13 +114,35 @@ bool ContentManager::load_skybox() {
     sky_box->eff = make_shared<effect>();
     sky_box->eff->add_shader("sky_box.vert", GL_VERTEX_SHADER);
     sky_box->eff->add_shader("sky_box.frag", GL_FRAGMENT_SHADER);
-    if (!effect_loader::build_effect(sky_box->eff)){
+    if (!content_manager::get_instance().build_shared(sky_box->eff)){
         return false;
     }
 
     return true;
 } // load_skybox()
 
+/* parse_model_job : Job parsing a model
+ *
+ * Runs ContentManager::parse_model on a job thread
+ */
+static void parse_model_job(const job& value)
+{
+    auto load = static_cast<model_load*>(value.data);
+    load->loaded = ContentManager::get_instance().parse_model(*load);
+} // parse_model_job()
+
+/* finish_model_job : Job finishing a model
+ *
+ * Runs ContentManager::finish_model on the main thread once parsed
+ */
+static void finish_model_job(const job& value)
+{
+    auto load = static_cast<model_load*>(value.data);
+    if (load->loaded) {
+        load->loaded = ContentManager::get_instance().finish_model(*load);
+    }
+} // finish_model_job()
+
 /* load_props : loads the props for the scene
  *
  * Loads Earth, Sputnik, Moon and Sun for the scene
@@ -124,23 +154,37 @@ bool ContentManager::load_props()
     moon = Moon();
     sol = Sol();
 
-    // Load Earth
-    if (!load_model(&earth, earth.get_path())) {
-        return false;
-    }
-    // Load Sputnik
-    if (!load_model(&sputnik, sputnik.get_path())) {
-       return false;
-    }
-
-    // Load Moon
-    if (!load_model(&moon, moon.get_path())) {
-       return false;
+    // Build the hierarchy parents first.  Earth orbits Sol, and the Moon
+    // and Sputnik orbit Earth
+    transforms = make_shared<transform_hierarchy>();
+    sol.attach(transforms, transform_hierarchy::NO_PARENT);
+    earth.attach(transforms, sol.get_node());
+    moon.attach(transforms, earth.get_node());
+    sputnik.attach(transforms, earth.get_node());
+
+    // Parse the models on the job threads.  Each model is finished on this
+    // thread as soon as it has been parsed, while the others carry on.  The
+    // loads are kept until their effects are built, so are not resized
+    // once the jobs start
+    Prop* props[] = { &earth, &sputnik, &moon, &sol };
+    const int count = sizeof(props) / sizeof(props[0]);
+    _loads.clear();
+    _loads.resize(count);
+    job_counter parsed[count];
+    job_counter finished;
+    int i;
+    for (i = 0; i < count; ++i) {
+        _loads[i].prop = props[i];
+        _loads[i].path = props[i]->get_path();
+        job_system::get_instance().run(parse_model_job, &_loads[i], &parsed[i]);
+        job_system::get_instance().run_on_main(finish_model_job, &_loads[i], &finished, &parsed[i]);
     }
+    job_system::get_instance().wait(finished);
 
-    // Load Sol
-    if (!load_model(&sol, sol.get_path())) {
-       return false;
+    for (i = 0; i < count; ++i) {
+        if (!_loads[i].loaded) {
+            return false;
+        }
     }
 
     // Add Earth meshes
@@ -152,19 +196,58 @@ bool ContentManager::load_props()
     // Add Sun meshes
     register_prop(&sol);
 
+    // Calculate the initial world matrices
+    transforms->update();
+
     return true;
 } // load_props()
 
 /* load_model : Loads the meshs for a Prop
  * 
- * Uses tinyobj to load the models from their .obj file
- * then assigns the values extracted to the objects
+ * Parses then finishes the model on the calling thread, waiting for its
+ * effects to be built
  */
 bool ContentManager::load_model(Prop* prop, string modelPath)
+{
+    model_load load;
+    load.prop = prop;
+    load.path = modelPath;
+    return parse_model(load) && finish_model(load) &&
+           _effect_batch.finish() && finish_materials(load);
+} // load_model()
+
+/* make_material_key : Describes the content of a mesh material
+ *
+ * Covers the effect (the Prop's shaders and the features chosen for the
+ * material), the material values and the texture files.  The material's
+ * name is left out, so identically set up materials share a key
+ */
+static string make_material_key(Prop* prop, const tinyobj::material_t& value)
+{
+    ostringstream key;
+    key.precision(9);
+    key << prop->get_vert_path() << '|' << prop->get_frag_path() << '|'
+        << prop->get_features(value.name);
+    for (int i = 0; i < 3; ++i) {
+        key << '|' << value.emission[i] << ',' << value.diffuse[i] << ','
+            << value.specular[i];
+    }
+    key << '|' << value.transmittance[0] << '|' << value.shininess
+        << '|' << value.diffuse_texname << '|' << value.normal_texname
+        << '|' << value.specular_texname;
+    return key.str();
+} // make_material_key()
+
+/* parse_model : Reads the meshs for a Prop
+ * 
+ * Uses tinyobj to load the models from their .obj file, then copies
+ * the values extracted into each mesh's geometry and decodes the
+ * textures.  Nothing here uses OpenGL, so it can run on any thread
+ */
+bool ContentManager::parse_model(model_load& load)
 {
     // Load .OBJ
-    vector<tinyobj::shape_t> shapes;
-    string err = tinyobj::LoadObj(shapes, modelPath.c_str());
+    string err = tinyobj::LoadObj(load.shapes, load.path.c_str());
 
     // If an error occured stop
     if (!err.empty()) {
@@ -172,73 +255,203 @@ bool ContentManager::load_model(Prop* prop, string modelPath)
         return false;
     }
 
+    load.meshes.resize(load.shapes.size());
+    load.material_keys.resize(load.shapes.size());
+    load.diffuse.resize(load.shapes.size());
+    load.normal.resize(load.shapes.size());
     unsigned int i;
-    for (i=0; i < shapes.size(); ++i) {
+    for (i=0; i < load.shapes.size(); ++i) {
         // Create mesh
         shared_ptr<mesh> model = make_shared<mesh>();
         model->geom = make_shared<geometry>();
 
-        tinyobj::shape_t* shape = &shapes[i];
+        tinyobj::shape_t* shape = &load.shapes[i];
         load_vertices(shape, model.get());
         load_normals(shape, model.get());
         load_texcoords(shape, model.get());
         load_indices(shape, model.get());
-        
-        // Initialise all loaded geometry data
-        geometry_builder::initialise_geometry(model->geom);
-
-        // Created effect for mesh
-        auto eff = make_shared<effect>();
-        if (prop->get_name() == "Earth") {
-            eff->add_shader(shape->material.name + ".vert", GL_VERTEX_SHADER);
-            eff->add_shader(shape->material.name + ".frag", GL_FRAGMENT_SHADER);
+        load.meshes[i] = model;
+
+        // Shapes with the same material as an earlier shape share its
+        // material, so their textures are never used
+        load.material_keys[i] = make_material_key(load.prop, shape->material);
+        if (find(load.material_keys.begin(), load.material_keys.begin() + i,
+                 load.material_keys[i]) != load.material_keys.begin() + i) {
+            continue;
+        }
+
+        // Decode the textures
+        if (shape->material.normal_texname != "" &&
+            !texture_loader::decode(shape->material.normal_texname, load.normal[i])) {
+            return false;
+        }
+        if (!texture_loader::decode(shape->material.diffuse_texname, load.diffuse[i])) {
+            return false;
+        }
+    } // for each in shapes[]
+
+    return true;
+} // parse_model()
+
+/* feature_defines : Names of the MATERIAL_FEATURE defines in lit.vert and
+ * lit.frag, in flag order
+ */
+static const char* feature_defines[] = {
+    "NORMAL_MAP", "SPECULAR_MAP", "LOG_DEPTH", "OPAQUE"
+};
+
+/* add_feature_defines : Adds the defines for a set of features to an effect
+ *
+ * Effects with the same shaders and defines are shared, so every mesh with
+ * the same features uses one program
+ */
+static void add_feature_defines(unsigned int features, effect* eff)
+{
+    for (unsigned int i = 0; i < 4; ++i) {
+        if (features & (1u << i)) {
+            eff->add_define(feature_defines[i]);
+        }
+    }
+} // add_feature_defines()
+
+/* finish_model : Creates the OpenGL resources for a Prop
+ * 
+ * Adds the parsed geometry to the pool, submits the effects to be built
+ * and adds the meshes to the Prop.  Uses OpenGL, so must run on the main
+ * thread.  The materials are finished once the effects are built
+ */
+bool ContentManager::finish_model(model_load& load)
+{
+    Prop* prop = load.prop;
+    unsigned int i;
+    for (i=0; i < load.shapes.size(); ++i) {
+        shared_ptr<mesh> model = load.meshes[i];
+        tinyobj::shape_t* shape = &load.shapes[i];
+
+        // Copy the loaded geometry data into the shared geometry pool
+        if (!pool->add(model->geom)) {
+            return false;
+        }
+
+        // Meshes with the same material content share one material, with
+        // one buffer and one set of textures
+        auto found = _materials.find(load.material_keys[i]);
+        if (found != _materials.end()) {
+            model->mat = found->second;
         } else {
+            // Create effect for mesh.  Meshes using the same shaders share
+            // the effect built for the first of them
+            auto eff = make_shared<effect>();
             eff->add_shader(prop->get_vert_path(), GL_VERTEX_SHADER);
             eff->add_shader(prop->get_frag_path(), GL_FRAGMENT_SHADER);
-        }
-        // Build effect
-        if (!effect_loader::build_effect(eff)) {
-            return false;
+            add_feature_defines(prop->get_features(shape->material.name), eff.get());
+            // Submit effect.  It is built alongside the other props' effects
+            if (!content_manager::get_instance().build_shared(eff, &_effect_batch)) {
+                return false;
+            }
+
+            // Create material and add effect
+            model->mat = make_shared<material>();
+            model->mat->effect = eff;
+
+            // Eye position and lighting come from the renderer's frame
+            // uniform block, so they are not set per material
+            load_shader_data(shape, model.get());
+            _materials[load.material_keys[i]] = model->mat;
         }
 
-        // Create material and add effect
-        model->mat = make_shared<material>();
-        model->mat->effect = eff;
-        
-        load_shader_data(shape, model.get());
+        // Position and rotation are held by the prop node, so the mesh
+        // node only needs the scale.  lit.vert transforms normals by the
+        // model matrix itself, which is only correct for a uniform scale
+        render_framework::transform local;
+        local.scale = prop->get_scale();
+        assert(local.scale.x == local.scale.y && local.scale.y == local.scale.z);
+        model->hierarchy = transforms;
+        model->node = transforms->create(local, prop->get_node());
+
+        // Materials without FEATURE_OPAQUE are blended, so must be drawn
+        // after the opaque meshes
+        unsigned int features = prop->get_features(shape->material.name);
+        prop->add_mesh(model.get(), (features & FEATURE_OPAQUE) ? LAYER_OPAQUE : LAYER_TRANSPARENT);
+    } // for each in shapes[]
 
-        // Set "eye position" and lighting for shader
-        model->mat->set_uniform_value("eye_position", CameraManager::get_instance().currentCamera->get_position());
-        model->mat->set_uniform_value("directional_light", SceneManager::get_instance().light);
+    return true;
+} // finish_model()
+
+/* finish_materials : Sets up the materials of a Prop
+ *
+ * Loads the textures into each material and builds it.  Textures are set
+ * by uniform name, so the material's effect must have been built
+ */
+bool ContentManager::finish_materials(model_load& load)
+{
+    unsigned int i;
+    for (i=0; i < load.shapes.size(); ++i) {
+        shared_ptr<mesh> model = load.meshes[i];
+        tinyobj::shape_t* shape = &load.shapes[i];
+
+        // Materials shared with an earlier mesh are already built
+        if (model->mat->buffer) {
+            continue;
+        }
 
         if (shape->material.normal_texname != "") {
-            auto tex_normal = texture_loader::load(shape->material.normal_texname);
+            auto tex_normal = texture_loader::load(load.normal[i]);
             model->mat->set_texture("normal_map", tex_normal);
-            model->mat->set_uniform_value("light_direction", SceneManager::get_instance().light->data.direction);
         }
 
+        // The specular map has always been read from the normal map's file
         if (shape->material.specular_texname != "") {
-            auto tex_specular = texture_loader::load(shape->material.normal_texname);
+            auto tex_specular = texture_loader::load(load.normal[i]);
             model->mat->set_texture("specular_map", tex_specular);
         }
 
-        auto tex = texture_loader::load(shape->material.diffuse_texname);
+        auto tex = texture_loader::load(load.diffuse[i]);
         model->mat->set_texture("tex", tex);
         // build material
         if (!model->mat->build()) {
             return false;
         }
+    } // for each in shapes[]
 
-        model->trans.scale = prop->get_scale();
-        quat rot(prop->get_rotation());
-        model->trans.orientation = model->trans.orientation * rot;
-        model->trans.position = prop->get_position();
+    return true;
+} // finish_materials()
 
-        prop->add_mesh(model.get());
-    } // for each in shapes[]
+/* poll_loading : Finishes loading the props once their effects are built
+ *
+ * Moves the effect batch on without waiting.  Once every effect is built
+ * the materials are set up and the loads released
+ */
+bool ContentManager::poll_loading()
+{
+    if (_loads.empty()) {
+        return true;
+    }
+    if (!_effect_batch.poll()) {
+        return false;
+    }
 
+    _loaded = _effect_batch.get_failed() == 0;
+    for (size_t i = 0; i < _loads.size() && _loaded; ++i) {
+        _loaded = finish_materials(_loads[i]);
+    }
+    _loads.clear();
+    _effect_batch = effect_batch();
+
+    cout << content_manager::get_instance().shared_effect_count() << " effects built" << '\n';
     return true;
-} // load_model()
+} // poll_loading()
+
+/* finish_loading : Waits for the props to finish loading
+ *
+ * Returns false if any prop failed to load
+ */
+bool ContentManager::finish_loading()
+{
+    _effect_batch.finish();
+    poll_loading();
+    return _loaded;
+} // finish_loading()
 
 /** load_vertices : Loads vertices from shape
  *
@@ -347,20 +560,44 @@ void ContentManager::load_shader_data(tinyobj::shape_t * shape, mesh * model)
  */
 void ContentManager::shutdown()
 {
+    _materials.clear();
     _running = false;
 } // shutdown()
 
 /* update : Updates all tracked objects
  * 
- * Updates objects in the proplist
+ * Steps objects in the proplist forward by deltaTime seconds, keeping the
+ * transforms they started the step with for interpolation
  */
 void ContentManager::update(float deltaTime)
 {
-    for each (Prop* ptr_p in prop_list) {
-        ptr_p->update();
-    }
+    transforms->save_previous();
+
+    // Props only edit their own transforms, so are updated across the job
+    // threads
+    vector<Prop*>& props = prop_list;
+    job_system::get_instance().parallel_for(props.size(), 1, [&props, deltaTime](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            PROFILE_ZONE(props[i]->get_name().c_str());
+            props[i]->orbit(deltaTime);
+            props[i]->update(deltaTime);
+        }
+    });
+
+    // Recalculate the world matrices of anything that moved
+    transforms->update();
 } // update(float deltaTime)
 
+/* interpolate : Blends tracked objects between steps
+ * 
+ * Moves the rendered transforms of objects alpha of the way from where they
+ * were before the last update to where they are now
+ */
+void ContentManager::interpolate(float alpha)
+{
+    transforms->interpolate(alpha);
+} // interpolate(float alpha)
+
 /* prop_list_size : Returns the size of prop_list
 * 
 * returns the size of prop_list
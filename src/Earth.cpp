@@ -6,10 +6,12 @@ Earth::Earth(void)
 {
 	name = "Earth";
 	path = "Earth.obj";
-	vert = "Earth.vert";
-	frag = "Earth.frag";
+	vert = "lit.vert";
+	frag = "lit.frag";
 	//position = vec3(1.52097701e8, 0, 0);
-	position = vec3(0.0,  0.0,  0.0);
+	// Relative to Sol.  Earth does not orbit, as moving it away from the
+	// origin loses precision for Sputnik
+	position = vec3(0.9e8,  0.0,  -0.9e8);
 	//velocity = vec3((float) 29.78e3, (float) 0, (float) 0);
 	velocity = vec3(0.0,  0.0,  0.0);
 	rotation = vec3(0.0,  0.0,  0.0);
@@ -21,12 +23,25 @@ Earth::~Earth(void)
 {
 }
 
-void Earth::update(void)
+void Earth::update(float deltaTime)
 {
-	update_clouds();
+	update_clouds(deltaTime);
 }
 
-void Earth::update_clouds(void)
+void Earth::update_clouds(float deltaTime)
 {
-	models.at(clouds).trans.rotate(vec3(0.0, pi<float>(), 0.0) * (float) 5.0e-5);
+	// Clouds drift at 3.0e-3 pi radians per second
+	edit_mesh_transform(clouds).rotate(vec3(0.0, pi<float>(), 0.0) * (float) 3.0e-3 * deltaTime);
+}
+
+/* get_features : Returns the shader features for a material
+ *
+ * The surface is normal and specular mapped.  Clouds and atmosphere are
+ * blended over it, so keep their alpha
+ */
+unsigned int Earth::get_features(const string& material_name)
+{
+	if (material_name == "Earth")
+		return FEATURE_NORMAL_MAP | FEATURE_SPECULAR_MAP | FEATURE_LOG_DEPTH;
+	return FEATURE_LOG_DEPTH;
 }
\ No newline at end of file
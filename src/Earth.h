@@ -22,9 +22,11 @@ public:
 	~Earth(void);
 
 	// Updated model
-	virtual void update(void);
+	virtual void update(float deltaTime);
 	// Update Clouds
-	void update_clouds(void);
+	void update_clouds(float deltaTime);
+	// Get the shader features for a material
+	virtual unsigned int get_features(const string& material_name);
 private:
 	static const double mass;
 	vec3 velocity;
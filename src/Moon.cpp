@@ -6,20 +6,22 @@ Moon::Moon(void)
 {
 	name = "Moon";
 	path = "Moon.obj";
-	vert = "Moon.vert";
-	frag = "Moon.frag";
+	vert = "lit.vert";
+	frag = "lit.frag";
 	//position = vec3(-384399e3, 0.0, -384399e3);
 	position = vec3(-384399.0, 0.0, -384399.0);
 	//velocity = vec3(29.78e3, 0.0, 0.0);
 	velocity = vec3(0.0, 0.0, 0.0);
 	rotation = vec3(0.0, 0.0, 0.0);
 	scale    = vec3(60.0, 60.0, 60.0);
+	// One orbit of Earth every 27.32 days
+	orbit_rate = 2.6617e-6f;
 }
 
 Moon::~Moon(void)
 {
 }
 
-void Moon::update(void)
+void Moon::update(float deltaTime)
 {
 }
\ No newline at end of file
@@ -15,7 +15,7 @@ public:
 	~Moon(void);
 
 	// Updated model
-	virtual void update(void);
+	virtual void update(float deltaTime);
 
 private:
 	static const double mass;
@@ -4,7 +4,7 @@
  *
  * Allows Prop to be created and initialised at a later point
  */
-Prop::Prop(void) { }
+Prop::Prop(void) : orbit_rate(0.0f), hierarchy(nullptr), orbit_node(0), node(0) { }
 
 /* ~Prop : Destructs the prop
  *
@@ -17,22 +17,35 @@ Prop::~Prop(void)
 
 /* get_mesh : Returns Prop model
  *
- * Returns the data structure the represents the model
+ * Returns a reference to the data structure the represents the model, so no
+ * copy is made
  */
-mesh Prop::get_mesh(int i)
+const mesh& Prop::get_mesh(int i)
 {
 	return models.at(i);
 } // get_mesh()
 
 /* add_mesh : Adds mesh to prop
  *
- * Takes a ptr to a mesh and adds it to the vector of meshes for model
+ * Takes a ptr to a mesh and adds it to the vector of meshes for model,
+ * along with the layer it is rendered in
  */
-void Prop::add_mesh(mesh* mesh)
+void Prop::add_mesh(mesh* mesh, RENDER_LAYER layer)
 {
 	models.push_back(*mesh);
+	layers.push_back(layer);
 } // add_mesh()
 
+/* get_layer : Returns the render layer of a mesh
+ *
+ * Blended meshes are in LAYER_TRANSPARENT, so they are drawn back to front
+ * after every opaque mesh
+ */
+RENDER_LAYER Prop::get_layer(int i)
+{
+	return layers.at(i);
+} // get_layer()
+
 /* get_path : Returns path of the .OBJ file
  *
  * returns a string containing the path for props .OBJ file
@@ -60,6 +73,16 @@ string Prop::get_frag_path()
 	return frag;
 } // get_frag_path()
 
+/* get_features : Returns the shader features for a material
+ *
+ * Props are opaque and use logarithmic depth.  Props with other materials
+ * override this
+ */
+unsigned int Prop::get_features(const string& material_name)
+{
+	return FEATURE_LOG_DEPTH | FEATURE_OPAQUE;
+} // get_features()
+
 /* get_position : Returns Prop position
  * 
  * Returns vec3 position
@@ -96,7 +119,72 @@ int Prop::mesh_size()
 	return models.size();
 }
 
-string Prop::get_name()
+/* attach : Attach Prop to a transform hierarchy
+ *
+ * Creates an orbit node on the parent, then the Prop node under it holding
+ * the Prop position and rotation.  Positions are relative to the parent.
+ * Mesh nodes are created as children of the Prop node.
+ */
+void Prop::attach(shared_ptr<transform_hierarchy> transforms, unsigned int parent)
+{
+	hierarchy = transforms;
+	orbit_node = hierarchy->create(render_framework::transform(), parent);
+
+	render_framework::transform local;
+	local.position = position;
+	local.orientation = quat(rotation);
+	node = hierarchy->create(local, orbit_node);
+} // attach()
+
+/* get_node : Get Prop node
+ *
+ * Returns the node holding the Prop transform
+ */
+unsigned int Prop::get_node()
+{
+	return node;
+} // get_node()
+
+/* get_world_position : Get Prop world position
+ *
+ * Returns the position of the Prop node as of the last hierarchy update
+ */
+vec3 Prop::get_world_position()
+{
+	return hierarchy->get_world_position(node);
+} // get_world_position()
+
+/* get_render_position : Get Prop render position
+ *
+ * Returns the position the Prop node is rendered at, interpolated between
+ * the last two updates
+ */
+vec3 Prop::get_render_position()
+{
+	return hierarchy->get_render_position(node);
+} // get_render_position()
+
+/* edit_mesh_transform : Edit mesh transform
+ *
+ * Returns the local transform of mesh i, marking it to be recalculated
+ */
+render_framework::transform& Prop::edit_mesh_transform(int i)
+{
+	return hierarchy->edit_local(models.at(i).node);
+} // edit_mesh_transform()
+
+/* orbit : Orbit Prop around its parent
+ *
+ * Rotates the orbit node, carrying the Prop and its meshes around the parent
+ */
+void Prop::orbit(float deltaTime)
+{
+	if (orbit_rate != 0.0f) {
+		hierarchy->edit_local(orbit_node).rotate(orbit_rate * deltaTime, vec3(0.0f, 1.0f, 0.0f));
+	}
+} // orbit()
+
+const string& Prop::get_name()
 {
 	return name;
 }
\ No newline at end of file
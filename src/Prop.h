@@ -14,6 +14,16 @@ using namespace std;
 using namespace glm;
 using namespace render_framework;
 
+// Optional parts of the prop shaders.  Each is a #define in lit.vert and
+// lit.frag, so each combination used is built as its own program
+enum MATERIAL_FEATURE
+{
+	FEATURE_NORMAL_MAP = 1 << 0,	// Lighting uses the normal_map texture
+	FEATURE_SPECULAR_MAP = 1 << 1,	// Specular light is scaled by specular_map
+	FEATURE_LOG_DEPTH = 1 << 2,		// Writes logarithmic depth
+	FEATURE_OPAQUE = 1 << 3			// Ignores texture and material alpha
+};
+
 class Prop
 {
 public:
@@ -24,14 +34,17 @@ public:
 	~Prop(void);
 
 	// Functions
-	// Update Prop
-	virtual void update(void) = 0;
+	// Update Prop by a step of deltaTime seconds
+	virtual void update(float deltaTime) = 0;
 	
 	// Get Prop model
-	mesh get_mesh(int i);
+	const mesh& get_mesh(int i);
 	
 	// Set Prop model
-	void add_mesh(mesh* mesh);
+	void add_mesh(mesh* mesh, RENDER_LAYER layer = LAYER_OPAQUE);
+
+	// Get the render layer of a mesh
+	RENDER_LAYER get_layer(int i);
 	
 	// Get path
 	string get_path();
@@ -42,6 +55,9 @@ public:
 	// Get fragment shader path
 	string get_frag_path();
 
+	// Get the MATERIAL_FEATURE flags for a material
+	virtual unsigned int get_features(const string& material_name);
+
 	// Get Prop position
 	vec3 get_position();
 
@@ -53,9 +69,27 @@ public:
 
 	// Get number of meshes
 	int mesh_size();
+
+	// Attach Prop to a transform hierarchy
+	void attach(shared_ptr<transform_hierarchy> transforms, unsigned int parent);
+
+	// Get Prop node in the transform hierarchy
+	unsigned int get_node();
+
+	// Get Prop world position
+	vec3 get_world_position();
+
+	// Get Prop position as rendered, between the last two steps
+	vec3 get_render_position();
+
+	// Edit the local transform of a mesh
+	render_framework::transform& edit_mesh_transform(int i);
+
+	// Orbit Prop around its parent
+	void orbit(float deltaTime);
 	
 	// get Prop name
-	string Prop::get_name();
+	const string& Prop::get_name();
 
 protected:
 	// name
@@ -63,6 +97,9 @@ protected:
 	
 	// Prop model
 	vector<mesh> models;
+
+	// Render layer of each mesh
+	vector<RENDER_LAYER> layers;
 	
 	// Position
 	vec3 position;
@@ -71,6 +108,18 @@ protected:
 	vec3 rotation;
 
 	vec3 scale;
+
+	// Orbit speed around parent in radians per second
+	float orbit_rate;
+
+	// Transform hierarchy holding Prop and mesh transforms
+	shared_ptr<transform_hierarchy> hierarchy;
+
+	// Node rotated to orbit the parent
+	unsigned int orbit_node;
+
+	// Node holding Prop position and rotation
+	unsigned int node;
 	
 	// Path to .OBJ file
 	string path;
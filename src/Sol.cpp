@@ -5,8 +5,8 @@ Sol::Sol(void)
 {
 	name = "Sol";
 	path = "Sol.obj";
-	vert = "Sol.vert";
-	frag = "Sol.frag";
+	vert = "lit.vert";
+	frag = "lit.frag";
 	position = vec3(-0.9e8, 0.0, 0.9e8);
 	//position = vec3(0.0, 0.0, 0.0);
 	velocity = vec3(0.0,  0.0,  0.0);
@@ -18,12 +18,13 @@ Sol::~Sol(void)
 {
 }
 
-void Sol::update()
+void Sol::update(float deltaTime)
 {
-	rotate();
+	rotate(deltaTime);
 }
 
-void Sol::rotate()
+void Sol::rotate(float deltaTime)
 {
-	models.at(0).trans.rotate(vec3(0.0, pi<float>(), 0.0) * (float) 5.0e-5);
+	// Spins at 3.0e-3 pi radians per second
+	edit_mesh_transform(0).rotate(vec3(0.0, pi<float>(), 0.0) * (float) 3.0e-3 * deltaTime);
 }
\ No newline at end of file
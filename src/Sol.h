@@ -15,9 +15,9 @@ public:
 	~Sol(void);
 
 	// Update model
-	virtual void update(void);
+	virtual void update(float deltaTime);
 	// Update sun rotation
-	void rotate(void);
+	void rotate(float deltaTime);
 
 private:
 	static const double mass;
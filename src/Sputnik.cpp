@@ -6,8 +6,8 @@ Sputnik::Sputnik(void)
 {
 	name = "Sputnik";
 	path = "Sputnik.obj";
-	vert = "Sputnik.vert";
-	frag = "Sputnik.frag";
+	vert = "lit.vert";
+	frag = "lit.frag";
 
 	//position = vec3(228e3, 0.0, 0.0);
 	position = vec3(0.0, 0.0, 6939.0);
@@ -15,6 +15,8 @@ Sputnik::Sputnik(void)
 	velocity = vec3(0.0, 0.0, 0.0);
 	rotation = vec3(0.0,0.0,-1.5707963267);
 	scale = vec3(1.0, 1.0, 1.0);
+	// One orbit of Earth every 96 minutes
+	orbit_rate = 1.0908e-3f;
 }
 
 
@@ -22,6 +24,6 @@ Sputnik::~Sputnik(void)
 {
 }
 
-void Sputnik::update(void)
+void Sputnik::update(float deltaTime)
 {
 }
\ No newline at end of file
@@ -21,7 +21,7 @@ public:
 	~Sputnik(void);
 
 		// Updated model
-	virtual void update(void);
+	virtual void update(float deltaTime);
 
 private:
 	static const double mass;
@@ -58,8 +58,10 @@ bool CameraManager::initialize()
 
 // Update cameras
 void CameraManager::update(float deltaTime) {
-	// Update current camera position
-	user_controls.moveCamera(currentCamera, deltaTime);
+	// Update current camera position.  Headless renders have no input
+	if (!renderer::get_instance().is_headless()) {
+		user_controls.moveCamera(currentCamera, deltaTime);
+	}
 	currentCamera->update(deltaTime);
 } // update()
 
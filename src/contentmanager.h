@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <vector>
 #include <iostream>
+#include <sstream>
+#include <unordered_map>
 #include <GLM\glm.hpp>
 
 #include "tiny_obj_loader.h"
@@ -18,6 +21,41 @@ using namespace std;
 using namespace glm;
 using namespace render_framework;
 
+/* model_load : A Prop model part way through loading
+ *
+ * Filled in by ContentManager::parse_model on any thread, then finished by
+ * ContentManager::finish_model on the OpenGL thread.  The materials are
+ * set up by ContentManager::finish_materials once the effects are built
+ */
+struct model_load {
+	// Prop the model belongs to
+	Prop* prop;
+
+	// Path of the .obj file
+	string path;
+
+	// Shapes read from the .obj file
+	vector<tinyobj::shape_t> shapes;
+
+	// Mesh for each shape, with its geometry data filled in
+	vector<shared_ptr<mesh>> meshes;
+
+	// Content key of the material of each shape
+	vector<string> material_keys;
+
+	// Decoded diffuse texture of each shape.  Empty if an earlier shape has
+	// the same material
+	vector<image_data> diffuse;
+
+	// Decoded normal texture of each shape, if it has one
+	vector<image_data> normal;
+
+	// Set if the model was loaded successfully
+	bool loaded;
+
+	model_load() : prop(nullptr), loaded(false) {}
+};
+
 class ContentManager {
 public:
 
@@ -33,6 +71,12 @@ public:
 
 	shared_ptr<render_pass> pixelate;
 
+	// Shared buffers holding the geometry of every prop
+	shared_ptr<geometry_pool> pool;
+
+	// Transforms of every prop and prop mesh
+	shared_ptr<transform_hierarchy> transforms;
+
 	// Destructor for CameraManager
 	~ContentManager() { shutdown(); };
 
@@ -50,9 +94,12 @@ public:
 	// Initialise the CameraManager
 	bool initialize();
 
-	// Update cameras
+	// Update props by a fixed step of deltaTime seconds
 	void update(float deltaTime);
 
+	// Blend props alpha of the way between the last two updates
+	void interpolate(float alpha);
+
 	// Register object with scene manager for rendering
 	void register_prop(Prop* prop);
 
@@ -76,6 +123,26 @@ public:
 	// Load model
 	bool load_model(Prop* prop, string modelPath);
 
+	// Read the model file and textures.  Does not use OpenGL
+	bool parse_model(model_load& load);
+
+	// Create the OpenGL resources of a parsed model, submitting its effects
+	// to be built
+	bool finish_model(model_load& load);
+
+	// Set up the materials of a model once its effects are built
+	bool finish_materials(model_load& load);
+
+	// Move loading on without waiting for the shaders.  Returns true once
+	// loading has finished, whether or not it succeeded
+	bool poll_loading();
+
+	// Wait for loading to finish.  Returns true if everything loaded
+	bool finish_loading();
+
+	// Checks if every prop has finished loading
+	bool is_loaded() const { return _loaded; }
+
 	// load vertices for model
 	void load_vertices(tinyobj::shape_t * shape, mesh * model);
 
@@ -96,6 +163,19 @@ private:
 	// Private flag for current status of the manager
 	bool _running;
 
+	// Set once every prop has finished loading
+	bool _loaded;
+
+	// Props parsed and finished, waiting for their effects to be built
+	vector<model_load> _loads;
+
+	// Effects of the props being built
+	effect_batch _effect_batch;
+
+	// Materials of the props, keyed by their content so meshes with the
+	// same material share one
+	unordered_map<string, shared_ptr<material>> _materials;
+
 	// Private collection of Props
 	vector<Prop*> prop_list;
 
@@ -5,6 +5,10 @@
 
 #include <render_framework\render_framework.h>
 #include <chrono>
+#include <thread>
+#include <cmath>
+#include <string>
+#include <cstdlib>
 #include "scenemanager.h"
 #include "cameramanager.h"
 
@@ -35,9 +39,38 @@ bool initialize() {
 
 /** main() : Entry point for program
  * 
- * Runs the main render loop.
+ * Runs the main render loop.  The scene is stepped at a fixed rate, with
+ * as many steps as the time since the last frame covers, then rendered
+ * blended between the last two steps.
+ *
+ * Passing --headless WIDTH HEIGHT FRAMES renders the given number of
+ * frames offscreen at the given resolution, with no window or input.
+ * Unless built with RENDER_FRAMEWORK_EGL, this uses a hidden window, so
+ * still needs a display.
+ * Passing --fps N limits the frame rate to N frames per second.
+ * Passing --profile FILE writes a Chrome trace of every frame to FILE.
+ * Passing --stats FILE writes the render statistics of every frame to FILE.
  */
 int main (int argc,char *argv[]) {
+	// Check for a headless render and frame rate cap
+	bool headless = false;
+	int fps = 0;
+	string profile;
+	string stats;
+	for (int i = 1; i < argc; ++i) {
+		if (string(argv[i]) == "--headless" && i + 3 < argc) {
+			renderer::get_instance().set_headless(atoi(argv[i + 1]), atoi(argv[i + 2]), atoi(argv[i + 3]));
+			headless = true;
+			i += 3;
+		} else if (string(argv[i]) == "--fps" && i + 1 < argc) {
+			fps = atoi(argv[++i]);
+		} else if (string(argv[i]) == "--profile" && i + 1 < argc) {
+			profile = argv[++i];
+		} else if (string(argv[i]) == "--stats" && i + 1 < argc) {
+			stats = argv[++i];
+		}
+	}
+
 	// Initialize needed managers and the render_framework
 	if(!initialize()) {
 		printf("Initialization Fail.\n");
@@ -46,27 +79,78 @@ int main (int argc,char *argv[]) {
 		printf("Initialization complete!\n");
 	}
 
+	// Start profiling once loading is done
+	if (!profile.empty()) {
+		profiler::get_instance().start_capture(profile);
+	}
+	if (!stats.empty()) {
+		renderer::get_instance().start_stats_csv(stats);
+	}
+
+	// Length of each simulation step
+	const duration<double> step(1.0 / 60.0);
+	// Longest frame simulated.  Longer frames (breakpoints, window drags)
+	// are cut short rather than taking ever more steps to catch up
+	const duration<double> max_frame(0.25);
+	// Most steps taken in one frame
+	const int max_steps = 8;
+	// Shortest frame when the frame rate is capped
+	const duration<double> min_frame(fps > 0 ? 1.0 / fps : 0.0);
+
 	// Monitor the elapsed time per frame
-	auto currentTimeStamp = system_clock::now();
-	auto prevTimeStamp = system_clock::now();
+	auto currentTimeStamp = steady_clock::now();
+	auto prevTimeStamp = currentTimeStamp;
+	duration<double> accumulator(0.0);
 
 	// Main render loop
 	while (renderer::get_instance().is_running())
 	{
 		// Get current time
-		currentTimeStamp = system_clock::now();
-		// Calculate elapsed time
-		auto elapsed = duration_cast<milliseconds>(currentTimeStamp - prevTimeStamp);
-		// Convert to fractions of a second
-		auto seconds = float(elapsed.count()) / 1000.0f;
+		currentTimeStamp = steady_clock::now();
+		// Calculate elapsed time.  Headless renders take exactly one step a
+		// frame so every run renders the same frames
+		duration<double> elapsed = headless ? step : duration<double>(currentTimeStamp - prevTimeStamp);
+		prevTimeStamp = currentTimeStamp;
+		if (elapsed > max_frame) {
+			elapsed = max_frame;
+		}
+		accumulator += elapsed;
 
-		// Update Scene
-		SceneManager::get_instance().update_scene(seconds);
+		// Step the scene until caught up
+		int steps = 0;
+		while (accumulator >= step && steps < max_steps) {
+			SceneManager::get_instance().step_scene(float(step.count()));
+			accumulator -= step;
+			++steps;
+		}
+		// Drop whole steps still owed so the next frame does not inherit them
+		if (accumulator >= step) {
+			accumulator = duration<double>(fmod(accumulator.count(), step.count()));
+		}
 
-		SceneManager::get_instance().render_scene(seconds);
+		// Update Scene, blended between the last two steps
+		float alpha = float(accumulator.count() / step.count());
+		SceneManager::get_instance().update_scene(float(elapsed.count()), alpha);
 
-		prevTimeStamp = currentTimeStamp;
+		SceneManager::get_instance().render_scene(float(elapsed.count()));
+
+		// Wait out the rest of the frame when the frame rate is capped
+		if (fps > 0 && !headless) {
+			this_thread::sleep_until(currentTimeStamp + duration_cast<steady_clock::duration>(min_frame));
+		}
 	} // Main render loop
 
+	profiler::get_instance().stop_capture();
+	renderer::get_instance().stop_stats_csv();
+
+	// Report frame times
+	const frame_timing& timing = renderer::get_instance().get_frame_timing();
+	printf("Frame times over %u frames: p50 %.2fms, p95 %.2fms, p99 %.2fms, max %.2fms\n",
+		timing.get_count(),
+		timing.get_percentile(0.50) * 1000.0,
+		timing.get_percentile(0.95) * 1000.0,
+		timing.get_percentile(0.99) * 1000.0,
+		timing.get_max() * 1000.0);
+
 	return 0;
 } // main()
\ No newline at end of file
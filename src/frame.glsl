@@ -0,0 +1,12 @@
+// Values shared by every draw in a frame, uploaded once by the renderer
+uniform frame
+{
+    mat4 view;                  // View matrix
+    mat4 projection;            // Projection matrix
+    mat4 view_projection;       // View-Projection matrix
+    vec3 eye_position;          // Camera Position
+    float time;                 // Time since the renderer started
+    vec4 sun_ambient_intensity; // Ambient intensity for scene
+    vec4 sun_colour;            // Light colour
+    vec3 sun_direction;         // Direction of the light
+} frame_data;
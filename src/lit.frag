@@ -0,0 +1,89 @@
+#version 400
+
+// Fragment shader for every prop.  Parts are switched on by defines:
+//   NORMAL_MAP   - reads the normal from normal_map, in tangent space
+//   SPECULAR_MAP - scales specular light by the alpha of specular_map
+//   LOG_DEPTH    - writes the logarithmic depth from the vertex shader
+//   OPAQUE       - ignores the alpha of the texture and material
+
+layout (std140) uniform;
+
+#include "material.glsl"
+#include "frame.glsl"
+
+uniform sampler2D tex;          // Texture Data
+#ifdef NORMAL_MAP
+uniform sampler2D normal_map;   // Normal Map
+#endif
+#ifdef SPECULAR_MAP
+uniform sampler2D specular_map; // Specular map
+#endif
+
+in vec3 vertex_position;
+in vec2 vertex_tex_coord;		// Incoming texture coordinate
+#ifdef NORMAL_MAP
+in vec3 light_dir;
+in vec3 view_dir;
+#else
+in vec3 transformed_normal;
+#endif
+#ifdef LOG_DEPTH
+in float logz;
+#endif
+
+// Outgoing colour
+out vec4 col;
+
+void main() {
+
+#ifdef NORMAL_MAP
+  // Sample normal from the normal map
+  vec3 normal = normalize(((texture(normal_map, vertex_tex_coord).rgb * 2.0) - vec3(1.0, 1.0, 1.0)));
+
+  // Calculate half_vector
+  vec3 half_vector = normalize(light_dir + view_dir);
+#else
+  vec3 normal = transformed_normal;
+
+  // Calculate view direction
+  vec3 view_direction = normalize(frame_data.eye_position - vertex_position);
+
+  // Calculate half_vector
+  vec3 half_vector = normalize(frame_data.sun_direction + view_direction);
+#endif
+
+  /*
+   * Calculate ambient light
+   */
+  vec4 ambient = mat.diffuse_reflection * frame_data.sun_ambient_intensity;
+
+  /*
+   * Calculate diffuse light
+   */
+  float k = max(dot(normal, frame_data.sun_direction), 0.0);
+  vec4 diffuse = k * (mat.diffuse_reflection * frame_data.sun_colour);
+
+  /*
+   * Calculate specular lighting
+   *
+   * Calculate specular intensity
+   */
+  float s = pow(max(dot(normal, half_vector), 0.0), mat.shininess);
+  vec4 specular = (mat.specular_reflection * frame_data.sun_colour) * s;
+#ifdef SPECULAR_MAP
+  specular *= texture(specular_map, vertex_tex_coord).a;
+#endif
+
+  // Sample texture
+  vec4 tex_colour = texture(tex, vertex_tex_coord);
+
+  // Calculate final fragment colour
+  col = ((mat.emissive + ambient + diffuse) * tex_colour) + specular;
+#ifdef OPAQUE
+  col.a = 1.0;
+#endif
+
+#ifdef LOG_DEPTH
+  gl_FragDepth = logz;
+#endif
+}
@@ -0,0 +1,76 @@
+#version 400
+
+// Vertex shader for every prop.  Parts are switched on by defines:
+//   NORMAL_MAP - lights in tangent space for a normal mapped surface
+//   LOG_DEPTH  - writes logarithmic depth, to stop Z fighting across the
+//                distances of the solar system
+
+layout (std140) uniform;
+
+#include "frame.glsl"
+
+layout (location = 0) in vec3 position;		// The vertex position in model space
+layout (location = 1) in vec3 normal;		// Incoming normal
+layout (location = 2) in vec2 tex_coord;	// Texture co-ordinate
+#ifdef NORMAL_MAP
+layout (location = 4) in vec3 tangent;
+layout (location = 5) in vec3 binormal;
+#endif
+// Model matrix, set per draw.  Normals, tangents and binormals are
+// transformed by its upper 3x3 rather than the inverse transpose, so it must
+// only scale uniformly.  ContentManager asserts this for every prop
+layout (location = 7) in mat4 instance_model;
+
+// Output variables
+out vec3 vertex_position;
+out vec2 vertex_tex_coord;
+#ifdef NORMAL_MAP
+out vec3 light_dir;
+out vec3 view_dir;
+#else
+out vec3 transformed_normal;
+#endif
+#ifdef LOG_DEPTH
+out float logz;
+
+const float FC = 1.0/log(1.0e8*1e-6 + 1);
+#endif
+
+void main()
+{
+  // Past through position
+  vertex_position = (instance_model * vec4(position, 1)).xyz;
+
+  // Transform position
+  gl_Position = frame_data.view_projection * vec4(vertex_position, 1.0);
+
+  // Output tex coord
+  vertex_tex_coord = tex_coord;
+
+#ifdef NORMAL_MAP
+  // Calculate position in camera space
+  vec3 pos = (frame_data.view * vec4(vertex_position, 1.0)).xyz;
+
+  // Create transform matrix for view and light directions
+  vec3 n = normalize(mat3(instance_model) * normal);
+  vec3 t = normalize(mat3(instance_model) * tangent);
+  vec3 b = normalize(mat3(instance_model) * binormal);
+  mat3 tbn_transform = mat3(
+    t.x, b.x, n.x,
+    t.y, b.y, n.y,
+    t.z, b.z, n.z);
+
+  view_dir = normalize(frame_data.eye_position - pos);
+  view_dir = tbn_transform * view_dir;
+  light_dir = frame_data.sun_direction * tbn_transform;
+#else
+  // Updating normal with normal matrix
+  transformed_normal = normalize(mat3(instance_model) * normal);
+#endif
+
+#ifdef LOG_DEPTH
+  // Using Logarithmic Depth to stop Z fighting on Earth atmosphere
+  logz = log(gl_Position.w*1e-6 + 1)*FC;
+  gl_Position.z = (2*logz - 1)*gl_Position.w;
+#endif
+}
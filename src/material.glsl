@@ -0,0 +1,8 @@
+// Surface of the mesh being drawn
+uniform material
+{
+    vec4 emissive;				// Emissive light values
+    vec4 diffuse_reflection;	// Colour for diffuse light reflected from material 
+    vec4 specular_reflection;   // Colour for specular light reflected from material 
+    float shininess;             // Materials shininess factor
+} mat;
@@ -7,7 +7,9 @@
  * SceneManager controls both the Content and Camera manager for this program.
  * 
  * initialise() initialses the needed managers and any needed data.
- * updateScene() updates the camera position and the objects.
+ * render_loading_frame() draws the sky box while shaders compile.
+ * step_scene() steps the objects by a fixed step.
+ * update_scene() updates the camera position and blends the objects.
  */
 
 #include "scenemanager.h"
@@ -67,7 +69,21 @@ bool SceneManager::initialize()
         return false;
     }
 
-    _focus = vec3(0.0, 0.0, 0.0);
+    // Draw the sky box while the prop shaders finish compiling.  Headless
+    // renders wait instead, so every frame they count shows the scene
+    if (!renderer::get_instance().is_headless()) {
+        while (!ContentManager::get_instance().poll_loading() &&
+               renderer::get_instance().is_running()) {
+            render_loading_frame();
+        }
+    }
+    if (!ContentManager::get_instance().finish_loading()) {
+        cout << "Content failed to load.\n";
+        return false;
+    }
+
+    _focus_prop = 0;
+    _queue = make_shared<render_queue>();
     _running = true;
 
     return true;
@@ -85,37 +101,69 @@ bool SceneManager::initialize_lighting() {
         return false;
     }
 
+    // The light is shared by every effect through the frame uniform block
+    renderer::get_instance().set_sun(light);
+
     return true;
 } // Initialize_ligting()
 
 /*
- * Updates all registers objects in the scene
+ * Steps all registered objects in the scene by a fixed step
+ */
+void SceneManager::step_scene(float step)
+{
+    PROFILE_ZONE("step_scene");
+    ContentManager::get_instance().update(step);
+} // step_scene()
+
+/*
+ * Updates the camera and blends the objects for the frame being rendered
+ */
+void SceneManager::update_scene(float deltaTime, float alpha)
+{
+    PROFILE_ZONE("update_scene");
+    // Headless renders have no window to read keys from
+    if (!renderer::get_instance().is_headless()) {
+        handle_input();
+    }
+    ContentManager::get_instance().sin->set_uniform_value("offset", deltaTime);
+
+    // Blend props first so the camera follows the focus prop as rendered
+    ContentManager::get_instance().interpolate(alpha);
+
+    vec3 focus = ContentManager::get_instance().get_prop_at(_focus_prop)->get_render_position();
+    CameraManager::get_instance().currentCamera->set_target(focus);
+    CameraManager::get_instance().update(deltaTime);
+} // update_scene()
+
+/*
+ * Switches cameras and post processes when keys are pressed
  */
-void SceneManager::update_scene(float deltaTime)
+void SceneManager::handle_input()
 {
     // Move the camera when keys are pressed
     // Earth Cam
     if (glfwGetKey(renderer::get_instance().get_window(), GLFW_KEY_1)) {
         CameraManager::get_instance().setRenderCamera(CameraManager::get_instance().getCameraAtIndex(0));
-        _focus = ContentManager::get_instance().get_prop_at(0)->get_mesh(0).trans.position;
+        _focus_prop = 0;
         CameraManager::get_instance().currentCamera->set_distance(20000.0f);
     }
     // Sputnik Cam
     if (glfwGetKey(renderer::get_instance().get_window(), GLFW_KEY_2)) {
         CameraManager::get_instance().setRenderCamera(CameraManager::get_instance().getCameraAtIndex(1));
-        _focus = ContentManager::get_instance().get_prop_at(1)->get_mesh(0).trans.position;
+        _focus_prop = 1;
         CameraManager::get_instance().currentCamera->set_distance(5.0f);
     }
     // Moon Cam
     if (glfwGetKey(renderer::get_instance().get_window(), GLFW_KEY_3)) {
         CameraManager::get_instance().setRenderCamera(CameraManager::get_instance().getCameraAtIndex(2));
-        _focus = ContentManager::get_instance().get_prop_at(2)->get_mesh(0).trans.position;
+        _focus_prop = 2;
         CameraManager::get_instance().currentCamera->set_distance(6000.0f);
     }
     // Sol Cam
     if (glfwGetKey(renderer::get_instance().get_window(), GLFW_KEY_4)) {
         CameraManager::get_instance().setRenderCamera(CameraManager::get_instance().getCameraAtIndex(2));
-        _focus = ContentManager::get_instance().get_prop_at(3)->get_mesh(0).trans.position;
+        _focus_prop = 3;
         CameraManager::get_instance().currentCamera->set_distance(3.0e6f);
     }
     if (glfwGetKey(renderer::get_instance().get_window(), GLFW_KEY_G)) {
@@ -140,23 +188,37 @@ void SceneManager::update_scene(float deltaTime)
         // Build post process
         content_manager::get_instance().build("display", ContentManager::get_instance().post);
     }
-    ContentManager::get_instance().sin->set_uniform_value("offset", deltaTime);
-    CameraManager::get_instance().currentCamera->set_target(_focus);
-    CameraManager::get_instance().update(deltaTime);
+} // handle_input()
 
-    int i;
-    for (i=0; i < ContentManager::get_instance().prop_list_size(); ++i) {
-        ContentManager::get_instance().get_prop_at(i)->get_mesh(0).mat->set_uniform_value("eye_position", CameraManager::get_instance().currentCamera->get_position());
+/*
+* Render the sky box alone, while the props are still loading
+*/
+void SceneManager::render_loading_frame()
+{
+    PROFILE_ZONE("render_loading_frame");
+    CameraManager::get_instance().currentCamera->update(0.0f);
+    if (!(ContentManager::get_instance().post == nullptr)) {
+        renderer::get_instance().bind(ContentManager::get_instance().post);
     }
 
-    ContentManager::get_instance().update(deltaTime);
-} // update_scene()
+    if (renderer::get_instance().begin_render()) {
+        if (!(ContentManager::get_instance().sky_box == nullptr)) {
+            renderer::get_instance().render(ContentManager::get_instance().sky_box);
+        }
+    }
+
+    if (!(ContentManager::get_instance().post == nullptr)) {
+        renderer::get_instance().render(ContentManager::get_instance().post);
+    }
+    renderer::get_instance().end_render();
+} // render_loading_frame()
 
 /*
 * Render registered objects
 */
 void SceneManager::render_scene(float deltaTime)
 {
+    PROFILE_ZONE("render_scene");
     if (!(ContentManager::get_instance().post == nullptr)) {
         renderer::get_instance().bind(ContentManager::get_instance().post);
     }
@@ -167,11 +229,30 @@ void SceneManager::render_scene(float deltaTime)
             renderer::get_instance().render(ContentManager::get_instance().sky_box);
         }
 
+        // Queue every prop mesh, then render them sorted by state.  Meshes
+        // are borrowed from the props, so nothing is allocated or copied
         int i, j;
-        for (i = 0; i < ContentManager::get_instance().prop_list_size(); ++i) {
-            for (j = 0; j < ContentManager::get_instance().get_prop_at(i)->mesh_size(); ++j) {
-                shared_ptr<mesh> prop = make_shared<mesh>(ContentManager::get_instance().get_prop_at(i)->get_mesh(j));
-                renderer::get_instance().render(prop);
+        if (!profiler::is_enabled()) {
+            _queue->clear();
+            for (i = 0; i < ContentManager::get_instance().prop_list_size(); ++i) {
+                Prop* prop = ContentManager::get_instance().get_prop_at(i);
+                for (j = 0; j < prop->mesh_size(); ++j) {
+                    _queue->push(prop->get_mesh(j), prop->get_layer(j));
+                }
+            }
+            renderer::get_instance().render(*_queue);
+        } else {
+            // While profiling, render each prop's meshes on their own so
+            // their draws can be timed on the GPU.  State is no longer
+            // shared between props, so the frame does slightly more work
+            for (i = 0; i < ContentManager::get_instance().prop_list_size(); ++i) {
+                Prop* prop = ContentManager::get_instance().get_prop_at(i);
+                PROFILE_GPU_ZONE(prop->get_name().c_str());
+                _queue->clear();
+                for (j = 0; j < prop->mesh_size(); ++j) {
+                    _queue->push(prop->get_mesh(j), prop->get_layer(j));
+                }
+                renderer::get_instance().render(*_queue);
             }
         }
     }
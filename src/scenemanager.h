@@ -27,8 +27,12 @@ public:
 	// Render all registered objects
 	void render_scene(float deltaTime);
 
-	// Updates the current scene
-	void update_scene(float deltaTime);
+	// Steps the simulation of the scene by a fixed step of seconds
+	void step_scene(float step);
+
+	// Updates the current scene for a frame, alpha of the way between the
+	// last two steps
+	void update_scene(float deltaTime, float alpha);
 
 	shared_ptr<directional_light> light;
 
@@ -37,7 +41,11 @@ private:
 	// Private flag for current status of the manager
 	bool _running;
 
-	glm::vec3 _focus;
+	// Index of the prop the camera is focused on
+	int _focus_prop;
+
+	// Queue of prop meshes, sorted by state before rendering
+	shared_ptr<render_queue> _queue;
 
 	// Private constructor (This SceneManager is a singleton)
 	SceneManager() {};
@@ -48,6 +56,12 @@ private:
 	// Initialises the lighting for the scene
 	bool initialize_lighting();
 
+	// Renders the sky box while the props are loading
+	void render_loading_frame();
+
+	// Switches cameras and post processes from key presses
+	void handle_input();
+
 	// Private assignment operator
 	void operator=(SceneManager&);
 
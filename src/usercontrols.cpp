@@ -7,7 +7,7 @@ using namespace std;
 using namespace render_framework;
 using namespace glm;
 
-void UserControls::moveCamera(shared_ptr<arc_ball_camera> cam, float deltaTime) {
+void UserControls::moveCamera(const shared_ptr<arc_ball_camera>& cam, float deltaTime) {
 	// Move the camera when keys are pressed
 	if (glfwGetKey(renderer::get_instance().get_window(), GLFW_KEY_RIGHT)) {
 		cam->rotate(0.0f, quarter_pi<float>() * deltaTime);
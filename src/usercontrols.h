@@ -8,6 +8,6 @@ using namespace render_framework;
 class UserControls
 {
 public:
-	void moveCamera(std::shared_ptr<arc_ball_camera> cam, float deltaTime);
+	void moveCamera(const std::shared_ptr<arc_ball_camera>& cam, float deltaTime);
 };
 #endif // USERCONTROLS_H
\ No newline at end of file